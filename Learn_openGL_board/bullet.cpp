@@ -29,11 +29,18 @@ class BallisticDemo : public Application
 		ShotType type;
 		unsigned startTime;
 
-		/** Draws the round. */
-		void render()
+		/** The position before the last physics step. */
+		cyclone::Vector3 previousPosition;
+
+		/**
+		* Draws the round, blended between its previous and
+		* current position by the given amount.
+		*/
+		void render(cyclone::real alpha)
 		{
 			cyclone::Vector3 position;
 			particle.getPosition(&position);
+			position = previousPosition + (position - previousPosition) * alpha;
 
 			glColor3f(0, 0, 0);
 			glPushMatrix();
@@ -62,6 +69,33 @@ class BallisticDemo : public Application
 	/** Holds the current shot type. */
 	ShotType currentShotType;
 
+	/** Holds the body of the thin board the rounds are fired at. */
+	cyclone::RigidBody boardBody;
+
+	/** Holds the collision shape of the board. */
+	cyclone::CollisionBox board;
+
+	/**
+	* Sweeps the fast rounds against the board, so they can't pass
+	* through it between two steps.
+	*/
+	cyclone::ContinuousCollision sweeper;
+
+	/** The number of physics steps per simulated second. */
+	const static unsigned stepsPerSecond = 120;
+
+	/** The most physics steps run for a single frame. */
+	const static unsigned maxSubsteps = 8;
+
+	/** Frame time that has not been simulated yet. */
+	cyclone::real accumulator;
+
+	/** How far between the previous and current positions to draw. */
+	cyclone::real interpolationAlpha;
+
+	/** Runs one fixed physics step for every live round. */
+	void step(cyclone::real duration);
+
 	/** Dispatches a round. */
 	void fire();
 
@@ -87,13 +121,24 @@ public:
 
 // Method definitions
 BallisticDemo::BallisticDemo()
-	: currentShotType(LASER)
+	: currentShotType(LASER), accumulator(0), interpolationAlpha(0)
 {
 	// Make all shots unused
 	for (AmmoRound *shot = ammo; shot < ammo + ammoRounds; shot++)
 	{
 		shot->type = UNUSED;
 	}
+
+	// Set up the board: 10cm thick, which a laser round crosses in a
+	// fraction of a step.
+	boardBody.setPosition(0.0f, 2.0f, 60.0f);
+	boardBody.setOrientation(1.0f, 0.0f, 0.0f, 0.0f);
+	boardBody.setInverseMass(0.0f);
+	boardBody.calculateDerivedData();
+	board.body = &boardBody;
+	board.halfSize = cyclone::Vector3(4.0f, 2.0f, 0.05f);
+	board.calculateInternals();
+	sweeper.addBox(&board);
 }
 
 const char* BallisticDemo::getTitle()
@@ -149,27 +194,39 @@ void BallisticDemo::fire()
 
 	// Set the data common to all particle types
 	shot->particle.setPosition(0.0f, 1.5f, 0.0f);
+	shot->previousPosition = shot->particle.getPosition();
 	shot->startTime = TimingData::get().lastFrameTimestamp;
 	shot->type = currentShotType;
 
 	// Clear the force accumulators
 	shot->particle.clearAccumulator();
+
+	// The round is swept against the board while it is fast.
+	sweeper.addParticle(&shot->particle, 0.3f);
 }
 
-void BallisticDemo::update()
+void BallisticDemo::step(cyclone::real duration)
 {
-	// Find the duration of the last frame in seconds
-	float duration = (float)TimingData::get().lastFrameDuration * 0.001f;
-	if (duration <= 0.0f) return;
+	// Note where the fast rounds start the step.
+	sweeper.beginStep();
 
 	// Update the physics of each particle in turn
 	for (AmmoRound *shot = ammo; shot < ammo + ammoRounds; shot++)
 	{
 		if (shot->type != UNUSED)
 		{
-			// Run the physics
+			shot->previousPosition = shot->particle.getPosition();
 			shot->particle.integrate(duration);
+		}
+	}
+
+	// Rounds that hit the board on the way are stopped against it.
+	sweeper.endStep();
 
+	for (AmmoRound *shot = ammo; shot < ammo + ammoRounds; shot++)
+	{
+		if (shot->type != UNUSED)
+		{
 			// Check if the particle is now invalid
 			if (shot->particle.getPosition().y < 0.0f ||
 				shot->startTime + 5000 < TimingData::get().lastFrameTimestamp ||
@@ -178,9 +235,32 @@ void BallisticDemo::update()
 				// We simply set the shot type to be unused, so the
 				// memory it occupies can be reused by another shot.
 				shot->type = UNUSED;
+				sweeper.removeParticle(&shot->particle);
 			}
 		}
 	}
+}
+
+void BallisticDemo::update()
+{
+	// Find the duration of the last frame in seconds
+	float duration = (float)TimingData::get().lastFrameDuration * 0.001f;
+	if (duration <= 0.0f) return;
+
+	// Run the physics in fixed steps, so a long frame can't make the
+	// simulation unstable. Time beyond the step budget is dropped.
+	const cyclone::real stepDuration = ((cyclone::real)1.0) / stepsPerSecond;
+	accumulator += duration;
+	if (accumulator > stepDuration * maxSubsteps)
+	{
+		accumulator = stepDuration * maxSubsteps;
+	}
+	while (accumulator >= stepDuration)
+	{
+		step(stepDuration);
+		accumulator -= stepDuration;
+	}
+	interpolationAlpha = accumulator / stepDuration;
 
 	Application::update();
 }
@@ -214,12 +294,20 @@ void BallisticDemo::display()
 	}
 	glEnd();
 
+	// Draw the board
+	glColor3f(0.6f, 0.6f, 0.7f);
+	glPushMatrix();
+	glTranslatef(0.0f, 2.0f, 60.0f);
+	glScalef(8.0f, 4.0f, 0.1f);
+	glutSolidCube(1.0f);
+	glPopMatrix();
+
 	// Render each particle in turn
 	for (AmmoRound *shot = ammo; shot < ammo + ammoRounds; shot++)
 	{
 		if (shot->type != UNUSED)
 		{
-			shot->render();
+			shot->render(interpolationAlpha);
 		}
 	}
 
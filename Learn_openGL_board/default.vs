@@ -1,5 +1,6 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
+// quantized meshes store the position as fractions of the mesh bounds with w = 0; float positions read w = 1
+layout (location = 0) in vec4 aPos;
 layout (location = 2) in vec2 aTexCoords;
 
 out vec2 TexCoords;
@@ -7,9 +8,13 @@ out vec2 TexCoords;
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
+// set by Mesh::Draw for quantized meshes
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
 
 void main()
 {
+    vec3 position = aPos.w == 0.0 ? positionOffset + aPos.xyz * positionScale : aPos.xyz;
     TexCoords = aTexCoords;
-    gl_Position = projection * view * model * vec4(aPos, 1.0f); 
+    gl_Position = projection * view * model * vec4(position, 1.0f); 
 }
\ No newline at end of file
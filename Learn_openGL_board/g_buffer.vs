@@ -1,5 +1,6 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
+// quantized meshes store the position as fractions of the mesh bounds with w = 0; float positions read w = 1
+layout (location = 0) in vec4 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 
@@ -10,10 +11,14 @@ out vec3 Normal;
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+// set by Mesh::Draw for quantized meshes
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
 
 void main()
 {
-    vec4 worldPos = model * vec4(aPos, 1.0);
+    vec3 position = aPos.w == 0.0 ? positionOffset + aPos.xyz * positionScale : aPos.xyz;
+    vec4 worldPos = model * vec4(position, 1.0);
     FragPos = worldPos.xyz; 
     TexCoords = aTexCoords;
     
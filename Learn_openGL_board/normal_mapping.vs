@@ -1,9 +1,10 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
+// quantized meshes store the position as fractions of the mesh bounds with w = 0; float positions read w = 1
+layout (location = 0) in vec4 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in vec3 aTangent;
-layout (location = 4) in vec3 aBitangent;
+// packed meshes store the handedness of the tangent frame in w; full vertices leave it at 1
+layout (location = 3) in vec4 aTangent;
 
 out VS_OUT {
 	vec3 FragPos;
@@ -20,21 +21,26 @@ uniform mat4 model;
 uniform vec3 lightPos;
 uniform vec3 viewPos;
 
+// set by Mesh::Draw for quantized meshes
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
 void main()
 {
-	vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
+	vec3 position = aPos.w == 0.0 ? positionOffset + aPos.xyz * positionScale : aPos.xyz;
+	vs_out.FragPos = vec3(model * vec4(position, 1.0));
 	vs_out.TexCoords = aTexCoords;
 
 	mat3 normalMatrix = transpose(inverse(mat3(model)));
-	vec3 T = normalize(normalMatrix * aTangent);
+	vec3 T = normalize(normalMatrix * aTangent.xyz);
 	vec3 N = normalize(normalMatrix * aNormal);
 	T = normalize(T - dot(T, N) * N);
-	vec3 B = cross(N, T);
+	vec3 B = cross(N, T) * (aTangent.w < 0.0 ? -1.0 : 1.0);
 
 	mat3 TBN = transpose(mat3(T, B, N));
     vs_out.TangentLightPos = TBN * lightPos;
     vs_out.TangentViewPos  = TBN * viewPos;
     vs_out.TangentFragPos  = TBN * vs_out.FragPos;
         
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * model * vec4(position, 1.0);
 }
\ No newline at end of file
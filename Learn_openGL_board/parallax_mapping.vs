@@ -1,8 +1,11 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
+// quantized meshes store the position as fractions of the mesh bounds with w = 0; float positions read w = 1
+layout (location = 0) in vec4 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in vec3 aTangent;
+// packed meshes store the handedness of the tangent frame in w; full vertices leave it at 1
+layout (location = 3) in vec4 aTangent;
+// only full meshes have a bitangent; packed meshes leave it disabled, so it reads as zero
 layout (location = 4) in vec3 aBitangent;
 
 out VS_OUT {
@@ -20,19 +23,25 @@ uniform mat4 model;
 uniform vec3 lightPos;
 uniform vec3 viewPos;
 
+// set by Mesh::Draw for quantized meshes
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
 void main()
 {
-    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));   
+    vec3 position = aPos.w == 0.0 ? positionOffset + aPos.xyz * positionScale : aPos.xyz;
+    vs_out.FragPos = vec3(model * vec4(position, 1.0));   
     vs_out.TexCoords = aTexCoords;   
     
-    vec3 T = normalize(mat3(model) * aTangent);
-    vec3 B = normalize(mat3(model) * aBitangent);
+    vec3 T = normalize(mat3(model) * aTangent.xyz);
     vec3 N = normalize(mat3(model) * aNormal);
+    // packed meshes rebuild the bitangent from the normal and the tangent's handedness
+    vec3 B = aBitangent == vec3(0.0) ? cross(N, T) * (aTangent.w < 0.0 ? -1.0 : 1.0) : normalize(mat3(model) * aBitangent);
     mat3 TBN = transpose(mat3(T, B, N));
 
     vs_out.TangentLightPos = TBN * lightPos;
     vs_out.TangentViewPos  = TBN * viewPos;
     vs_out.TangentFragPos  = TBN * vs_out.FragPos;
     
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * model * vec4(position, 1.0);
 }
\ No newline at end of file
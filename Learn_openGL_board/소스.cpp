@@ -349,6 +349,9 @@ int main()
 		glfwPollEvents();
 	}
 
+	// textures cached for Model have to be deleted while the context still exists
+	TextureCache::shared().clear();
+
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 	// ------------------------------------------------------------------
 	glfwTerminate();
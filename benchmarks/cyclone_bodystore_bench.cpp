@@ -0,0 +1,103 @@
+/*
+ * Times RigidBodyStore::integrate and calculateDerivedData on one
+ * thread and on job pools of every size up to the number of
+ * hardware threads, in milliseconds per step.
+ *
+ * Build: g++ -std=c++11 -O2 -Iinclude
+ * benchmarks/cyclone_bodystore_bench.cpp -lpthread together with
+ * the cyclone library sources, which provide getSleepEpsilon.
+ * Pass the number of bodies as the first argument; the default is
+ * 100000. A second argument sets the largest pool to try.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+
+#include "cyclone/bodystore.h"
+
+using namespace cyclone;
+
+namespace {
+    const unsigned STEPS = 50;
+    const real DURATION = (real)1.0 / (real)60.0;
+
+    real random(real min, real max)
+    {
+        return min + (max - min) * ((real)rand() / (real)RAND_MAX);
+    }
+
+    /**
+     * Fills the store with spinning, moving bodies that never fall
+     * asleep, so every step processes all of them.
+     */
+    void fill(RigidBodyStore &store, unsigned count)
+    {
+        store.reserve(count);
+        for (unsigned n = 0; n < count; n++)
+        {
+            unsigned index = store.indexOf(store.create());
+            store.motion[index].position = Vector3(random(-100, 100), random(0, 100), random(-100, 100));
+            store.motion[index].velocity = Vector3(random(-5, 5), random(-5, 5), random(-5, 5));
+            store.motion[index].rotation = Vector3(random(-2, 2), random(-2, 2), random(-2, 2));
+            store.forces[index].acceleration = Vector3(0, (real)-9.81, 0);
+            store.properties[index].linearDamping = (real)0.99;
+            store.properties[index].angularDamping = (real)0.8;
+            store.properties[index].canSleep = false;
+        }
+        store.calculateDerivedData();
+    }
+
+    /** Returns the milliseconds per call of the step, over STEPS calls. */
+    template <typename Step>
+    double time(Step step)
+    {
+        step();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (unsigned n = 0; n < STEPS; n++) step();
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count() / STEPS;
+    }
+
+    /** Keeps the results alive so the steps aren't optimised away. */
+    volatile real sink;
+}
+
+int main(int argc, char **argv)
+{
+    const unsigned count = argc > 1 ? (unsigned)atoi(argv[1]) : 100000;
+    unsigned maxThreads = argc > 2 ? (unsigned)atoi(argv[2]) :
+        std::thread::hardware_concurrency();
+    if (maxThreads == 0) maxThreads = 1;
+
+    srand(14);
+    RigidBodyStore store;
+    fill(store, count);
+
+    printf("%u bodies, %u hardware threads\n", count, std::thread::hardware_concurrency());
+    printf("threads  integrate (ms)  speedup  derived data (ms)  speedup\n");
+
+    double integrateSerial = 0, derivedSerial = 0;
+    for (unsigned threads = 1; threads <= maxThreads; threads++)
+    {
+        // One thread runs without a pool, as the store does by default.
+        JobPool pool(threads);
+        store.setJobPool(threads > 1 ? &pool : 0);
+
+        double integrate = time([&store] { store.integrate(DURATION); });
+        double derived = time([&store] { store.calculateDerivedData(); });
+        if (threads == 1)
+        {
+            integrateSerial = integrate;
+            derivedSerial = derived;
+        }
+
+        printf("%7u  %14.3f  %6.2fx  %17.3f  %6.2fx\n", threads,
+               integrate, integrateSerial / integrate,
+               derived, derivedSerial / derived);
+    }
+
+    store.setJobPool(0);
+    sink = store.motion[0].position.x;
+    return 0;
+}
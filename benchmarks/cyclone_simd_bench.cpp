@@ -0,0 +1,138 @@
+/*
+ * Times each SIMD matrix and quaternion kernel, in nanoseconds per
+ * call.
+ *
+ * Build: g++ -std=c++11 -O2 -DCYCLONE_SINGLE_PRECISION -Iinclude
+ * benchmarks/cyclone_simd_bench.cpp
+ * Build it again with -DCYCLONE_NO_SIMD and compare the two runs to
+ * see what the SIMD path gains on each kernel.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+
+#include "cyclone/core.h"
+
+using namespace cyclone;
+
+namespace {
+    const unsigned COUNT = 1 << 16;
+    const unsigned ROUNDS = 200;
+
+    real random(real min, real max)
+    {
+        return min + (max - min) * ((real)rand() / (real)RAND_MAX);
+    }
+
+    /** Holds the inputs, so every call reads fresh data. */
+    struct Inputs
+    {
+        std::vector<Matrix4> matrix4;
+        std::vector<Matrix3> matrix3;
+        std::vector<Quaternion> quaternion;
+        std::vector<Vector3> vector;
+
+        Inputs() : matrix4(COUNT), matrix3(COUNT), quaternion(COUNT), vector(COUNT)
+        {
+            for (unsigned n = 0; n < COUNT; n++)
+            {
+                Quaternion q(random(-1, 1), random(-1, 1), random(-1, 1), random(-1, 1));
+                q.normalise();
+                quaternion[n] = q;
+                vector[n] = Vector3(random(-10, 10), random(-10, 10), random(-10, 10));
+                matrix4[n].setOrientationAndPos(q, vector[n]);
+                for (unsigned k = 0; k < 9; k++) matrix3[n].data[k] = random(-4, 4);
+            }
+        }
+    };
+
+    /** Keeps the results alive so the calls aren't optimised away. */
+    volatile real sink;
+
+    /**
+     * Runs the kernel over every input, ROUNDS times, and prints the
+     * time per call.
+     */
+    template <typename Kernel>
+    void time(const char *name, const Inputs &inputs, Kernel kernel)
+    {
+        real total = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (unsigned round = 0; round < ROUNDS; round++)
+        {
+            for (unsigned n = 0; n < COUNT; n++) total += kernel(inputs, n);
+        }
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        sink = total;
+
+        double nanoseconds = std::chrono::duration<double, std::nano>(end - start).count();
+        printf("%-38s %6.2f ns\n", name, nanoseconds / ((double)ROUNDS * COUNT));
+    }
+
+    unsigned next(unsigned n)
+    {
+        return (n + 1) & (COUNT - 1);
+    }
+
+    /*
+     * Each kernel returns the sum of every part of its result, so the
+     * compiler can't drop the parts a single component wouldn't need.
+     */
+
+    real sum(const Vector3 &v)
+    {
+        return v.x + v.y + v.z;
+    }
+
+    real matrix4Multiply(const Inputs &in, unsigned n)
+    {
+        Matrix4 m = in.matrix4[n] * in.matrix4[next(n)];
+        real total = 0;
+        for (unsigned k = 0; k < 12; k++) total += m.data[k];
+        return total;
+    }
+
+    real matrix4TransformInverse(const Inputs &in, unsigned n)
+    {
+        return sum(in.matrix4[n].transformInverse(in.vector[n]));
+    }
+
+    real matrix4TransformInverseDirection(const Inputs &in, unsigned n)
+    {
+        return sum(in.matrix4[n].transformInverseDirection(in.vector[n]));
+    }
+
+    real matrix3TransformTranspose(const Inputs &in, unsigned n)
+    {
+        return sum(in.matrix3[n].transformTranspose(in.vector[n]));
+    }
+
+    real quaternionMultiply(const Inputs &in, unsigned n)
+    {
+        Quaternion q = in.quaternion[n];
+        q *= in.quaternion[next(n)];
+        return q.r + q.i + q.j + q.k;
+    }
+}
+
+int main()
+{
+    srand(17);
+    Inputs inputs;
+
+#if defined(CYCLONE_SIMD_SSE)
+    printf("SSE kernels\n");
+#elif defined(CYCLONE_SIMD_NEON)
+    printf("NEON kernels\n");
+#else
+    printf("scalar kernels\n");
+#endif
+
+    time("Matrix4 * Matrix4", inputs, matrix4Multiply);
+    time("Matrix4::transformInverse", inputs, matrix4TransformInverse);
+    time("Matrix4::transformInverseDirection", inputs, matrix4TransformInverseDirection);
+    time("Matrix3::transformTranspose", inputs, matrix3TransformTranspose);
+    time("Quaternion *=", inputs, quaternionMultiply);
+    return 0;
+}
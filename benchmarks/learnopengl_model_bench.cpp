@@ -0,0 +1,100 @@
+/*
+ * Times how long a Model takes to load on a cold start, when ASSIMP
+ * imports the source and the mesh cache is written, and on a warm
+ * start, when the meshes come from the cache. An import with the
+ * cache turned off is timed too, as the baseline without any cache.
+ *
+ * Build: like the apps in Learn_openGL_board, together with glad,
+ * stb_image, ASSIMP and GLFW.
+ * Pass the model path as the first argument; the default is
+ * Learn_openGL_board/nanosuit/nanosuit.obj. The cache next to the
+ * model is rebuilt on every cold round.
+ */
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <learnopengl/model.h>
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace {
+    const unsigned int ROUNDS = 5;
+
+    enum Start {
+        START_NO_CACHE,     // ASSIMP import, no cache read or written
+        START_COLD,         // ASSIMP import, then the cache is written
+        START_WARM          // meshes read from the cache
+    };
+
+    // loads the model once and returns the seconds until it is on the GPU
+    double load(string const &path, Start start)
+    {
+        if(start == START_COLD)
+            remove(MeshCache::cachePath(path).c_str());
+
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        Model model(path, false, start != START_NO_CACHE);
+        // wait for the driver, so the uploads count as well
+        glFinish();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+        if(model.meshes.empty())
+        {
+            printf("failed to load %s\n", path.c_str());
+            exit(1);
+        }
+        if(model.loadedFromCache != (start == START_WARM))
+        {
+            printf("the %s load %s the cache\n", start == START_WARM ? "warm" : "cold", model.loadedFromCache ? "used" : "missed");
+            exit(1);
+        }
+        return seconds;
+    }
+
+    // the median time of ROUNDS loads
+    double median(string const &path, Start start)
+    {
+        vector<double> times;
+        for(unsigned int i = 0; i < ROUNDS; i++)
+            times.push_back(load(path, start));
+        sort(times.begin(), times.end());
+        return times[ROUNDS / 2];
+    }
+}
+
+int main(int argc, char **argv)
+{
+    string path = argc > 1 ? argv[1] : "Learn_openGL_board/nanosuit/nanosuit.obj";
+
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow *window = glfwCreateWindow(64, 64, "model bench", NULL, NULL);
+    if(!window || (glfwMakeContextCurrent(window), !gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)))
+    {
+        printf("failed to create an OpenGL context\n");
+        glfwTerminate();
+        return 1;
+    }
+
+    // with no budget, the textures of a model are deleted with it, so every load decodes them again
+    TextureCache::shared().setBudget(0);
+
+    double noCache = median(path, START_NO_CACHE);
+    double cold = median(path, START_COLD);
+    double warm = median(path, START_WARM);
+    printf("%s, median of %u loads\n", path.c_str(), ROUNDS);
+    printf("no cache  %8.2f ms\n", noCache * 1000.0);
+    printf("cold      %8.2f ms (cache written)\n", cold * 1000.0);
+    printf("warm      %8.2f ms (%.1fx faster than no cache)\n", warm * 1000.0, noCache / warm);
+
+    TextureCache::shared().clear();
+    glfwTerminate();
+    return 0;
+}
@@ -3,68 +3,137 @@
 
 using namespace GPED;
 
-GPED::GPEDParticle::GPEDParticle()
-	: m_position(glm::vec3(0.0)), m_velocity(glm::vec3(0.0)), m_acceleration(glm::vec3(0.0)),
-	m_forceAccum(glm::vec3(0.0)),
-	damping(1.0), inverseMass(1.0)
+static thread_local ParticleForceBuffer* currentForceBuffer = NULL;
+
+static void applyEntries(const std::vector<ParticleForceBuffer::Entry>& entries)
 {
+	for (std::vector<ParticleForceBuffer::Entry>::const_iterator e = entries.begin(); e != entries.end(); ++e)
+	{
+		ParticleStore* store = e->particle->getStore();
+		unsigned index = e->particle->getIndex();
+		store->forceAccum.x[index] += e->force.x;
+		store->forceAccum.y[index] += e->force.y;
+		store->forceAccum.z[index] += e->force.z;
+	}
+}
 
+void GPED::ParticleForceBuffer::apply() const
+{
+	applyEntries(entries);
 }
 
-void GPEDParticle::integrate(real duration)
+void GPED::ParticleForceBuffer::partition()
 {
-	//  false Ÿ   
-	assert(duration > 0.0);
-	
-	// Update linear position
-	m_position += m_velocity * duration;
+	for (unsigned r = 0; r < ranges.size(); ++r) ranges[r].clear();
+
+	for (std::vector<Entry>::const_iterator e = entries.begin(); e != entries.end(); ++e)
+	{
+		unsigned range = e->particle->getIndex() / RANGE_SIZE;
+		if (range >= ranges.size()) ranges.resize(range + 1);
+		ranges[range].push_back(*e);
+	}
+}
 
-	// Work out the acceleration from the force
-	glm::vec3 resultingAcc = m_acceleration;
-	resultingAcc += m_forceAccum * inverseMass;
+void GPED::ParticleForceBuffer::apply(unsigned range) const
+{
+	if (range < ranges.size()) applyEntries(ranges[range]);
+}
 
-	// Update linear velocity from the acceleration
-	m_velocity += resultingAcc * duration;
+ParticleForceBuffer* GPED::ParticleForceBuffer::getCurrent()
+{
+	return currentForceBuffer;
+}
 
-	// Impose drag
-	m_velocity *= real_pow(damping, duration);
+void GPED::ParticleForceBuffer::setCurrent(ParticleForceBuffer* buffer)
+{
+	currentForceBuffer = buffer;
+}
+
+GPED::GPEDParticle::GPEDParticle()
+	: store(&ParticleStore::standalone())
+{
+	handle = store->create();
+}
+
+GPED::GPEDParticle::GPEDParticle(ParticleStore* store)
+	: store(store)
+{
+	handle = store->create();
+}
+
+GPED::GPEDParticle::GPEDParticle(const GPEDParticle& other)
+	: store(other.store)
+{
+	handle = store->create();
+	*this = other;
+}
+
+GPEDParticle& GPED::GPEDParticle::operator=(const GPEDParticle& other)
+{
+	if (this == &other) return *this;
+
+	setPosition(other.getPosition());
+	unsigned index = getIndex(), otherIndex = other.getIndex();
+	store->previousPosition.x[index] = other.store->previousPosition.x[otherIndex];
+	store->previousPosition.y[index] = other.store->previousPosition.y[otherIndex];
+	store->previousPosition.z[index] = other.store->previousPosition.z[otherIndex];
+	setVelocity(other.getVelocity());
+	setAcceleration(other.getAcceleration());
+	setDamping(other.getDamping());
+	setInverseMass(other.getInverseMass());
 
 	clearAccumulator();
+	addForce(glm::vec3(
+		other.store->forceAccum.x[other.getIndex()],
+		other.store->forceAccum.y[other.getIndex()],
+		other.store->forceAccum.z[other.getIndex()]));
+	return *this;
+}
+
+GPED::GPEDParticle::~GPEDParticle()
+{
+	store->destroy(handle);
+}
+
+void GPEDParticle::integrate(real duration)
+{
+	store->integrate(getIndex(), duration);
 }
 
 void GPEDParticle::setDamping(const real damping)
 {
-	GPEDParticle::damping = damping;
+	store->damping[getIndex()] = damping;
 }
 
 real GPEDParticle::getDamping() const
 {
-	return damping;
+	return store->damping[getIndex()];
 }
 
 void GPEDParticle::setInverseMass(const real inverseMass)
 {
-	GPEDParticle::invereseMass = inverseMass;
+	store->inverseMass[getIndex()] = inverseMass;
 }
 
 real GPEDParticle::getInverseMass() const
 {
-	return inverseMass;
+	return store->inverseMass[getIndex()];
 }
 
 bool GPED::GPEDParticle::hasFiniteMass() const
 {
-	return inverseMass >= 0.0;
+	return getInverseMass() >= 0.0;
 }
 
 void GPEDParticle::setMass(const real Mass)
 {
 	assert(Mass != 0);
-	GPEDParticle::inverseMass = real(1.0) / Mass;
+	setInverseMass(real(1.0) / Mass);
 }
 
 real GPEDParticle::getMass() const
 {
+	real inverseMass = getInverseMass();
 	if (inverseMass == 0)
 		return REAL_MAX;
 	else
@@ -73,55 +142,102 @@ real GPEDParticle::getMass() const
 
 void GPEDParticle::setPosition(const glm::vec3 position)
 {
-	GPEDParticle::getPosition = position;
+	setPosition(position.x, position.y, position.z);
 }
 
 void GPEDParticle::setPosition(const real x, const real y, const real z)
 {
-	GPEDParticle::getPosition = glm::vec3(x, y, z);
+	unsigned index = getIndex();
+	store->position.x[index] = x;
+	store->position.y[index] = y;
+	store->position.z[index] = z;
+}
+
+void GPEDParticle::resetPosition(const glm::vec3 position)
+{
+	resetPosition(position.x, position.y, position.z);
+}
+
+void GPEDParticle::resetPosition(const real x, const real y, const real z)
+{
+	setPosition(x, y, z);
+
+	//  ʰ  ġ ٷ ׷  ġ  ٲ۴
+	unsigned index = getIndex();
+	store->previousPosition.x[index] = x;
+	store->previousPosition.y[index] = y;
+	store->previousPosition.z[index] = z;
+}
+
+void GPEDParticle::setAwake(const bool awake)
+{
+	store->setAwake(getIndex(), awake);
 }
 
 glm::vec3 GPEDParticle::getPosition() const
 {
-	return m_position;
+	unsigned index = getIndex();
+	return glm::vec3(store->position.x[index], store->position.y[index], store->position.z[index]);
 }
 
 void GPEDParticle::setVelocity(const glm::vec3 velocity)
 {
-	GPEDParticle::setVelocity = velocity;
+	setVelocity(velocity.x, velocity.y, velocity.z);
 }
 
 void GPEDParticle::setVelocity(const real x, const real y, const real z)
 {
-	GPEDParticle::setVelocity = glm::vec3(x, y, z);
+	unsigned index = getIndex();
+	store->velocity.x[index] = x;
+	store->velocity.y[index] = y;
+	store->velocity.z[index] = z;
 }
 
-glm::vec3 GPEDParticle::getVeclocity() const
+glm::vec3 GPEDParticle::getVelocity() const
 {
-	return m_velocity;
+	unsigned index = getIndex();
+	return glm::vec3(store->velocity.x[index], store->velocity.y[index], store->velocity.z[index]);
 }
 
 void GPEDParticle::setAcceleration(const glm::vec3 acceleration)
 {
-	GPEDParticle::getAcceleration = acceleration;
+	setAcceleration(acceleration.x, acceleration.y, acceleration.z);
 }
 
 void GPEDParticle::setAcceleration(const real x, const real y, const real z)
 {
-	GPEDParticle::getAcceleration = glm::vec3(x, y, z);
+	unsigned index = getIndex();
+	store->acceleration.x[index] = x;
+	store->acceleration.y[index] = y;
+	store->acceleration.z[index] = z;
 }
 
 glm::vec3 GPEDParticle::getAcceleration() const
 {
-	return m_acceleration;
+	unsigned index = getIndex();
+	return glm::vec3(store->acceleration.x[index], store->acceleration.y[index], store->acceleration.z[index]);
 }
 
 void GPEDParticle::clearAccumulator()
 {
-	m_forceAccum = glm::vec3(real(0.0));
+	unsigned index = getIndex();
+	store->forceAccum.x[index] = 0;
+	store->forceAccum.y[index] = 0;
+	store->forceAccum.z[index] = 0;
 }
 
 void GPEDParticle::addForce(const glm::vec3 & force)
 {
-	m_forceAccum += force;
-}
\ No newline at end of file
+	//  ۰   ߿  ϸ Ѵ
+	ParticleForceBuffer* buffer = ParticleForceBuffer::getCurrent();
+	if (buffer)
+	{
+		buffer->add(this, force);
+		return;
+	}
+
+	unsigned index = getIndex();
+	store->forceAccum.x[index] += force.x;
+	store->forceAccum.y[index] += force.y;
+	store->forceAccum.z[index] += force.z;
+}
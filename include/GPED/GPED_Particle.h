@@ -6,23 +6,103 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "GPED_Precision.h"
+#include "GPED_Pstore.h"
+
+#include <vector>
 
 namespace GPED
 {
+	class GPEDParticle;
+
+	/*
+	addForce      δ ̴.
+	帶  ۸ ϳ   , Ǿ 
+	 忡 ȣǴ addForce   ۿ  δ.
+	 忡  ⸦     applyϸ
+	 忡  Ͱ   ´.
+
+	partition()  ƼŬ index   θ   apply  ִ.
+	 ٸ   ٸ ƼŬ Ƿ  忡 ÿ ص ȴ
+	*/
+	class ParticleForceBuffer
+	{
+	public:
+		struct Entry
+		{
+			GPEDParticle* particle;
+			glm::vec3 force;
+		};
+
+		/* partition()  index  ũ */
+		static const unsigned RANGE_SIZE = 1024;
+
+		/* ϵ   */
+		std::vector<Entry> entries;
+
+		/* partition()   .  ȿ ϵ  Ѵ */
+		std::vector<std::vector<Entry> > ranges;
+
+		/*  Ѵ */
+		void add(GPEDParticle* particle, const glm::vec3& force)
+		{
+			Entry entry = { particle, force };
+			entries.push_back(entry);
+		}
+
+		/* ϵ    ƼŬ ҿ Ѵ */
+		void apply() const;
+
+		/* ϵ  ƼŬ index   */
+		void partition();
+
+		/* partition()    ȯѴ */
+		unsigned getRangeCount() const { return (unsigned)ranges.size(); }
+
+		/* partition()    ϳ    ƼŬ ҿ Ѵ */
+		void apply(unsigned range) const;
+
+		/*   (޸𸮴 Ѵ) */
+		void clear()
+		{
+			entries.clear();
+			for (unsigned r = 0; r < ranges.size(); ++r) ranges[r].clear();
+		}
+
+		/*  忡  ۸ ȯѴ.  NULL̴ */
+		static ParticleForceBuffer* getCurrent();
+
+		/*   ۸ Ѵ. NULL̸ addForce ҿ ٷ Ѵ */
+		static void setCurrent(ParticleForceBuffer* buffer);
+	};
+
+	/*
+	ƼŬ   ׸ Ű  Ͻ̴.
+	 ´ ParticleStore ӵ 迭 Ǹ,
+	 Ŭ  ڵ尡 ƼŬ ͷ   ֵ ش
+	*/
 	class GPEDParticle
 	{
 	protected:
-		glm::vec3 m_position;
-		glm::vec3 m_velocity;
-		glm::vec3 m_acceleration;
+		/* ƼŬ ¸ ϴ  */
+		ParticleStore* store;
 
-		glm::vec3 m_forceAccum;
+		/*  ȿ  ƼŬ Ű ڵ */
+		ParticleHandle handle;
 
-		real damping;
-		real inverseMass;
 	public:
+		/*  ҿ ο ƼŬ  */
 		GPEDParticle();
 
+		/* ־ ҿ ο ƼŬ  */
+		explicit GPEDParticle(ParticleStore* store);
+
+		/*  ҿ  ¸  ο ƼŬ  */
+		GPEDParticle(const GPEDParticle& other);
+		GPEDParticle& operator=(const GPEDParticle& other);
+
+		/* ҿ ƼŬ Ѵ */
+		~GPEDParticle();
+
 		void integrate(real duration);
 
 		void setDamping(const real damping);
@@ -39,9 +119,16 @@ namespace GPED
 		void setPosition(const real x, const real y, const real z);
 		glm::vec3 getPosition() const;
 
+		/*
+		ƼŬ  ̵Ų. setPosition ޸    ġ ٲٹǷ
+		   ġκ ̲  ʴ´
+		*/
+		void resetPosition(const glm::vec3 position);
+		void resetPosition(const real x, const real y, const real z);
+
 		void setVelocity(const glm::vec3 velocity);
 		void setVelocity(const real x, const real y, const real z);
-		glm::vec3 getVeclocity() const;
+		glm::vec3 getVelocity() const;
 	
 		void setAcceleration(const glm::vec3 acceleration);
 		void setAcceleration(const real x, const real y, const real z);
@@ -51,14 +138,24 @@ namespace GPED
 		void addForce(const glm::vec3& force);
 
 		/*
-		̰   ׽Ʈ ̴.
-		   ø̼ǿ ƶ.
-		ʰ OOP  Ѵٸ.
+		ƼŬ ִ ȮѴ.  ƼŬ ,  , contact  
 		*/
-		glm::vec3* getPositionPointer()
-		{
-			return &m_position;
-		}
+		bool isAwake() const { return store->isAwake(getIndex()); }
+
+		/*
+		 ƼŬ ų . 迡   ƼŬ  
+		ParticleWorld::wakeParticle ض
+		*/
+		void setAwake(const bool awake = true);
+
+		/* ƼŬ  Ҹ ȯѴ */
+		ParticleStore* getStore() const { return store; }
+
+		/*  ȿ ڵ ȯѴ */
+		ParticleHandle getHandle() const { return handle; }
+
+		/*  ȿ  index ȯѴ */
+		unsigned getIndex() const { return store->indexOf(handle); }
 	};
 }
-#endif
\ No newline at end of file
+#endif
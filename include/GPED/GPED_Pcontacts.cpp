@@ -1,3 +1,6 @@
+#include <assert.h>
+#include <algorithm>
+#include <atomic>
 #include "GPED_Pcontacts.h"
 using namespace GPED;
 
@@ -10,7 +13,7 @@ void GPED::ParticleContact::resolve(real duration)
 real GPED::ParticleContact::calculateSepartingVelocity() const
 {
 	glm::vec3 relativeVelocity = particle[0]->getVelocity();
-	if (particle[1]) relativeVelocity -= particle[1]->getVeclocity();
+	if (particle[1]) relativeVelocity -= particle[1]->getVelocity();
 	return glm::dot(relativeVelocity, contactNormal);
 }
 
@@ -56,10 +59,6 @@ void GPED::ParticleContact::resolveVelocity(real duration)
 
 	//  浹 ض
 	real impulse = deltaVelocity / totalInverseMass;
-	if (particle[0] && particle[1])
-	{
-		impulse *= particle[0]->getInverseMass()*particle[1]->getInverseMass();
-	}
 
 	//     浹  ã´
 	glm::vec3 impulsePerIMass = contactNormal * impulse;
@@ -67,14 +66,14 @@ void GPED::ParticleContact::resolveVelocity(real duration)
 	//  ض: ׵   ǰ   Ѵ
 	particle[0]->setVelocity
 	(
-		particle[0]->getVeclocity() + impulsePerIMass * particle[0]->getInverseMass()
+		particle[0]->getVelocity() + impulsePerIMass * particle[0]->getInverseMass()
 	);
 	if (particle[1])
 	{
 		//  1 ݴ  
 		particle[1]->setVelocity
 		(
-			particle[1]->setVelocity() + impulsePerIMass * -particle[0]->getInverseMass()
+			particle[1]->getVelocity() + impulsePerIMass * -particle[1]->getInverseMass()
 		);
 	}
 }
@@ -115,8 +114,8 @@ void GPED::ParticleContact::resolveInterpenetration(real duration)
 	}
 }
 
-GPED::ParticleContactResolver::ParticleContactResolver(unsigned iterations)
-	:iterations(iterations), iterationUsed(0)
+GPED::ParticleContactResolver::ParticleContactResolver(unsigned iterations, Algorithm algorithm)
+	:iterations(iterations), iterationUsed(0), algorithm(algorithm), jobPool(NULL)
 { }
 
 void GPED::ParticleContactResolver::setIterations(unsigned iterations)
@@ -124,7 +123,58 @@ void GPED::ParticleContactResolver::setIterations(unsigned iterations)
 	ParticleContactResolver::iterations = iterations;
 }
 
+void GPED::ParticleContactResolver::setAlgorithm(Algorithm algorithm)
+{
+	ParticleContactResolver::algorithm = algorithm;
+}
+
+void GPED::ParticleContactResolver::setJobPool(JobPool* pool)
+{
+	jobPool = pool;
+}
+
 void GPED::ParticleContactResolver::resolveContacts(ParticleContact* contactArray, unsigned numContacts, real duration)
+{
+	switch (algorithm)
+	{
+	case RESOLVE_PRIORITY:
+		resolveContactsPriority(contactArray, numContacts, duration);
+		break;
+	case RESOLVE_COLORED:
+		resolveContactsColored(contactArray, numContacts, duration);
+		break;
+	default:
+		resolveContactsScan(contactArray, numContacts, duration);
+		break;
+	}
+}
+
+void GPED::ParticleContactResolver::updatePenetration(ParticleContact& contact, const ParticleContact& resolved)
+{
+	const glm::vec3* move = resolved.particleMovement;
+	if (contact.particle[0] == resolved.particle[0])
+	{
+		contact.penetration -= glm::dot(move[0], contact.contactNormal);
+	}
+	else if (contact.particle[0] == resolved.particle[1])
+	{
+		contact.penetration -= glm::dot(move[1], contact.contactNormal);
+	}
+
+	if (contact.particle[1])
+	{
+		if (contact.particle[1] == resolved.particle[0])
+		{
+			contact.penetration += glm::dot(move[0], contact.contactNormal);
+		}
+		else if (contact.particle[1] == resolved.particle[1])
+		{
+			contact.penetration += glm::dot(move[1], contact.contactNormal);
+		}
+	}
+}
+
+void GPED::ParticleContactResolver::resolveContactsScan(ParticleContact* contactArray, unsigned numContacts, real duration)
 {
 	unsigned i;
 
@@ -151,30 +201,295 @@ void GPED::ParticleContactResolver::resolveContacts(ParticleContact* contactArra
 		contactArray[maxIndex].resolve(duration);
 
 		//  ƼŬ  ȣ ħ ƮѴ
-		glm::vec3* move = contactArray[maxIndex].particleMovement;
 		for (i = 0; i < numContacts; ++i)
 		{
-			if (contactArray[i].particle[0] == contactArray[maxIndex].particle[0])
+			updatePenetration(contactArray[i], contactArray[maxIndex]);
+		}
+		++iterationUsed;
+	}
+}
+
+real GPED::ParticleContactResolver::calculatePriority(const ParticleContact& contact)
+{
+	// RESOLVE_SCAN  : ٰ ְų ħ ִ contact ذѴ
+	real sepVel = contact.calculateSepartingVelocity();
+	if (sepVel < 0 || contact.penetration > 0) return sepVel;
+	return REAL_MAX;
+}
+
+bool GPED::ParticleContactResolver::heapLess(unsigned a, unsigned b) const
+{
+	//   index    (RESOLVE_SCAN  )
+	if (priority[a] != priority[b]) return priority[a] < priority[b];
+	return a < b;
+}
+
+void GPED::ParticleContactResolver::heapSwap(unsigned i, unsigned j)
+{
+	std::swap(heap[i], heap[j]);
+	heapPosition[heap[i]] = i;
+	heapPosition[heap[j]] = j;
+}
+
+void GPED::ParticleContactResolver::heapUpdate(unsigned contact)
+{
+	unsigned i = heapPosition[contact];
+
+	//  ø
+	while (i > 0)
+	{
+		unsigned parent = (i - 1) / 2;
+		if (!heapLess(heap[i], heap[parent])) break;
+		heapSwap(i, parent);
+		i = parent;
+	}
+
+	// Ʒ 
+	const unsigned size = (unsigned)heap.size();
+	for (;;)
+	{
+		unsigned smallest = i;
+		unsigned left = i * 2 + 1;
+		unsigned right = left + 1;
+		if (left < size && heapLess(heap[left], heap[smallest])) smallest = left;
+		if (right < size && heapLess(heap[right], heap[smallest])) smallest = right;
+		if (smallest == i) break;
+		heapSwap(i, smallest);
+		i = smallest;
+	}
+}
+
+void GPED::ParticleContactResolver::buildParticleContacts(ParticleContact* contactArray, unsigned numContacts)
+{
+	particleContacts.clear();
+	for (unsigned i = 0; i < numContacts; ++i)
+	{
+		particleContacts.push_back(std::make_pair(contactArray[i].particle[0], i));
+		if (contactArray[i].particle[1])
+			particleContacts.push_back(std::make_pair(contactArray[i].particle[1], i));
+	}
+	std::sort(particleContacts.begin(), particleContacts.end());
+
+	contactParticles.assign(numContacts * 2, INVALID_PARTICLE_HANDLE);
+	particleStart.clear();
+	for (unsigned k = 0; k < particleContacts.size(); ++k)
+	{
+		if (k == 0 || particleContacts[k].first != particleContacts[k - 1].first)
+			particleStart.push_back(k);
+
+		unsigned particle = (unsigned)particleStart.size() - 1;
+		unsigned contact = particleContacts[k].second;
+		unsigned side = (contactArray[contact].particle[0] == particleContacts[k].first) ? 0 : 1;
+		contactParticles[contact * 2 + side] = particle;
+	}
+	particleStart.push_back((unsigned)particleContacts.size());
+}
+
+void GPED::ParticleContactResolver::resolveContactsPriority(ParticleContact* contactArray, unsigned numContacts, real duration)
+{
+	iterationUsed = 0;
+	if (numContacts == 0) return;
+
+	// ƼŬ  ִ contact  
+	buildParticleContacts(contactArray, numContacts);
+
+	//  contact  ִ´ (ĵ 迭 ״ ùٸ ̴)
+	priority.resize(numContacts);
+	heap.resize(numContacts);
+	heapPosition.resize(numContacts);
+	for (unsigned i = 0; i < numContacts; ++i)
+	{
+		priority[i] = calculatePriority(contactArray[i]);
+		heap[i] = i;
+	}
+	std::sort(heap.begin(), heap.end(), [this](unsigned a, unsigned b) { return heapLess(a, b); });
+	for (unsigned i = 0; i < numContacts; ++i)
+	{
+		heapPosition[heap[i]] = i;
+	}
+
+	visited.assign(numContacts, 0);
+	while (iterationUsed < iterations)
+	{
+		//  ū closing ӵ     ִ
+		unsigned maxIndex = heap[0];
+		if (priority[maxIndex] == REAL_MAX) break;
+
+		//  contact ذѴ
+		contactArray[maxIndex].resolve(duration);
+		++iterationUsed;
+
+		//  ƼŬ  contact Ѵ
+		for (unsigned side = 0; side < 2; ++side)
+		{
+			unsigned particle = contactParticles[maxIndex * 2 + side];
+			if (particle == INVALID_PARTICLE_HANDLE) continue;
+
+			for (unsigned k = particleStart[particle]; k < particleStart[particle + 1]; ++k)
 			{
-				contactArray[i].penetration -= glm::dot(move[0], contactArray[i].contactNormal);
+				unsigned contact = particleContacts[k].second;
+				if (visited[contact] == iterationUsed) continue;
+				visited[contact] = iterationUsed;
+
+				updatePenetration(contactArray[contact], contactArray[maxIndex]);
+				priority[contact] = calculatePriority(contactArray[contact]);
+				heapUpdate(contact);
 			}
-			else if (contactArray[i].particle[0] == contactArray[maxIndex].particle[1])
+		}
+	}
+}
+
+void GPED::ParticleContactResolver::colorContacts(unsigned numContacts)
+{
+	const unsigned particleCount = (unsigned)particleStart.size() - 1;
+
+	// Ž ĥ:  contact ڱ ƼŬ       ޴´
+	colorMask.assign(particleCount, 0);
+	contactColor.resize(numContacts);
+	unsigned numColors = 0;
+	for (unsigned i = 0; i < numContacts; ++i)
+	{
+		unsigned a = contactParticles[i * 2];
+		unsigned b = contactParticles[i * 2 + 1];
+		unsigned long long used = colorMask[a];
+		if (b != INVALID_PARTICLE_HANDLE) used |= colorMask[b];
+
+		// 64   ٸ     óѴ
+		unsigned color = 0;
+		while (color < MAX_CONTACT_COLORS && (used & (1ull << color))) ++color;
+		contactColor[i] = color;
+
+		if (color < MAX_CONTACT_COLORS)
+		{
+			colorMask[a] |= 1ull << color;
+			if (b != INVALID_PARTICLE_HANDLE) colorMask[b] |= 1ull << color;
+		}
+		if (color + 1 > numColors) numColors = color + 1;
+	}
+
+	//   contact þ´ (  ȿ   Ѵ)
+	colorStart.assign(numColors + 1, 0);
+	for (unsigned i = 0; i < numContacts; ++i) ++colorStart[contactColor[i] + 1];
+	for (unsigned c = 1; c <= numColors; ++c) colorStart[c] += colorStart[c - 1];
+
+	colorContactList.resize(numContacts);
+	std::vector<unsigned> cursor(colorStart.begin(), colorStart.end() - 1);
+	for (unsigned i = 0; i < numContacts; ++i)
+		colorContactList[cursor[contactColor[i]]++] = i;
+}
+
+bool GPED::ParticleContactResolver::resolveColoredContact(ParticleContact* contactArray, unsigned index, real duration)
+{
+	ParticleContact& contact = contactArray[index];
+	unsigned a = contactParticles[index * 2];
+	unsigned b = contactParticles[index * 2 + 1];
+
+	// ٸ contact  ƼŬ  ŭ ħ ̸ ٽ Ѵ
+	glm::vec3 moved = displacement[a];
+	if (b != INVALID_PARTICLE_HANDLE) moved -= displacement[b];
+	contact.penetration = startPenetration[index] - glm::dot(moved, contact.contactNormal);
+
+	real sepVel = contact.calculateSepartingVelocity();
+	if (sepVel >= 0 && contact.penetration <= 0) return false;
+
+	contact.resolve(duration);
+
+	//   ٸ contact  ƼŬ ǵ帮 Ƿ ϰ   ִ
+	if (contact.penetration > 0)
+	{
+		displacement[a] += contact.particleMovement[0];
+		if (b != INVALID_PARTICLE_HANDLE) displacement[b] += contact.particleMovement[1];
+	}
+	return true;
+}
+
+void GPED::ParticleContactResolver::resolveContactsColored(ParticleContact* contactArray, unsigned numContacts, real duration)
+{
+	iterationUsed = 0;
+	if (numContacts == 0) return;
+
+	buildParticleContacts(contactArray, numContacts);
+	colorContacts(numContacts);
+
+	const unsigned particleCount = (unsigned)particleStart.size() - 1;
+	displacement.assign(particleCount, glm::vec3(0));
+	startPenetration.resize(numContacts);
+	for (unsigned i = 0; i < numContacts; ++i)
+		startPenetration[i] = contactArray[i].penetration;
+
+	// iteration  contact  ذ Ƚ  ü ݺ Ƚ Ѵ
+	unsigned sweeps = iterations / numContacts;
+	if (sweeps < 1) sweeps = 1;
+
+	const unsigned numColors = (unsigned)colorStart.size() - 1;
+	for (unsigned sweep = 0; sweep < sweeps; ++sweep)
+	{
+		std::atomic<unsigned> resolved(0);
+
+		for (unsigned color = 0; color < numColors; ++color)
+		{
+			const unsigned begin = colorStart[color];
+			const unsigned end = colorStart[color + 1];
+
+			//  ڶ  contact  ƼŬ   Ƿ   óѴ
+			bool serial = (color >= MAX_CONTACT_COLORS) || !jobPool;
+			if (serial)
 			{
-				contactArray[i].penetration -= glm::dot(move[1], contactArray[i].contactNormal);
+				unsigned count = 0;
+				for (unsigned k = begin; k < end; ++k)
+					if (resolveColoredContact(contactArray, colorContactList[k], duration)) ++count;
+				resolved += count;
+				continue;
 			}
 
-			if (contactArray[i].particle[1])
+			const unsigned chunks = (end - begin + COLOR_CHUNK_SIZE - 1) / COLOR_CHUNK_SIZE;
+			jobPool->parallelFor(chunks, [&](unsigned chunk, unsigned)
 			{
-				if (contactArray[i].particle[1] == contactArray[maxIndex].particle[0])
-				{
-					contactArray[i].penetration += glm::dot(move[0], contactArray[i].contactNormal);
-				}
-				else if (contactArray[i].particle[1] == contactArray[maxIndex].particle[1])
-				{
-					contactArray[i].penetration += glm::dot(move[1], contactArray[i].contactNormal);
-				}
-			}
+				unsigned first = begin + chunk * COLOR_CHUNK_SIZE;
+				unsigned last = std::min(first + COLOR_CHUNK_SIZE, end);
+				unsigned count = 0;
+				for (unsigned k = first; k < last; ++k)
+					if (resolveColoredContact(contactArray, colorContactList[k], duration)) ++count;
+				resolved += count;
+			});
 		}
-		++iterationUsed;
+
+		iterationUsed += resolved;
+		if (resolved == 0) break;
 	}
-}
\ No newline at end of file
+
+	//  ħ ̸ contact 
+	for (unsigned i = 0; i < numContacts; ++i)
+	{
+		unsigned a = contactParticles[i * 2];
+		unsigned b = contactParticles[i * 2 + 1];
+		glm::vec3 moved = displacement[a];
+		if (b != INVALID_PARTICLE_HANDLE) moved -= displacement[b];
+		contactArray[i].penetration = startPenetration[i] - glm::dot(moved, contactArray[i].contactNormal);
+	}
+}
+
+GPED::ParticleContactArena::ParticleContactArena(unsigned capacity)
+	: contacts(capacity > 0 ? capacity : 1), used(0), lastFrameCount(0), highWater(0), growCount(0)
+{
+}
+
+void GPED::ParticleContactArena::reset()
+{
+	lastFrameCount = used;
+	used = 0;
+}
+
+void GPED::ParticleContactArena::grow()
+{
+	contacts.resize(contacts.size() * 2);
+	++growCount;
+}
+
+void GPED::ParticleContactArena::commit(unsigned count)
+{
+	assert(used + count <= capacity());
+
+	used += count;
+	if (used > highWater) highWater = used;
+}
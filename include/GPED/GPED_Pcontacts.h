@@ -2,6 +2,8 @@
 #define __GPED_PCONTACTS_H__
 
 #include "GPED_Particle.h"
+#include "GPED_Pjobs.h"
+#include <vector>
 
 namespace GPED
 {
@@ -77,6 +79,36 @@ namespace GPED
 	*/
 	class ParticleContactResolver
 	{
+	public:
+		/*
+		  contact  
+		*/
+		enum Algorithm
+		{
+			/*
+			 iteration  contact ٽ ȴ´.
+			contact    
+			*/
+			RESOLVE_SCAN,
+
+			/*
+			contact и ӵ   ְ, ƼŬ  ִ contact  .
+			ϳ ذ ڿ  ƼŬ  contact ٽ ϹǷ
+			iteration   contact  ƴ϶ ֺ contact  Ѵ.
+			   RESOLVE_SCAN 
+			*/
+			RESOLVE_PRIORITY,
+
+			/*
+			ƼŬ  ʴ contact   ,  ϳ ۾ Ǯ ÿ ذѴ.
+			 ̿ Gauss-Seideló    ٷ Ѵ.
+			contact ϳ ذ RESOLVE_SCAN  resolve   ٸǷ
+			  ʴ.     .
+			iteration  contact   ü ݺ Ƚ δ
+			*/
+			RESOLVE_COLORED
+		};
+
 	protected:
 		/*
 		㰡 iteration ڸ Ѵ.
@@ -86,23 +118,112 @@ namespace GPED
 		/*
 		̰ traking value ̴ - 츮 ǰ ִ iteration  ڸ  ̴.
 		*/
-		unsgiend iterationUsed;
+		unsigned iterationUsed;
+
+		/*
+		 ˰
+		*/
+		Algorithm algorithm;
+
+		/*
+		RESOLVE_PRIORITY ۾  (ȣ⸶ ٽ ä ޸𸮴 ȴ)
+		*/
+		/* (ƼŬ, contact index)  ƼŬ    */
+		std::vector<std::pair<GPEDParticle*, unsigned> > particleContacts;
+		/* ƼŬ k  contact particleContacts[particleStart[k] .. particleStart[k+1]) ̴ */
+		std::vector<unsigned> particleStart;
+		/* contact  ƼŬ ȣ (scenery INVALID) */
+		std::vector<unsigned> contactParticles;
+		/*    ġ, 켱  */
+		std::vector<unsigned> heap;
+		std::vector<unsigned> heapPosition;
+		std::vector<real> priority;
+		/*  iteration ̹  contact ǥѴ */
+		std::vector<unsigned> visited;
+
+		/*
+		RESOLVE_COLORED ۾ 
+		*/
+		/*  ִ . ƼŬ ϳ ̺  contact   contact   óѴ */
+		static const unsigned MAX_CONTACT_COLORS = 64;
+		/* ۾ Ǯ  ۾ ô contact  */
+		static const unsigned COLOR_CHUNK_SIZE = 64;
+		/* ƼŬ ̹   Ʈ ũ */
+		std::vector<unsigned long long> colorMask;
+		std::vector<unsigned> contactColor;
+		/*  c contact colorContactList[colorStart[c] .. colorStart[c+1]) ̴ */
+		std::vector<unsigned> colorStart;
+		std::vector<unsigned> colorContactList;
+		/* ذ    ƼŬ  Ÿ */
+		std::vector<glm::vec3> displacement;
+		/* ذ   ħ  */
+		std::vector<real> startPenetration;
+
+		/*
+		RESOLVE_COLORED  ۾ Ǯ. NULL̸     óѴ
+		*/
+		JobPool* jobPool;
 
 	public:
 		/*
 		ο contact resolver Ѵ.
 		*/
-		ParticleContactResolver(unsigned iterations);
+		ParticleContactResolver(unsigned iterations, Algorithm algorithm = RESOLVE_SCAN);
 
 		/*
 		밡 iteration  Ѵ.
 		*/
 		void setIterations(unsigned iterations);
 
+		/*
+		 ˰ Ѵ.
+		*/
+		void setAlgorithm(Algorithm algorithm);
+
+		/*
+		RESOLVE_COLORED  ۾ Ǯ Ѵ. Ǯ resolver  ʴ´.
+		*/
+		void setJobPool(JobPool* pool);
+
+		/*
+		 ȣ⿡  iteration  ȯѴ.
+		*/
+		unsigned getIterationsUsed() const { return iterationUsed; }
+
 		/*
 		ħ  ӵ    Ʈ ؼѴ.		
 		*/
 		void resolveContacts(ParticleContact* contactArray, unsigned numContacts, real duration);
+
+	protected:
+		/* RESOLVE_SCAN  ؼѴ */
+		void resolveContactsScan(ParticleContact* contactArray, unsigned numContacts, real duration);
+
+		/* RESOLVE_PRIORITY  ؼѴ */
+		void resolveContactsPriority(ParticleContact* contactArray, unsigned numContacts, real duration);
+
+		/* RESOLVE_COLORED  ؼѴ */
+		void resolveContactsColored(ParticleContact* contactArray, unsigned numContacts, real duration);
+
+		/* ƼŬ  ִ contact ϰ contact ƼŬ ȣ  */
+		void buildParticleContacts(ParticleContact* contactArray, unsigned numContacts);
+
+		/* contact ĥϰ     */
+		void colorContacts(unsigned numContacts);
+
+		/* RESOLVE_COLORED contact ϳ ذѴ. ذ true ȯѴ */
+		bool resolveColoredContact(ParticleContact* contactArray, unsigned index, real duration);
+
+		/* ذ contact ̵ ݿ ٸ contact ħ ̸ Ѵ */
+		static void updatePenetration(ParticleContact& contact, const ParticleContact& resolved);
+
+		/* contact 켱 Ѵ. ذ ʿ䰡  REAL_MAX̴ */
+		static real calculatePriority(const ParticleContact& contact);
+
+		/*   */
+		bool heapLess(unsigned a, unsigned b) const;
+		void heapSwap(unsigned i, unsigned j);
+		void heapUpdate(unsigned contact);
 	};
 
 	/*
@@ -120,4 +241,74 @@ namespace GPED
 		virtual unsigned addContact(ParticleContact* contact, unsigned limit) const = 0;
 	};
 
-}
\ No newline at end of file
+	/*
+	Ӹ ٽ ̴, ũⰡ þ contact ̴.
+	reset   ǵ ޸𸮴 ϹǷ  ū Ӹŭ ڶ ڿ
+	 ̻ ޸𸮸 Ҵ ʴ´.
+	contact ׻   ־ ״ resolver ѱ  ִ.
+	۰ ڶ contact ּҰ ٲǷ   Ű ʹ  grow  ȿϴ
+	*/
+	class ParticleContactArena
+	{
+	protected:
+		/* contact  . ũⰡ  뷮̴ */
+		std::vector<ParticleContact> contacts;
+
+		/* ̹ ӿ  contact  */
+		unsigned used;
+
+		/*  ӿ  contact  */
+		unsigned lastFrameCount;
+
+		/* ݱ  ӿ    contact  */
+		unsigned highWater;
+
+		/*   ø Ƚ */
+		unsigned growCount;
+
+	public:
+		explicit ParticleContactArena(unsigned capacity = 256);
+
+		/*
+		  Ѵ.   contact  ޸𸮴 Ѵ
+		*/
+		void reset();
+
+		/*
+		뷮   ø.   contact ״ Ű
+		*/
+		void grow();
+
+		/*
+		 contact  count   ǥѴ
+		*/
+		void commit(unsigned count);
+
+		/* ù ° contact ȯѴ */
+		ParticleContact* data() { return &contacts[0]; }
+
+		/* ó   contact ȯѴ */
+		ParticleContact* end() { return &contacts[0] + used; }
+
+		/* ̹ ӿ  contact  ȯѴ */
+		unsigned size() const { return used; }
+
+		/*   ִ contact  ȯѴ */
+		unsigned capacity() const { return (unsigned)contacts.size(); }
+
+		/*  contact  ȯѴ */
+		unsigned available() const { return capacity() - used; }
+
+		/*  ӿ  contact  ȯѴ */
+		unsigned getLastFrameCount() const { return lastFrameCount; }
+
+		/* ݱ  ӿ    contact  ȯѴ */
+		unsigned getHighWater() const { return highWater; }
+
+		/*   ø Ƚ ȯѴ */
+		unsigned getGrowCount() const { return growCount; }
+	};
+
+}
+
+#endif
\ No newline at end of file
@@ -1,3 +1,6 @@
+#include <assert.h>
+#include <algorithm>
+#include <typeinfo>
 #include "GPED_Pfgen.h"
 
 using namespace GPED;
@@ -16,6 +19,16 @@ void GPED::ParticleGravity::updateForce(GPEDParticle* particle, real duration)
 	particle->addForce(gravity*particle->getMass());
 }
 
+void GPED::ParticleGravity::updateForces(GPEDParticle* const* particles, unsigned count, real duration)
+{
+	for (unsigned i = 0; i < count; ++i)
+	{
+		GPEDParticle* particle = particles[i];
+		if (!particle->isAwake() || !particle->hasFiniteMass()) continue;
+		particle->addForce(gravity*particle->getMass());
+	}
+}
+
 GPED::ParticleDrag::ParticleDrag(real k1, real k2)
 {
 	ParticleDrag::k1 = k1;
@@ -26,8 +39,9 @@ void GPED::ParticleDrag::updateForce(GPEDParticle * particle, real duration)
 {
 	glm::vec3 force = particle->getVelocity();
 
-	//    ض
+	//    ض.     
 	real dragCoeff = glm::length(force);
+	if (dragCoeff <= 0) return;
 	dragCoeff = k1 * dragCoeff + k2 * dragCoeff * dragCoeff;
 
 	//   ϰ ض
@@ -36,18 +50,36 @@ void GPED::ParticleDrag::updateForce(GPEDParticle * particle, real duration)
 	particle->addForce(force);
 }
 
+void GPED::ParticleDrag::updateForces(GPEDParticle* const* particles, unsigned count, real duration)
+{
+	for (unsigned i = 0; i < count; ++i)
+	{
+		if (!particles[i]->isAwake()) continue;
+
+		glm::vec3 force = particles[i]->getVelocity();
+
+		real dragCoeff = glm::length(force);
+		if (dragCoeff <= 0) continue;
+		dragCoeff = k1 * dragCoeff + k2 * dragCoeff * dragCoeff;
+
+		force = glm::normalize(force);
+		force *= -dragCoeff;
+		particles[i]->addForce(force);
+	}
+}
+
 GPED::ParticleSpring::ParticleSpring(GPEDParticle* other, real springConstant, real restLength)
 {
 	ParticleSpring::other = other;
 	ParticleSpring::springConstant = springConstant;
-	ParticleSpring::restlength = restlength;
+	ParticleSpring::restLength = restLength;
 }
 
 void GPED::ParticleSpring::updateForce(GPEDParticle* particle, real duration)
 {
 	//  ͸ Ѵ
 	glm::vec3 force = particle->getPosition();
-	force -= *anchor;
+	force -= other->getPosition();
 
 	//  ũ⸦ Ѵ
 	real magnitude = glm::length(force);
@@ -86,6 +118,29 @@ void GPED::ParticleBungee::updateForce(GPEDParticle* particle, real duration)
 	particle->addForce(force);
 }
 
+GPED::ParticleAnchoredSpring::ParticleAnchoredSpring(glm::vec3* anchor, real springConstant, real restLength)
+{
+	ParticleAnchoredSpring::anchor = anchor;
+	ParticleAnchoredSpring::springConstant = springConstant;
+	ParticleAnchoredSpring::restLength = restLength;
+}
+
+void GPED::ParticleAnchoredSpring::updateForce(GPEDParticle* particle, real duration)
+{
+	//  ͸ Ѵ
+	glm::vec3 force = particle->getPosition();
+	force -= *anchor;
+
+	//  ũ⸦ Ѵ
+	real magnitude = glm::length(force);
+	magnitude = (restLength - magnitude) * springConstant;
+
+	//   ϰ ض
+	force = glm::normalize(force);
+	force *= magnitude;
+	particle->addForce(force);
+}
+
 void GPED::ParticleAnchoredBungee::updateForce(GPEDParticle* particle, real duration)
 {
 	//  ͸ Ѵ
@@ -101,18 +156,18 @@ void GPED::ParticleAnchoredBungee::updateForce(GPEDParticle* particle, real dura
 	//   ϰ Ѵ
 	force = glm::normalize(force);
 	force *= -magnitude;
-	particle->addFroce(force);
+	particle->addForce(force);
 }
 
 GPED::ParticleBuoyancy::ParticleBuoyancy(real maxDepth, real volume, real waterHeight, real liquidDensity)
 {
 	ParticleBuoyancy::maxDepth = maxDepth;
-	ParticleBuoyance::volume = volume;
-	ParticleBuoyance::waterHeight = waterHeight;
+	ParticleBuoyancy::volume = volume;
+	ParticleBuoyancy::waterHeight = waterHeight;
 	ParticleBuoyancy::liquidDensity = liquidDensity;
 }
 
-void GPED::ParticleBuoyany::updateForce(GPEDParticle* particle, real duration)
+void GPED::ParticleBuoyancy::updateForce(GPEDParticle* particle, real duration)
 {
 	//  ̸ Ѵ
 	real depth = particle->getPosition().y;
@@ -134,27 +189,291 @@ void GPED::ParticleBuoyany::updateForce(GPEDParticle* particle, real duration)
 	particle->addForce(force);
 }
 
-void GPED::ParticleForceRegistry::add(GPEDParticle* particle, ParticleForceGenerator* fg)
+GPED::ParticleForceRegistry::ParticleForceRegistry()
+	: awakeDirty(true)
+{
+}
+
+ForceRegistrationHandle GPED::ParticleForceRegistry::add(GPEDParticle* particle, ParticleForceGenerator* fg)
+{
+	awakeDirty = true;
+
+	ForceRegistrationHandle handle;
+	if (!freeHandles.empty())
+	{
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+	}
+	else
+	{
+		handle = (ForceRegistrationHandle)slots.size();
+		slots.push_back(RegistrationSlot());
+	}
+
+	RegistrationSlot& slot = slots[handle];
+	slot.particle = particle;
+	slot.fg = fg;
+
+	// Ȯ ParticleGravity ParticleDrag  ׷쿡 ִ´
+	// (Ļ Ŭ updateForce ٲ  Ƿ Ϲ Ͽ ִ´)
+	bool groupable = typeid(*fg) == typeid(ParticleGravity) || typeid(*fg) == typeid(ParticleDrag);
+	if (groupable)
+	{
+		std::unordered_map<ParticleForceGenerator*, unsigned>::iterator found = groupOf.find(fg);
+		unsigned group;
+		if (found != groupOf.end())
+		{
+			group = found->second;
+		}
+		else
+		{
+			group = (unsigned)groups.size();
+			groups.push_back(GeneratorGroup());
+			groups[group].fg = fg;
+			groups[group].kind = typeid(*fg) == typeid(ParticleGravity) ? GROUP_GRAVITY : GROUP_DRAG;
+			groupOf[fg] = group;
+		}
+
+		slot.list = group;
+		slot.index = (unsigned)groups[group].particles.size();
+		groups[group].particles.push_back(particle);
+		groups[group].handles.push_back(handle);
+	}
+	else
+	{
+		slot.list = GENERIC_LIST;
+		slot.index = (unsigned)registrations.size();
+		ParticleForceRegistration registration = { particle, fg, handle };
+		registrations.push_back(registration);
+	}
+
+	PairKey key = { particle, fg };
+	pairs.insert(std::make_pair(key, handle));
+	return handle;
+}
+
+void GPED::ParticleForceRegistry::remove(ForceRegistrationHandle handle)
+{
+	RegistrationSlot& slot = slots[handle];
+	assert(slot.fg != NULL);
+	awakeDirty = true;
+
+	//  ׸  ڸ ű
+	if (slot.list == GENERIC_LIST)
+	{
+		ParticleForceRegistration& last = registrations.back();
+		slots[last.handle].index = slot.index;
+		registrations[slot.index] = last;
+		registrations.pop_back();
+	}
+	else
+	{
+		GeneratorGroup& group = groups[slot.list];
+		ForceRegistrationHandle moved = group.handles.back();
+		slots[moved].index = slot.index;
+		group.particles[slot.index] = group.particles.back();
+		group.handles[slot.index] = moved;
+		group.particles.pop_back();
+		group.handles.pop_back();
+
+		// Ⱑ Ǹ  ּҿ ٸ  Ⱑ   Ƿ  ׷ ٷ 
+		if (group.particles.empty()) removeGroup(slot.list);
+	}
+
+	//  ǥ 
+	PairKey key = { slot.particle, slot.fg };
+	std::pair<PairMap::iterator, PairMap::iterator> range = pairs.equal_range(key);
+	for (PairMap::iterator i = range.first; i != range.second; ++i)
+	{
+		if (i->second == handle)
+		{
+			pairs.erase(i);
+			break;
+		}
+	}
+
+	slot.particle = NULL;
+	slot.fg = NULL;
+	freeHandles.push_back(handle);
+}
+
+void GPED::ParticleForceRegistry::removeGroup(unsigned group)
 {
-	registrations.push_back(ParticleForceRegistration{ particle,fg });
+	groupOf.erase(groups[group].fg);
+
+	//  ׷  ڸ ű  ׷   ȣ Ű Ѵ
+	unsigned last = (unsigned)groups.size() - 1;
+	if (group != last)
+	{
+		std::swap(groups[group], groups[last]);
+		for (unsigned i = 0; i < groups[group].handles.size(); ++i)
+			slots[groups[group].handles[i]].list = group;
+		groupOf[groups[group].fg] = group;
+	}
+	groups.pop_back();
 }
 
 void GPED::ParticleForceRegistry::remove(GPEDParticle* particle, ParticleForceGenerator* fg)
 {
-	Registry::iterator i = registrations.begin();
-	for (; i != registrations.end(); ++i)
-		if (i->particle == particle && i->fg == fg)
-			registrations.erase(i);
+	PairKey key = { particle, fg };
+	for (;;)
+	{
+		PairMap::iterator found = pairs.find(key);
+		if (found == pairs.end()) return;
+		remove(found->second);
+	}
 }
 
 void GPED::ParticleForceRegistry::clear()
 {
 	registrations.clear();
+	groups.clear();
+	groupOf.clear();
+	slots.clear();
+	freeHandles.clear();
+	pairs.clear();
+	awakeRegistrations.clear();
+	storeVersions.clear();
+	awakeDirty = true;
+}
+
+unsigned GPED::ParticleForceRegistry::size() const
+{
+	return (unsigned)(slots.size() - freeHandles.size());
 }
 
 void GPED::ParticleForceRegistry::updateForces(real duration)
 {
-	Registry::iterator i = registrations.begin();
-	for (; i != registrations.end(); ++i)
-		i->fg->updateForce(i->particle, duration);
-}
\ No newline at end of file
+	//  ƼŬ   ʴ´
+	refreshAwake();
+
+	Chunk generic = { GENERIC_LIST, 0, (unsigned)awakeRegistrations.size() };
+	runChunk(generic, duration);
+
+	for (unsigned g = 0; g < groups.size(); ++g)
+	{
+		Chunk chunk = { g, 0, (unsigned)groups[g].awakeParticles.size() };
+		runChunk(chunk, duration);
+	}
+}
+
+void GPED::ParticleForceRegistry::refreshAwake()
+{
+	// ϵ  ġ ״ζ   ״ 
+	if (!awakeDirty && !storeVersions.changed()) return;
+
+	storeVersions.clear();
+
+	awakeRegistrations.clear();
+	for (unsigned i = 0; i < registrations.size(); ++i)
+	{
+		GPEDParticle* particle = registrations[i].particle;
+		storeVersions.note(particle->getStore());
+		if (particle->isAwake()) awakeRegistrations.push_back(i);
+	}
+
+	for (unsigned g = 0; g < groups.size(); ++g)
+	{
+		GeneratorGroup& group = groups[g];
+		group.awakeParticles.clear();
+		for (unsigned i = 0; i < group.particles.size(); ++i)
+		{
+			GPEDParticle* particle = group.particles[i];
+			storeVersions.note(particle->getStore());
+			if (particle->isAwake()) group.awakeParticles.push_back(particle);
+		}
+	}
+
+	awakeDirty = false;
+}
+
+void GPED::ParticleForceRegistry::updateForces(real duration, JobPool& pool)
+{
+	refreshAwake();
+	buildChunks();
+	const unsigned count = (unsigned)chunks.size();
+	if (count <= 1 || pool.getThreadCount() == 1)
+	{
+		updateForces(duration);
+		return;
+	}
+
+	if (chunkForces.size() < count) chunkForces.resize(count);
+
+	pool.parallelFor(count, [this, duration](unsigned chunk, unsigned)
+	{
+		ParticleForceBuffer& buffer = chunkForces[chunk];
+		buffer.clear();
+
+		//  ۾    ۿ ϵȴ
+		ParticleForceBuffer* previous = ParticleForceBuffer::getCurrent();
+		ParticleForceBuffer::setCurrent(&buffer);
+		runChunk(chunks[chunk], duration);
+		ParticleForceBuffer::setCurrent(previous);
+
+		// ϴ ܰ谡 ƼŬ     ֵ ̸  д
+		buffer.partition();
+	});
+
+	unsigned ranges = 0;
+	for (unsigned chunk = 0; chunk < count; ++chunk)
+		ranges = std::max(ranges, chunkForces[chunk].getRangeCount());
+
+	//  ۾   ؼ  ƼŬ   Ű  Ѵ
+	pool.parallelFor(ranges, [this, count](unsigned range, unsigned)
+	{
+		for (unsigned chunk = 0; chunk < count; ++chunk)
+			chunkForces[chunk].apply(range);
+	});
+}
+
+void GPED::ParticleForceRegistry::buildChunks()
+{
+	chunks.clear();
+
+	// Ϲ  ,   ׷  updateForces   Ѵ
+	unsigned count = (unsigned)awakeRegistrations.size();
+	for (unsigned begin = 0; begin < count; begin += PARALLEL_CHUNK_SIZE)
+	{
+		Chunk chunk = { GENERIC_LIST, begin, std::min(begin + PARALLEL_CHUNK_SIZE, count) };
+		chunks.push_back(chunk);
+	}
+
+	for (unsigned g = 0; g < groups.size(); ++g)
+	{
+		count = (unsigned)groups[g].awakeParticles.size();
+		for (unsigned begin = 0; begin < count; begin += PARALLEL_CHUNK_SIZE)
+		{
+			Chunk chunk = { g, begin, std::min(begin + PARALLEL_CHUNK_SIZE, count) };
+			chunks.push_back(chunk);
+		}
+	}
+}
+
+void GPED::ParticleForceRegistry::runChunk(const Chunk& chunk, real duration)
+{
+	if (chunk.list == GENERIC_LIST)
+	{
+		for (unsigned i = chunk.begin; i < chunk.end; ++i)
+		{
+			ParticleForceRegistration& registration = registrations[awakeRegistrations[i]];
+			registration.fg->updateForce(registration.particle, duration);
+		}
+		return;
+	}
+
+	GeneratorGroup& group = groups[chunk.list];
+	if (chunk.end <= chunk.begin) return;
+
+	GPEDParticle* const* particles = &group.awakeParticles[chunk.begin];
+	unsigned count = chunk.end - chunk.begin;
+	switch (group.kind)
+	{
+	case GROUP_GRAVITY:
+		static_cast<ParticleGravity*>(group.fg)->updateForces(particles, count, duration);
+		break;
+	case GROUP_DRAG:
+		static_cast<ParticleDrag*>(group.fg)->updateForces(particles, count, duration);
+		break;
+	}
+}
@@ -6,12 +6,15 @@
 */
 
 #include "GPED_Particle.h"
+#include "GPED_Pjobs.h"
 #include <vector>
+#include <unordered_map>
 
 namespace GPED
 {
 	class ParticleForceGenerator
 	{
+	public:
 		/*
 		־ ƼŬ   ϰ Ʈϱ 
 		̽  εض
@@ -33,6 +36,9 @@ namespace GPED
 
 		/* ־ ƼŬ ߷  Ѵ */
 		virtual void updateForce(GPEDParticle* particle, real duration);
+
+		/*  ƼŬ  ȣ  ߷  Ѵ.  ƼŬ ǳʶڴ */
+		void updateForces(GPEDParticle* const* particles, unsigned count, real duration);
 	};
 
 	/*
@@ -53,6 +59,9 @@ namespace GPED
 
 		/* ־ ƼŬ  Ѵ */
 		virtual void updateForce(GPEDParticle* particle, real duration);
+
+		/*  ƼŬ  ȣ   Ѵ.  ƼŬ ǳʶڴ */
+		void updateForces(GPEDParticle* const* particles, unsigned count, real duration);
 	};
 
 	/*
@@ -67,7 +76,7 @@ namespace GPED
 		real springConstant;
 
 		/*   ̸ Ѵ */
-		real restlength;
+		real restLength;
 
 	public:
 		/* ־ Ű ο  Ѵ */
@@ -176,19 +185,159 @@ namespace GPED
 		virtual void updateForce(GPEDParticle* particle, real duration);
 	};
 
+	/*
+	 ϳ Ű ڵ̴. ٸ  ŵǾ ٲ ʴ´
+	*/
+	typedef unsigned ForceRegistrationHandle;
+
+	/* ȿ   ڵ Ÿ */
+	const ForceRegistrationHandle INVALID_FORCE_REGISTRATION = ~0u;
+
 	/*
 	   ׵ ϴ ƼŬ Ѵ
+
+	ParticleGravity ParticleDrag   νϽ ׷ Ƽ
+	׷츶 ϳ 񰡻  óѴ.   ϸ  ȣ Ѵ.
+	  Ϲ   ̰,   ׷ ̴.
+	 ƼŬ  ϸ    ִ  Ͽ Ƿ    ʴ´.
+	   ٲų ƼŬ  getLayoutVersion() ٲ ӿ ٽ .
+	  ŵ ׷ ٷ ,  ׷  ڸ Ű.
+	Ŵ  ׸  ڸ ű swap-and-pop̹Ƿ O(1)̴
 	*/
 	class ParticleForceRegistry
 	{
 	protected:
+		/*
+		ϳ   װ Ǵ ƼŬ Ѵ
+		*/
+		struct ParticleForceRegistration
+		{
+			GPEDParticle* particle;
+			ParticleForceGenerator* fg;
+			ForceRegistrationHandle handle;
+		};
+
+		/*
+		Ϲ   Ѵ
+		*/
+		typedef std::vector<ParticleForceRegistration> Registry;
+		Registry registrations;
+
+		/*
+		׷ ó  ִ  
+		*/
+		enum GroupKind
+		{
+			GROUP_GRAVITY,
+			GROUP_DRAG
+		};
+
+		/*
+		  νϽ ϵ ƼŬ
+		*/
+		struct GeneratorGroup
+		{
+			ParticleForceGenerator* fg;
+			GroupKind kind;
+			std::vector<GPEDParticle*> particles;
+			std::vector<ForceRegistrationHandle> handles;
+
+			/* particles  ִ ƼŬ ( Ѵ) */
+			std::vector<GPEDParticle*> awakeParticles;
+		};
+		std::vector<GeneratorGroup> groups;
+
+		/*  -> ׷ index */
+		std::unordered_map<ParticleForceGenerator*, unsigned> groupOf;
+
+		/* Ϲ   Ű  ȣ */
+		static const unsigned GENERIC_LIST = ~0u;
+
+		/*
+		ڵ Ű  ġ ( ȣ    index)
+		*/
+		struct RegistrationSlot
+		{
+			unsigned list;
+			unsigned index;
+			GPEDParticle* particle;
+			ParticleForceGenerator* fg;
+		};
+		std::vector<RegistrationSlot> slots;
+		std::vector<ForceRegistrationHandle> freeHandles;
+
+		/* Ϲ    ƼŬ ִ  index ( Ѵ) */
+		std::vector<unsigned> awakeRegistrations;
+
+		/* ִ      ҿ ׶ getLayoutVersion()  */
+		ParticleStoreVersions storeVersions;
+
+		/*  ٲ ִ   ٽ  ϸ true̴ */
+		bool awakeDirty;
+
+		/*
+		(ƼŬ, )  ڵ ã  ǥ
+		*/
+		struct PairKey
+		{
+			GPEDParticle* particle;
+			ParticleForceGenerator* fg;
+			bool operator==(const PairKey& other) const
+			{
+				return particle == other.particle && fg == other.fg;
+			}
+		};
+		struct PairKeyHash
+		{
+			size_t operator()(const PairKey& key) const
+			{
+				size_t a = std::hash<GPEDParticle*>()(key.particle);
+				size_t b = std::hash<ParticleForceGenerator*>()(key.fg);
+				return a ^ (b + 0x9e3779b9 + (a << 6) + (a >> 2));
+			}
+		};
+		typedef std::unordered_multimap<PairKey, ForceRegistrationHandle, PairKeyHash> PairMap;
+		PairMap pairs;
+
+		/*
+		 ſ  ۾  ô  .
+		۾     Ƿ    
+		*/
+		static const unsigned PARALLEL_CHUNK_SIZE = 256;
+
+		/*
+		۾  ϳ:   ִ   [begin, end) 
+		*/
+		struct Chunk
+		{
+			unsigned list;
+			unsigned begin;
+			unsigned end;
+		};
+		std::vector<Chunk> chunks;
+
+		/*
+		 ſ ۾  ϳ    (Ӹ ȴ)
+		*/
+		std::vector<ParticleForceBuffer> chunkForces;
+
+	public:
+		ParticleForceRegistry();
+
 		/*
 		־  Ⱑ ־ ڿ ǵ Ѵ
+		 Ű ڵ ȯѴ
 		*/
-		void add(GPEDParticle* particle, ParticleForceGenerator* fg);
+		ForceRegistrationHandle add(GPEDParticle* particle, ParticleForceGenerator* fg);
+
+		/*
+		ڵ Ű  Ѵ
+		*/
+		void remove(ForceRegistrationHandle handle);
 
 		/*
 		   Ʈ Ѵ
+		    ϵǾ   Ѵ
 		 ϵǾ   ,  ޼ҵ ƹ͵  ʴ´
 		*/
 		void remove(GPEDParticle* particle, ParticleForceGenerator* fg);
@@ -199,10 +348,38 @@ namespace GPED
 		*/
 		void clear();
 
+		/*
+		  ȯѴ
+		*/
+		unsigned size() const;
+
 		/*
 		  ⸦ ȣ ش   ƮѴ
+		 ƼŬ  ǳʶڴ
 		*/
 		void updateForces(real duration);
+
+		/*
+		updateForces   ۾   ۾ Ǯ óѴ.
+		 ۾    ۿ 𿴴ٰ ۾   m_forceAccum Ƿ,
+		    updateForces Ʈ  .
+		۸ ϴ ܰ赵 ƼŬ index   ۾ Ǯ óȴ.
+		  ޹ ƼŬ  ؾ ϸ  ¸ ٲٸ  ȴ
+		*/
+		void updateForces(real duration, JobPool& pool);
+
+	protected:
+		/* ִ   ۾   ٽ . refreshAwake ڿ ȣѴ */
+		void buildChunks();
+
+		/* ̳ ƼŬ  ° ٲٸ ִ   ٽ  */
+		void refreshAwake();
+
+		/* ׷ .  ׷  ȣ Ű */
+		void removeGroup(unsigned group);
+
+		/*  ۾   óѴ */
+		void runChunk(const Chunk& chunk, real duration);
 	};
 
 }
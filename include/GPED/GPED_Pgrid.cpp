@@ -0,0 +1,204 @@
+#include <assert.h>
+#include <algorithm>
+#include "GPED_Pgrid.h"
+
+using namespace GPED;
+
+GPED::SpatialHashContacts::SpatialHashContacts()
+	: particles(NULL), radius(1), restitution(0.5f), listedCount(~0u), pairTests(0)
+{
+}
+
+void GPED::SpatialHashContacts::init(ParticleWorld::Particles* particles, real radius, real restitution)
+{
+	assert(radius > 0);
+
+	SpatialHashContacts::particles = particles;
+	SpatialHashContacts::radius = radius;
+	SpatialHashContacts::restitution = restitution;
+
+	//  ȣ⿡ ϰ  ڸ  ٽ 鵵 Ѵ
+	listedCount = ~0u;
+}
+
+unsigned GPED::SpatialHashContacts::hashCell(int x, int y, int z, unsigned mask)
+{
+	unsigned h = ((unsigned)x * 73856093u) ^ ((unsigned)y * 19349663u) ^ ((unsigned)z * 83492791u);
+	return h & mask;
+}
+
+void GPED::SpatialHashContacts::place(unsigned slot, real inverseCellSize) const
+{
+	glm::vec3 position = (*particles)[slot]->getPosition();
+	positionX[slot] = position.x;
+	positionY[slot] = position.y;
+	positionZ[slot] = position.z;
+
+	cellX[slot] = (int)real_floor(position.x * inverseCellSize);
+	cellY[slot] = (int)real_floor(position.y * inverseCellSize);
+	cellZ[slot] = (int)real_floor(position.z * inverseCellSize);
+}
+
+void GPED::SpatialHashContacts::sortGrid(Grid& grid, const std::vector<unsigned>& slots, bool force) const
+{
+	const unsigned count = (unsigned)slots.size();
+
+	// ƼŬ  ٲ Ŷ  ٽ Ѵ (ƼŬ    ̻ 2 ŵ)
+	bool changed = force || grid.bucketStart.empty() || count != grid.entries.size();
+	if (changed)
+	{
+		unsigned buckets = 1;
+		while (buckets < count * 2) buckets <<= 1;
+		grid.mask = buckets - 1;
+
+		grid.bucketOf.resize(count);
+		grid.entries.resize(count);
+		grid.bucketStart.resize(buckets + 1);
+	}
+
+	for (unsigned i = 0; i < count; ++i)
+	{
+		unsigned slot = slots[i];
+		unsigned bucket = hashCell(cellX[slot], cellY[slot], cellZ[slot], grid.mask);
+		if (bucket != grid.bucketOf[i])
+		{
+			grid.bucketOf[i] = bucket;
+			changed = true;
+		}
+	}
+
+	// Ŷ ٲ ƼŬ ٸ   ״ 
+	if (!changed) return;
+
+	//  ķ ƼŬ Ŷ  þ´
+	std::fill(grid.bucketStart.begin(), grid.bucketStart.end(), 0u);
+	for (unsigned i = 0; i < count; ++i) ++grid.bucketStart[grid.bucketOf[i] + 1];
+	for (unsigned b = 1; b < grid.bucketStart.size(); ++b) grid.bucketStart[b] += grid.bucketStart[b - 1];
+	for (unsigned i = 0; i < count; ++i)
+	{
+		// Ŷ  ӽ Ŀ   Ʒ ǵ
+		grid.entries[grid.bucketStart[grid.bucketOf[i]]++] = slots[i];
+	}
+	for (unsigned b = (unsigned)grid.bucketStart.size() - 1; b > 0; --b) grid.bucketStart[b] = grid.bucketStart[b - 1];
+	grid.bucketStart[0] = 0;
+}
+
+unsigned GPED::SpatialHashContacts::gatherBuckets(const Grid& grid, unsigned slot, unsigned* buckets) const
+{
+	// ؽ 浹  Ŷ      
+	unsigned numBuckets = 0;
+	for (int dz = -1; dz <= 1; ++dz)
+		for (int dy = -1; dy <= 1; ++dy)
+			for (int dx = -1; dx <= 1; ++dx)
+			{
+				unsigned bucket = hashCell(cellX[slot] + dx, cellY[slot] + dy, cellZ[slot] + dz, grid.mask);
+				bool seen = false;
+				for (unsigned k = 0; k < numBuckets; ++k)
+				{
+					if (buckets[k] == bucket) { seen = true; break; }
+				}
+				if (!seen) buckets[numBuckets++] = bucket;
+			}
+	return numBuckets;
+}
+
+void GPED::SpatialHashContacts::rebuild() const
+{
+	const unsigned count = (unsigned)particles->size();
+	const real inverseCellSize = real(1) / (radius * 2);
+
+	// ϵ  ġ ״ζ  ƼŬ  ʾǷ  ڸ ״ 
+	bool relisted = (count != listedCount || storeVersions.changed());
+	if (relisted)
+	{
+		listedCount = count;
+		positionX.resize(count); positionY.resize(count); positionZ.resize(count);
+		cellX.resize(count); cellY.resize(count); cellZ.resize(count);
+
+		awakeSlots.clear();
+		sleepingSlots.clear();
+		storeVersions.clear();
+		for (unsigned i = 0; i < count; ++i)
+		{
+			GPEDParticle* particle = (*particles)[i];
+			storeVersions.note(particle->getStore());
+			if (particle->isAwake())
+			{
+				awakeSlots.push_back(i);
+			}
+			else
+			{
+				sleepingSlots.push_back(i);
+				place(i, inverseCellSize);
+			}
+		}
+		sortGrid(sleepingGrid, sleepingSlots, true);
+	}
+
+	// ִ ƼŬ ġ ϰ Ŷ ٽ Ѵ
+	for (unsigned i = 0; i < awakeSlots.size(); ++i) place(awakeSlots[i], inverseCellSize);
+	sortGrid(awakeGrid, awakeSlots, relisted);
+}
+
+unsigned GPED::SpatialHashContacts::addContact(ParticleContact* contact, unsigned limit) const
+{
+	pairTests = 0;
+	if (!particles || particles->size() < 2 || limit == 0) return 0;
+
+	rebuild();
+
+	const real diameter = radius * 2;
+	const real diameterSquared = diameter * diameter;
+	const Grid* grids[2] = { &awakeGrid, &sleepingGrid };
+
+	unsigned used = 0;
+	for (unsigned a = 0; a < awakeSlots.size(); ++a)
+	{
+		//  ƼŬ ʿ ˻ ʴ´. ִ  ʿ ˻ȴ
+		const unsigned i = awakeSlots[a];
+
+		for (unsigned g = 0; g < 2; ++g)
+		{
+			const Grid& grid = *grids[g];
+			if (grid.entries.empty()) continue;
+			const bool bothAwake = (g == 0);
+
+			// ֺ 27  Ŷ 
+			unsigned buckets[27];
+			unsigned numBuckets = gatherBuckets(grid, i, buckets);
+
+			for (unsigned k = 0; k < numBuckets; ++k)
+			{
+				for (unsigned s = grid.bucketStart[buckets[k]]; s < grid.bucketStart[buckets[k] + 1]; ++s)
+				{
+					//     ˻Ѵ.   ִٸ ȣ  ƼŬ ʿ ˻Ѵ
+					unsigned j = grid.entries[s];
+					if (bothAwake && j <= i) continue;
+
+					++pairTests;
+					real x = positionX[i] - positionX[j];
+					real y = positionY[i] - positionY[j];
+					real z = positionZ[i] - positionZ[j];
+					real distanceSquared = x * x + y * y + z * z;
+					if (distanceSquared >= diameterSquared) continue;
+
+					//  j i Ѵ
+					real distance = real_sqrt(distanceSquared);
+					if (distance > 0)
+						contact->contactNormal = glm::vec3(x, y, z) * (real(1) / distance);
+					else
+						contact->contactNormal = glm::vec3(0, 1, 0);
+
+					contact->particle[0] = (*particles)[i];
+					contact->particle[1] = (*particles)[j];
+					contact->penetration = diameter - distance;
+					contact->restitution = restitution;
+					++contact;
+
+					if (++used >= limit) return used;
+				}
+			}
+		}
+	}
+	return used;
+}
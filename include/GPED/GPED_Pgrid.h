@@ -0,0 +1,119 @@
+#ifndef __GPED_PGRID_H__
+#define __GPED_PGRID_H__
+
+#include <vector>
+
+#include "GPED_pworld.h"
+
+namespace GPED
+{
+	/*
+	ƼŬ      浹Ű  ̴.
+
+	  ũ ڷ   ǥ ؽؼ Ŷ ƼŬ .
+	 ƼŬ ֺ 27  Ŷ ˻ϹǷ ü  ƼŬ   Ѵ.
+
+	ִ ƼŬ  ƼŬ  ٸ ڿ .
+	ִ ڴ   ٽ , Ŷ ٲ ƼŬ     ״ Ѵ.
+	 ڴ  ̳  ġ(getLayoutVersion) ٲ  ٽ .
+	 ƼŬ  ʴ´ٰ Ƿ,  ƼŬ ű   Ѵ.
+	ֺ ˻ ִ ƼŬ ϹǷ  ƼŬ  ˻ ʴ´
+	*/
+	class SpatialHashContacts : public ParticleContactGenerator
+	{
+	protected:
+		/*
+		ؽ  ϳ. Ŷ b ƼŬ entries[bucketStart[b] .. bucketStart[b+1]) ̴
+		*/
+		struct Grid
+		{
+			std::vector<unsigned> bucketStart;
+
+			/* Ͽ ƼŬ ȣ Ŷ  þ  */
+			std::vector<unsigned> entries;
+
+			/* ڿ   Ŷ ȣ */
+			std::vector<unsigned> bucketOf;
+
+			/* Ŷ  - 1 (Ŷ  2 ŵ̴) */
+			unsigned mask;
+
+			Grid() : mask(0) {}
+		};
+
+		/* 浹ų ƼŬ  */
+		ParticleWorld::Particles* particles;
+
+		/*  ƼŬ  */
+		real radius;
+
+		/* Ǵ contact ݹ  */
+		real restitution;
+
+		/*
+		Ʒ ٽ ä ۾ ̴. ũⰡ  ޸𸮸 ٽ  ʴ´
+		*/
+
+		/*  ȣ ƼŬ ġ 纻.  ƼŬ  ڸ   ȴ */
+		mutable std::vector<real> positionX, positionY, positionZ;
+
+		/*  ȣ ƼŬ  ǥ */
+		mutable std::vector<int> cellX, cellY, cellZ;
+
+		/* ִ ƼŬ  ƼŬ  ȣ (  Ѵ) */
+		mutable std::vector<unsigned> awakeSlots;
+		mutable std::vector<unsigned> sleepingSlots;
+
+		/* ִ ƼŬ  ƼŬ  */
+		mutable Grid awakeGrid;
+		mutable Grid sleepingGrid;
+
+		/* awakeSlots, sleepingSlots     ġ */
+		mutable ParticleStoreVersions storeVersions;
+
+		/* awakeSlots, sleepingSlots   ƼŬ .   ʾҴٸ ~0u ̴ */
+		mutable unsigned listedCount;
+
+		/*  ȣ⿡ Ÿ    */
+		mutable unsigned pairTests;
+
+	public:
+		SpatialHashContacts();
+
+		/*
+		浹ų ƼŬ ϰ , ݹ  Ѵ
+		*/
+		void init(ParticleWorld::Particles* particles, real radius, real restitution = 0.5f);
+
+		virtual unsigned addContact(ParticleContact* contact, unsigned limit) const;
+
+		/*
+		 addContact ȣ⿡ Ÿ    ȯѴ
+		*/
+		unsigned getPairTests() const { return pairTests; }
+
+	protected:
+		/*  ǥ Ŷ ȣ ٲ۴ */
+		static unsigned hashCell(int x, int y, int z, unsigned mask);
+
+		/*  ȣ ƼŬ ġ ϰ  ǥ Ѵ */
+		void place(unsigned slot, real inverseCellSize) const;
+
+		/*
+		slots ƼŬ grid Ŷ  .
+		force falsḛ ƼŬ   ƼŬ Ŷ ״ζ   ״ 
+		*/
+		void sortGrid(Grid& grid, const std::vector<unsigned>& slots, bool force) const;
+
+		/* grid  ǥ ֺ 27  Ŷ ߺ     ȯѴ */
+		unsigned gatherBuckets(const Grid& grid, unsigned slot, unsigned* buckets) const;
+
+		/*
+		̳  ° ٲٸ ִ/ ϰ  ڸ ٽ .
+		  ִ ƼŬ ġ ϰ ִ ڸ 
+		*/
+		void rebuild() const;
+	};
+}
+
+#endif
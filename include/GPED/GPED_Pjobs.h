@@ -0,0 +1,20 @@
+#ifndef __GPED_PJOBS_H__
+#define __GPED_PJOBS_H__
+
+#include "../cyclone/jobs.h"
+
+namespace GPED
+{
+	/*
+	 ܰ踦  ھ   ۾ Ǯ̴.
+	cyclone ۾ Ǯ ״ Ƿ,   Բ  α׷ Ǯ ϳ  world Ѱ
+	۾ 带   ִ.
+
+	parallelFor index   ŭ  ְ,
+	ڱ   ó ڴ ٸ    index ´ (work stealing).
+	ȣ 嵵  0 ۾ Ѵ
+	*/
+	typedef cyclone::JobPool JobPool;
+}
+
+#endif
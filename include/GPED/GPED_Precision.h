@@ -2,6 +2,8 @@
 #define __GPED_PRECISON_H__
 
 #include <limits>
+#include <float.h>
+#include <math.h>
 
 namespace GPED
 {
@@ -36,6 +38,8 @@ namespace GPED
 #define real_pow powf
 	/* floating point modulo  е Ѵ */
 #define real_fmod fmodf
+	/* floor  е Ѵ */
+#define real_floor floorf
 
 	/* 1+e == 1  e  Ѵ */
 #define real_epsilon FLT_EPSILON
@@ -53,6 +57,7 @@ namespace GPED
 #define real_exp exp
 #define real_pow pow
 #define real_fmod fmod
+#define real_floor floor
 #define real_epsilon DBL_EPSILON
 #define R_PI 3.14159265358979
 #endif
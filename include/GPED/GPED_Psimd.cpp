@@ -0,0 +1,174 @@
+#include "GPED_Psimd.h"
+
+#ifdef GPED_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+using namespace GPED;
+
+/*
+MSVC ÷  AVX  Լ    GCC Clang Լ   ؾ Ѵ
+*/
+#if defined(GPED_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define GPED_TARGET_AVX __attribute__((target("avx")))
+#else
+#define GPED_TARGET_AVX
+#endif
+
+static void integrateScalar(const ParticleBatch& b, unsigned begin, real duration)
+{
+	for (unsigned i = begin; i < b.count; ++i)
+	{
+		b.px[i] += b.vx[i] * duration;
+		b.py[i] += b.vy[i] * duration;
+		b.pz[i] += b.vz[i] * duration;
+
+		b.vx[i] = (b.vx[i] + (b.ax[i] + b.fx[i] * b.inverseMass[i]) * duration) * b.drag[i];
+		b.vy[i] = (b.vy[i] + (b.ay[i] + b.fy[i] * b.inverseMass[i]) * duration) * b.drag[i];
+		b.vz[i] = (b.vz[i] + (b.az[i] + b.fz[i] * b.inverseMass[i]) * duration) * b.drag[i];
+
+		b.fx[i] = 0;
+		b.fy[i] = 0;
+		b.fz[i] = 0;
+	}
+}
+
+#ifdef GPED_SIMD_X86
+
+/*   ġ ӵ 4 Ѵ */
+static inline void stepSSE(real* p, real* v, const real* a, real* f,
+	__m128 inverseMass, __m128 drag, __m128 dt, unsigned i)
+{
+	__m128 vel = _mm_loadu_ps(v + i);
+	_mm_storeu_ps(p + i, _mm_add_ps(_mm_loadu_ps(p + i), _mm_mul_ps(vel, dt)));
+
+	__m128 acc = _mm_add_ps(_mm_loadu_ps(a + i), _mm_mul_ps(_mm_loadu_ps(f + i), inverseMass));
+	vel = _mm_mul_ps(_mm_add_ps(vel, _mm_mul_ps(acc, dt)), drag);
+	_mm_storeu_ps(v + i, vel);
+	_mm_storeu_ps(f + i, _mm_setzero_ps());
+}
+
+static unsigned integrateSSE(const ParticleBatch& b, real duration)
+{
+	const __m128 dt = _mm_set1_ps(duration);
+
+	unsigned i = 0;
+	for (; i + 4 <= b.count; i += 4)
+	{
+		__m128 inverseMass = _mm_loadu_ps(b.inverseMass + i);
+		__m128 drag = _mm_loadu_ps(b.drag + i);
+
+		stepSSE(b.px, b.vx, b.ax, b.fx, inverseMass, drag, dt, i);
+		stepSSE(b.py, b.vy, b.ay, b.fy, inverseMass, drag, dt, i);
+		stepSSE(b.pz, b.vz, b.az, b.fz, inverseMass, drag, dt, i);
+	}
+	return i;
+}
+
+/*   ġ ӵ 8 Ѵ */
+GPED_TARGET_AVX
+static inline void stepAVX(real* p, real* v, const real* a, real* f,
+	__m256 inverseMass, __m256 drag, __m256 dt, unsigned i)
+{
+	__m256 vel = _mm256_loadu_ps(v + i);
+	_mm256_storeu_ps(p + i, _mm256_add_ps(_mm256_loadu_ps(p + i), _mm256_mul_ps(vel, dt)));
+
+	__m256 acc = _mm256_add_ps(_mm256_loadu_ps(a + i), _mm256_mul_ps(_mm256_loadu_ps(f + i), inverseMass));
+	vel = _mm256_mul_ps(_mm256_add_ps(vel, _mm256_mul_ps(acc, dt)), drag);
+	_mm256_storeu_ps(v + i, vel);
+	_mm256_storeu_ps(f + i, _mm256_setzero_ps());
+}
+
+GPED_TARGET_AVX
+static unsigned integrateAVX(const ParticleBatch& b, real duration)
+{
+	const __m256 dt = _mm256_set1_ps(duration);
+
+	unsigned i = 0;
+	for (; i + 8 <= b.count; i += 8)
+	{
+		__m256 inverseMass = _mm256_loadu_ps(b.inverseMass + i);
+		__m256 drag = _mm256_loadu_ps(b.drag + i);
+
+		stepAVX(b.px, b.vx, b.ax, b.fx, inverseMass, drag, dt, i);
+		stepAVX(b.py, b.vy, b.ay, b.fy, inverseMass, drag, dt, i);
+		stepAVX(b.pz, b.vz, b.az, b.fz, inverseMass, drag, dt, i);
+	}
+	_mm256_zeroupper();
+	return i;
+}
+
+#endif
+
+/* CPU ˻ؼ ϴ    ȯѴ */
+static SimdLevel probeSimdLevel()
+{
+	SimdLevel detected = SIMD_NONE;
+
+#if defined(GPED_SIMD_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	bool sse = (info[3] & (1 << 25)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+
+	// ü YMM ͸  ִ Ȯؾ Ѵ
+	if (avx && osxsave) avx = (_xgetbv(0) & 6) == 6;
+	else avx = false;
+
+	if (avx) detected = SIMD_AVX;
+	else if (sse) detected = SIMD_SSE;
+#elif defined(GPED_SIMD_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx")) detected = SIMD_AVX;
+	else if (__builtin_cpu_supports("sse")) detected = SIMD_SSE;
+#endif
+	return detected;
+}
+
+/*
+ϰ п  . Լ    ó ȣ    ʱȭǰ
+ٸ  ʱȭ   ٸǷ  忡 ó ȣص ϴ
+*/
+static SimdLevel& selectedLevel()
+{
+	static SimdLevel level = GPED::detectSimdLevel();
+	return level;
+}
+
+SimdLevel GPED::detectSimdLevel()
+{
+	static const SimdLevel detected = probeSimdLevel();
+	return detected;
+}
+
+SimdLevel GPED::getSimdLevel()
+{
+	return selectedLevel();
+}
+
+void GPED::setSimdLevel(SimdLevel level)
+{
+	SimdLevel supported = detectSimdLevel();
+	selectedLevel() = level > supported ? supported : level;
+}
+
+void GPED::integrateBatch(const ParticleBatch& batch, real duration)
+{
+	unsigned done = 0;
+
+#ifdef GPED_SIMD_X86
+	switch (getSimdLevel())
+	{
+	case SIMD_AVX: done = integrateAVX(batch, duration); break;
+	case SIMD_SSE: done = integrateSSE(batch, duration); break;
+	default: break;
+	}
+#endif
+
+	//  ƼŬ Į óѴ
+	integrateScalar(batch, done, duration);
+}
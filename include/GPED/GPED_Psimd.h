@@ -0,0 +1,67 @@
+#ifndef __GPED_PSIMD_H__
+#define __GPED_PSIMD_H__
+
+#include "GPED_Precision.h"
+
+/*
+x86 迭 SSE/AVX θ Ѵ
+*/
+#if defined(SINGLE_PRECISION) && (defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__))
+#define GPED_SIMD_X86
+#endif
+
+namespace GPED
+{
+	/*
+	ƼŬ ϰ п   ִ ɾ 
+	*/
+	enum SimdLevel
+	{
+		SIMD_NONE = 0,
+		SIMD_SSE,
+		SIMD_AVX
+	};
+
+	/*
+	ϰ бⰡ   д Ʈ  ̴.
+	drag  ƼŬ real_pow(damping, duration)  ̸   迭̴
+	*/
+	struct ParticleBatch
+	{
+		real* px; real* py; real* pz;
+		real* vx; real* vy; real* vz;
+		const real* ax; const real* ay; const real* az;
+		real* fx; real* fy; real* fz;
+		const real* inverseMass;
+		const real* drag;
+		unsigned count;
+	};
+
+	/*
+	  CPU ϴ    ȯѴ (ó ȣ    ˻Ѵ)
+	*/
+	SimdLevel detectSimdLevel();
+
+	/*
+	ϰ п   ȯѴ
+	*/
+	SimdLevel getSimdLevel();
+
+	/*
+	ϰ п   Ѵ. CPU ϴ غ    .
+	ġũ Į ο 񱳿 ȴ.    ٸ 尡   ȣϸ  ȴ
+	*/
+	void setSimdLevel(SimdLevel level);
+
+	/*
+	־ ƼŬ  duration ŭ ϰ  ⸦ .
+
+	SIMD δ Į (ParticleStore::integrate(index, duration))
+	    ϹǷ  Ʈ  .
+	Ϸ Į θ FMA ġ 쿡 и
+	  1e-6 (float   8 ULP) ̳ ġѴ
+	*/
+	void integrateBatch(const ParticleBatch& batch, real duration);
+}
+
+#endif
@@ -0,0 +1,378 @@
+#include <assert.h>
+#include <algorithm>
+#include "GPED_Pstore.h"
+#include "GPED_Psimd.h"
+
+using namespace GPED;
+
+static real sleepEpsilon = ((real)0.3);
+
+void GPED::setSleepEpsilon(real value)
+{
+	sleepEpsilon = value;
+}
+
+real GPED::getSleepEpsilon()
+{
+	return sleepEpsilon;
+}
+
+static void pushVector(ParticleVectorStream& stream, real x, real y, real z)
+{
+	stream.x.push_back(x);
+	stream.y.push_back(y);
+	stream.z.push_back(z);
+}
+
+static void copyVector(ParticleVectorStream& stream, unsigned from, unsigned to)
+{
+	stream.x[to] = stream.x[from];
+	stream.y[to] = stream.y[from];
+	stream.z[to] = stream.z[from];
+}
+
+static void popVector(ParticleVectorStream& stream)
+{
+	stream.x.pop_back();
+	stream.y.pop_back();
+	stream.z.pop_back();
+}
+
+static void reserveVector(ParticleVectorStream& stream, unsigned count)
+{
+	stream.x.reserve(count);
+	stream.y.reserve(count);
+	stream.z.reserve(count);
+}
+
+static void clearVector(ParticleVectorStream& stream)
+{
+	stream.x.clear();
+	stream.y.clear();
+	stream.z.clear();
+}
+
+static void swapVector(ParticleVectorStream& stream, unsigned a, unsigned b)
+{
+	std::swap(stream.x[a], stream.x[b]);
+	std::swap(stream.y[a], stream.y[b]);
+	std::swap(stream.z[a], stream.z[b]);
+}
+
+GPED::ParticleStore::ParticleStore()
+	: awakeCount(0), layoutVersion(0)
+{
+}
+
+ParticleHandle GPED::ParticleStore::create()
+{
+	// ִ ڵ ִٸ Ѵ
+	ParticleHandle handle;
+	if (!freeHandles.empty())
+	{
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+	}
+	else
+	{
+		handle = (ParticleHandle)handleToIndex.size();
+		handleToIndex.push_back(INVALID_PARTICLE_HANDLE);
+	}
+
+	//  ƼŬ ׻ 迭  δ
+	handleToIndex[handle] = size();
+	indexToHandle.push_back(handle);
+
+	pushVector(position, 0, 0, 0);
+	pushVector(previousPosition, 0, 0, 0);
+	pushVector(velocity, 0, 0, 0);
+	pushVector(acceleration, 0, 0, 0);
+	pushVector(forceAccum, 0, 0, 0);
+	damping.push_back(1);
+	inverseMass.push_back(1);
+	motion.push_back(sleepEpsilon * 2);
+	sleepIsland.push_back(NO_SLEEP_ISLAND);
+
+	//  ƼŬ ִٸ ù °  ƼŬ ڸ ٲ ִ  ִ´
+	unsigned index = size() - 1;
+	if (index != awakeCount) swapParticles(index, awakeCount);
+	++awakeCount;
+	++layoutVersion;
+
+	return handle;
+}
+
+void GPED::ParticleStore::destroy(ParticleHandle handle)
+{
+	assert(isValid(handle));
+
+	// ִ ƼŬ̶  ִ   ű  δ
+	unsigned index = handleToIndex[handle];
+	if (index < awakeCount)
+	{
+		--awakeCount;
+		if (index != awakeCount) swapParticles(index, awakeCount);
+		index = awakeCount;
+	}
+
+	//  ƼŬ  ڸ ű
+	unsigned last = size() - 1;
+	if (index != last)
+	{
+		moveParticle(last, index);
+
+		ParticleHandle moved = indexToHandle[last];
+		indexToHandle[index] = moved;
+		handleToIndex[moved] = index;
+	}
+	popBack();
+
+	handleToIndex[handle] = INVALID_PARTICLE_HANDLE;
+	freeHandles.push_back(handle);
+	++layoutVersion;
+}
+
+bool GPED::ParticleStore::isValid(ParticleHandle handle) const
+{
+	return handle < handleToIndex.size() && handleToIndex[handle] != INVALID_PARTICLE_HANDLE;
+}
+
+void GPED::ParticleStore::clear()
+{
+	clearVector(position);
+	clearVector(previousPosition);
+	clearVector(velocity);
+	clearVector(acceleration);
+	clearVector(forceAccum);
+	damping.clear();
+	inverseMass.clear();
+	motion.clear();
+	sleepIsland.clear();
+	awakeCount = 0;
+	++layoutVersion;
+
+	handleToIndex.clear();
+	indexToHandle.clear();
+	freeHandles.clear();
+}
+
+void GPED::ParticleStore::reserve(unsigned count)
+{
+	reserveVector(position, count);
+	reserveVector(previousPosition, count);
+	reserveVector(velocity, count);
+	reserveVector(acceleration, count);
+	reserveVector(forceAccum, count);
+	damping.reserve(count);
+	inverseMass.reserve(count);
+	motion.reserve(count);
+	sleepIsland.reserve(count);
+	indexToHandle.reserve(count);
+}
+
+void GPED::ParticleStore::integrate(unsigned index, real duration)
+{
+	//  false Ÿ   
+	assert(duration > 0.0);
+
+	// Update linear position
+	position.x[index] += velocity.x[index] * duration;
+	position.y[index] += velocity.y[index] * duration;
+	position.z[index] += velocity.z[index] * duration;
+
+	// Work out the acceleration from the force
+	real accX = acceleration.x[index] + forceAccum.x[index] * inverseMass[index];
+	real accY = acceleration.y[index] + forceAccum.y[index] * inverseMass[index];
+	real accZ = acceleration.z[index] + forceAccum.z[index] * inverseMass[index];
+
+	// Update linear velocity from the acceleration, and impose drag
+	real drag = real_pow(damping[index], duration);
+	velocity.x[index] = (velocity.x[index] + accX * duration) * drag;
+	velocity.y[index] = (velocity.y[index] + accY * duration) * drag;
+	velocity.z[index] = (velocity.z[index] + accZ * duration) * drag;
+
+	forceAccum.x[index] = 0;
+	forceAccum.y[index] = 0;
+	forceAccum.z[index] = 0;
+}
+
+void GPED::ParticleStore::integrate(real duration)
+{
+	assert(duration > 0.0);
+
+	//  ƼŬ ִ  ڿ Ƿ  ʴ´
+	const unsigned count = awakeCount;
+	if (count == 0) return;
+
+	calculateDrag(duration);
+
+	ParticleBatch batch;
+	batch.px = &position.x[0];
+	batch.py = &position.y[0];
+	batch.pz = &position.z[0];
+	batch.vx = &velocity.x[0];
+	batch.vy = &velocity.y[0];
+	batch.vz = &velocity.z[0];
+	batch.ax = &acceleration.x[0];
+	batch.ay = &acceleration.y[0];
+	batch.az = &acceleration.z[0];
+	batch.fx = &forceAccum.x[0];
+	batch.fy = &forceAccum.y[0];
+	batch.fz = &forceAccum.z[0];
+	batch.inverseMass = &inverseMass[0];
+	batch.drag = &dragScratch[0];
+	batch.count = count;
+
+	integrateBatch(batch, duration);
+}
+
+void GPED::ParticleStore::clearAccumulators()
+{
+	//  ƼŬ   Ƿ ִ  
+	if (awakeCount == 0) return;
+	std::fill(forceAccum.x.begin(), forceAccum.x.begin() + awakeCount, real(0));
+	std::fill(forceAccum.y.begin(), forceAccum.y.begin() + awakeCount, real(0));
+	std::fill(forceAccum.z.begin(), forceAccum.z.begin() + awakeCount, real(0));
+}
+
+void GPED::ParticleStore::setAwake(unsigned index, bool awake)
+{
+	if (awake == isAwake(index)) return;
+	++layoutVersion;
+
+	if (awake)
+	{
+		// ù °  ƼŬ ڸ ű  ø
+		if (index != awakeCount) swapParticles(index, awakeCount);
+		index = awakeCount++;
+
+		motion[index] = sleepEpsilon * 2;
+		sleepIsland[index] = NO_SLEEP_ISLAND;
+
+		//     clearAccumulators  ʾǷ ⼭ 
+		forceAccum.x[index] = 0;
+		forceAccum.y[index] = 0;
+		forceAccum.z[index] = 0;
+	}
+	else
+	{
+		//  ִ ƼŬ ڸ ű  δ
+		--awakeCount;
+		if (index != awakeCount) swapParticles(index, awakeCount);
+		index = awakeCount;
+
+		velocity.x[index] = 0;
+		velocity.y[index] = 0;
+		velocity.z[index] = 0;
+		forceAccum.x[index] = 0;
+		forceAccum.y[index] = 0;
+		forceAccum.z[index] = 0;
+	}
+}
+
+void GPED::ParticleStore::updateMotion(real bias)
+{
+	const real limit = sleepEpsilon * 10;
+	for (unsigned i = 0; i < awakeCount; ++i)
+	{
+		real currentMotion = velocity.x[i] * velocity.x[i] + velocity.y[i] * velocity.y[i] + velocity.z[i] * velocity.z[i];
+		real value = bias * motion[i] + (1 - bias) * currentMotion;
+
+		//  ʹ Ŀ      ɸǷ Ѵ
+		motion[i] = (value > limit) ? limit : value;
+	}
+}
+
+void GPED::ParticleStore::savePositions()
+{
+	previousPosition.x = position.x;
+	previousPosition.y = position.y;
+	previousPosition.z = position.z;
+}
+
+ParticleStore& GPED::ParticleStore::standalone()
+{
+	//  ü  ƼŬ  Һ ʰ Ҹ  Ƿ Ҵ ҸŰ ʴ´
+	static ParticleStore* store = new ParticleStore();
+	return *store;
+}
+
+void GPED::ParticleStore::moveParticle(unsigned from, unsigned to)
+{
+	copyVector(position, from, to);
+	copyVector(previousPosition, from, to);
+	copyVector(velocity, from, to);
+	copyVector(acceleration, from, to);
+	copyVector(forceAccum, from, to);
+	damping[to] = damping[from];
+	inverseMass[to] = inverseMass[from];
+	motion[to] = motion[from];
+	sleepIsland[to] = sleepIsland[from];
+}
+
+void GPED::ParticleStore::popBack()
+{
+	popVector(position);
+	popVector(previousPosition);
+	popVector(velocity);
+	popVector(acceleration);
+	popVector(forceAccum);
+	damping.pop_back();
+	inverseMass.pop_back();
+	motion.pop_back();
+	sleepIsland.pop_back();
+	indexToHandle.pop_back();
+}
+
+void GPED::ParticleStore::swapParticles(unsigned a, unsigned b)
+{
+	swapVector(position, a, b);
+	swapVector(previousPosition, a, b);
+	swapVector(velocity, a, b);
+	swapVector(acceleration, a, b);
+	swapVector(forceAccum, a, b);
+	std::swap(damping[a], damping[b]);
+	std::swap(inverseMass[a], inverseMass[b]);
+	std::swap(motion[a], motion[b]);
+	std::swap(sleepIsland[a], sleepIsland[b]);
+
+	ParticleHandle handleA = indexToHandle[a];
+	ParticleHandle handleB = indexToHandle[b];
+	indexToHandle[a] = handleB;
+	indexToHandle[b] = handleA;
+	handleToIndex[handleA] = b;
+	handleToIndex[handleB] = a;
+}
+
+void GPED::ParticleStore::calculateDrag(real duration)
+{
+	//  ƼŬ  Ƿ   ʿ 
+	const unsigned count = awakeCount;
+	dragScratch.resize(count);
+	dragCache.clear();
+
+	// κ ƼŬ     Ƿ    Ѵ
+	real lastDamping = damping[0];
+	real lastDrag = real_pow(lastDamping, duration);
+	dragCache[lastDamping] = lastDrag;
+
+	for (unsigned i = 0; i < count; ++i)
+	{
+		if (damping[i] != lastDamping)
+		{
+			lastDamping = damping[i];
+
+			std::unordered_map<real, real>::iterator cached = dragCache.find(lastDamping);
+			if (cached != dragCache.end())
+			{
+				lastDrag = cached->second;
+			}
+			else
+			{
+				lastDrag = real_pow(lastDamping, duration);
+				dragCache[lastDamping] = lastDrag;
+			}
+		}
+		dragScratch[i] = lastDrag;
+	}
+}
@@ -0,0 +1,289 @@
+#ifndef __GPED_PSTORE_H__
+#define __GPED_PSTORE_H__
+
+#include <vector>
+#include <utility>
+#include <unordered_map>
+
+#include "GPED_Precision.h"
+
+namespace GPED
+{
+	/*
+	ƼŬ Ұ ߱ϴ ڵ̴.
+	   ġ(index) Ű Ͼ ٲ ڵ ٲ ʴ´
+	*/
+	typedef unsigned ParticleHandle;
+
+	/* ȿ  ڵ Ÿ */
+	const ParticleHandle INVALID_PARTICLE_HANDLE = ~0u;
+
+	/*
+	ƼŬ   ִ   ̴.  ̺ ۰ Ǹ 
+	*/
+	void setSleepEpsilon(real value);
+	real getSleepEpsilon();
+
+	/*     Ÿ */
+	const unsigned NO_SLEEP_ISLAND = ~0u;
+
+	/*
+	x, y, z   ӵ 迭 ϴ  Ʈ̴
+	*/
+	struct ParticleVectorStream
+	{
+		std::vector<real> x;
+		std::vector<real> y;
+		std::vector<real> z;
+	};
+
+	/*
+	ƼŬ ¸ structure-of-arrays · Ѵ.
+	 Ӽ к ӵ ޸𸮿  ־
+	  ͸  ʰ ޸𸮸    ִ.
+
+	ƼŬ ڵ Ѵ. Ŵ  Ҹ  ڸ ű
+	swap-and-pop óǹǷ 迭   ʴ´.
+
+	ִ ƼŬ ׻ 迭  [0, getAwakeCount())  δ.
+	ƼŬ ų   ƼŬ ڸ ٲٹǷ index ٲ.
+	 ִ  óѴ
+	*/
+	class ParticleStore
+	{
+	public:
+		/* ġ Ѵ */
+		ParticleVectorStream position;
+
+		/* savePositions()  ȣǾ  ġ Ѵ ( ) */
+		ParticleVectorStream previousPosition;
+
+		/* ӵ Ѵ */
+		ParticleVectorStream velocity;
+
+		/* ӵ Ѵ */
+		ParticleVectorStream acceleration;
+
+		/*   ܰ迡    Ѵ */
+		ParticleVectorStream forceAccum;
+
+		/*   Ǵ   Ѵ */
+		std::vector<real> damping;
+
+		/*   Ѵ */
+		std::vector<real> inverseMass;
+
+		/* ֱ ӵ   .  Ǵ  Ѵ */
+		std::vector<real> motion;
+
+		/*  ƼŬ   ȣ.  NO_SLEEP_ISLAND ̴ */
+		std::vector<unsigned> sleepIsland;
+
+	protected:
+		/* ڵ -> index ȯǥ. ִ ڵ INVALID_PARTICLE_HANDLE  */
+		std::vector<unsigned> handleToIndex;
+
+		/* index -> ڵ ȯǥ */
+		std::vector<ParticleHandle> indexToHandle;
+
+		/* ٽ   ִ ڵ  */
+		std::vector<ParticleHandle> freeHandles;
+
+		/* ִ ƼŬ  */
+		unsigned awakeCount;
+
+		/* ƼŬ ߰, ŵǰų    Ѵ */
+		unsigned layoutVersion;
+
+		/* ϰ    ƼŬ    ( и ٽ ä) */
+		std::vector<real> dragScratch;
+
+		/*   -> real_pow(damping, duration) ĳ.  ٸ     Ѵ */
+		std::unordered_map<real, real> dragCache;
+
+	public:
+		ParticleStore();
+
+		/*
+		ο ƼŬ ⺻ ߰ϰ  ڵ ȯѴ.  ƼŬ ִ
+		*/
+		ParticleHandle create();
+
+		/*
+		־ ڵ ƼŬ Ѵ.
+		 ƼŬ  ڸ ŰǷ  ƼŬ index ٲ
+		*/
+		void destroy(ParticleHandle handle);
+
+		/*
+		־ ڵ ִ ƼŬ Ű ȮѴ
+		*/
+		bool isValid(ParticleHandle handle) const;
+
+		/*
+		ڵ鿡 شϴ  index ȯѴ
+		*/
+		unsigned indexOf(ParticleHandle handle) const
+		{
+			return handleToIndex[handle];
+		}
+
+		/*
+		index شϴ ڵ ȯѴ
+		*/
+		ParticleHandle handleOf(unsigned index) const
+		{
+			return indexToHandle[index];
+		}
+
+		/*
+		 ƼŬ  ȯѴ
+		*/
+		unsigned size() const
+		{
+			return (unsigned)indexToHandle.size();
+		}
+
+		/*
+		ִ ƼŬ  ȯѴ
+		*/
+		unsigned getAwakeCount() const
+		{
+			return awakeCount;
+		}
+
+		/*
+		ƼŬ ߰, ŵǰų    ٲ  ȯѴ.
+		ִ ƼŬ    δ       ٽ  ʿ䰡 
+		*/
+		unsigned getLayoutVersion() const
+		{
+			return layoutVersion;
+		}
+
+		/*
+		index ƼŬ ִ ȮѴ
+		*/
+		bool isAwake(unsigned index) const
+		{
+			return index < awakeCount;
+		}
+
+		/*
+		ƼŬ ų . ų   ӵ  ⸦ .
+		 ƼŬ   clearAccumulators  Ƿ,     .
+		  ٷ ٽ  ʵ       Ѵ.
+		ƼŬ ִ   ŰǷ index ٲ  ִ
+		*/
+		void setAwake(unsigned index, bool awake);
+
+		/*
+		ִ ƼŬ    ӵ Ѵ.
+		bias   󸶳  Ÿ
+		*/
+		void updateMotion(real bias);
+
+		/*
+		 ƼŬ ڵ 
+		*/
+		void clear();
+
+		/*
+		־  ŭ ƼŬ  ޸𸮸 ̸ ȮѴ
+		*/
+		void reserve(unsigned count);
+
+		/*
+		ϳ ƼŬ ־ ðŭ Ѵ
+		*/
+		void integrate(unsigned index, real duration);
+
+		/*
+		ִ  ƼŬ ־ ðŭ Ѵ
+		CPU ϸ SSE/AVX  ƼŬ   óѴ (GPED_Psimd.h )
+		*/
+		void integrate(real duration);
+
+		/*
+		ִ ƼŬ  ⸦ .  ƼŬ    ̹ 
+		*/
+		void clearAccumulators();
+
+		/*
+		 ġ previousPosition Ѵ
+		*/
+		void savePositions();
+
+		/*
+		ƼŬ Ǵ   ʾ  Ǵ  ̴.
+		忡  ʰ ȥڼ еǴ ƼŬ ⿡ δ.
+		α׷   Ҹ Ƿ  ü ƼŬ ϰ   ִ
+		*/
+		static ParticleStore& standalone();
+
+	protected:
+		/* index ƼŬ ٸ index Ѵ */
+		void moveParticle(unsigned from, unsigned to);
+
+		/*  Ʈ  Ҹ Ѵ */
+		void popBack();
+
+		/*  index ƼŬ ڵ ¹ٲ۴ */
+		void swapParticles(unsigned a, unsigned b);
+
+		/* dragScratch ִ ƼŬ   duration ä */
+		void calculateDrag(real duration);
+	};
+
+	/*
+	  getLayoutVersion()   ΰ,  ڿ ٲ ȮѴ.
+	ִ ƼŬ    δ   ٽ   ˱  Ѵ
+	*/
+	class ParticleStoreVersions
+	{
+		std::vector<std::pair<const ParticleStore*, unsigned> > versions;
+
+		/*   . ƼŬ κ  ҿ Ƿ  Ѵ */
+		const ParticleStore* last;
+
+	public:
+		ParticleStoreVersions() : last(NULL) {}
+
+		/*
+		 Ҹ  
+		*/
+		void clear()
+		{
+			versions.clear();
+			last = NULL;
+		}
+
+		/*
+		   Ѵ. ̹  Ҵ Ѵ
+		*/
+		void note(const ParticleStore* store)
+		{
+			if (store == last) return;
+			last = store;
+			for (unsigned i = 0; i < versions.size(); ++i)
+			{
+				if (versions[i].first == store) return;
+			}
+			versions.push_back(std::make_pair(store, store->getLayoutVersion()));
+		}
+
+		/*
+		   ϳ ƼŬ ߰, ŵǰų  ٸ true ȯѴ
+		*/
+		bool changed() const
+		{
+			for (unsigned i = 0; i < versions.size(); ++i)
+			{
+				if (versions[i].first->getLayoutVersion() != versions[i].second) return true;
+			}
+			return false;
+		}
+	};
+}
+
+#endif
@@ -1,10 +1,390 @@
 #include "GPED_pworld.h"
+#include <assert.h>
+#include <algorithm>
 #include <iostream>
-using namespacse GPED;
+using namespace GPED;
 
-ParticleWorld::ParticleWorld(unsigned maxContacts, unsigned iterations)
-	:resolver(iterations), maxContacts(maxContacts)
+ParticleWorld::ParticleWorld(unsigned maxContacts, unsigned iterations, ParticleContactResolver::Algorithm algorithm)
+	:resolver(iterations, algorithm), contacts(maxContacts), jobPool(NULL),
+	fixedStep(real(1) / real(60)), maxSubsteps(8), accumulator(0), interpolationAlpha(0),
+	canSleep(false), sleepingIslandCount(0)
 {
-	contacts = new ParticleContact[maxContacts];
 	calculateIterations = (iterations == 0);
-}
\ No newline at end of file
+}
+
+ParticleWorld::~ParticleWorld()
+{
+	// 谡  ƼŬ Ѵ
+	for (Particles::iterator p = particles.begin(); p != particles.end(); ++p)
+	{
+		if ((*p)->getStore() == &store) delete *p;
+	}
+}
+
+void ParticleWorld::startFrame()
+{
+	store.clearAccumulators();
+
+	// Ͽ ٸ  ƼŬ    ִ.
+	//  ϸ ſ ߰ ģ ڿ ƲǷ ƼŬ Ҹ ȮѴ
+	for (Particles::iterator p = particles.begin(); p != particles.end(); ++p)
+	{
+		if ((*p)->getStore() != &store) (*p)->clearAccumulator();
+	}
+}
+
+unsigned ParticleWorld::generateContacts()
+{
+	contacts.reset();
+
+	for (ContactGenerators::iterator g = contactGenerators.begin(); g != contactGenerators.end(); ++g)
+	{
+		for (;;)
+		{
+			if (contacts.available() == 0) contacts.grow();
+
+			unsigned limit = contacts.available();
+			unsigned used = (*g)->addContact(contacts.end(), limit);
+			if (used < limit)
+			{
+				contacts.commit(used);
+				break;
+			}
+
+			//    ä.  contact   Ƿ ÷ ٽ ȣѴ
+			contacts.grow();
+		}
+	}
+
+	//  contact  ȯѴ
+	return contacts.size();
+}
+
+void ParticleWorld::integrate(real duration)
+{
+	store.integrate(duration);
+
+	for (Particles::iterator p = particles.begin(); p != particles.end(); ++p)
+	{
+		if ((*p)->getStore() != &store) (*p)->integrate(duration);
+	}
+}
+
+void ParticleWorld::runPhysics(real duration)
+{
+	//   ⸦ Ѵ
+	if (jobPool) registry.updateForces(duration, *jobPool);
+	else registry.updateForces(duration);
+
+	//   ƼŬ Ѵ
+	integrate(duration);
+
+	// contact Ѵ
+	unsigned usedContacts = generateContacts();
+
+	//  ƼŬ ǵٸ 
+	if (canSleep) usedContacts = wakeTouchedIslands(usedContacts);
+
+	// ׸ װ͵ óѴ
+	if (usedContacts)
+	{
+		if (calculateIterations) resolver.setIterations(usedContacts * 2);
+		resolver.resolveContacts(contacts.data(), usedContacts, duration);
+	}
+
+	//   
+	if (canSleep) updateSleep(duration, usedContacts);
+}
+
+void ParticleWorld::setFixedTimestep(real step, unsigned maxSubsteps)
+{
+	assert(step > 0 && maxSubsteps > 0);
+
+	fixedStep = step;
+	ParticleWorld::maxSubsteps = maxSubsteps;
+}
+
+unsigned ParticleWorld::runFixedSteps(real frameDuration)
+{
+	if (frameDuration > 0) accumulator += frameDuration;
+
+	// ̹ ӿ  ܰ  Ѵ. ѵ Ѵ ð 
+	unsigned steps = (unsigned)(accumulator / fixedStep);
+	if (steps > maxSubsteps)
+	{
+		steps = maxSubsteps;
+		accumulator = fixedStep * steps;
+	}
+
+	for (unsigned i = 0; i < steps; ++i)
+	{
+		//   ܰ  ġ ʿϴ
+		if (i == steps - 1) store.savePositions();
+
+		startFrame();
+		runPhysics(fixedStep);
+		accumulator -= fixedStep;
+	}
+
+	if (accumulator < 0) accumulator = 0;
+	interpolationAlpha = accumulator / fixedStep;
+	if (interpolationAlpha > 1) interpolationAlpha = 1;
+
+	return steps;
+}
+
+real ParticleWorld::getInterpolationAlpha() const
+{
+	return interpolationAlpha;
+}
+
+glm::vec3 ParticleWorld::getInterpolatedPosition(const GPEDParticle* particle) const
+{
+	glm::vec3 current = particle->getPosition();
+	if (particle->getStore() != &store) return current;
+
+	unsigned index = particle->getIndex();
+	glm::vec3 previous(store.previousPosition.x[index], store.previousPosition.y[index], store.previousPosition.z[index]);
+	return previous + (current - previous) * interpolationAlpha;
+}
+
+GPEDParticle* ParticleWorld::createParticle()
+{
+	GPEDParticle* particle = new GPEDParticle(&store);
+	particles.push_back(particle);
+	return particle;
+}
+
+void ParticleWorld::removeParticle(GPEDParticle* particle)
+{
+	Particles::iterator p = std::find(particles.begin(), particles.end(), particle);
+	if (p == particles.end()) return;
+
+	particles.erase(p);
+	if (particle->getStore() == &store) delete particle;
+}
+
+void ParticleWorld::setJobPool(JobPool* pool)
+{
+	jobPool = pool;
+	resolver.setJobPool(pool);
+}
+
+ParticleStore& ParticleWorld::getParticleStore()
+{
+	return store;
+}
+
+ParticleWorld::Particles& ParticleWorld::getParticles()
+{
+	return particles;
+}
+
+ParticleWorld::ContactGenerators& ParticleWorld::getContactGenerators()
+{
+	return contactGenerators;
+}
+
+ParticleForceRegistry& ParticleWorld::getForceRegistry()
+{
+	return registry;
+}
+
+const ParticleContactArena& ParticleWorld::getContactArena() const
+{
+	return contacts;
+}
+
+void ParticleWorld::setCanSleep(const bool canSleep)
+{
+	ParticleWorld::canSleep = canSleep;
+	if (canSleep) return;
+
+	//  ƼŬ  
+	for (unsigned island = 0; island < sleepingIslands.size(); ++island)
+	{
+		if (!sleepingIslands[island].empty()) wakeIsland(island);
+	}
+}
+
+void ParticleWorld::wakeParticle(GPEDParticle* particle)
+{
+	if (particle->isAwake()) return;
+
+	unsigned island = NO_SLEEP_ISLAND;
+	if (particle->getStore() == &store) island = store.sleepIsland[particle->getIndex()];
+
+	if (island != NO_SLEEP_ISLAND) wakeIsland(island);
+	else particle->setAwake(true);
+}
+
+unsigned ParticleWorld::getSleepingIslandCount() const
+{
+	return sleepingIslandCount;
+}
+
+void ParticleWorld::wakeIsland(unsigned island)
+{
+	std::vector<ParticleHandle>& members = sleepingIslands[island];
+	for (unsigned i = 0; i < members.size(); ++i)
+	{
+		//  ڿ ŵǾų ڵ ٸ ƼŬ ٽ ٸ ǳʶڴ
+		if (!store.isValid(members[i])) continue;
+		unsigned index = store.indexOf(members[i]);
+		if (store.isAwake(index) || store.sleepIsland[index] != island) continue;
+
+		store.setAwake(index, true);
+	}
+
+	members.clear();
+	freeIslands.push_back(island);
+	--sleepingIslandCount;
+}
+
+unsigned ParticleWorld::wakeTouchedIslands(unsigned numContacts)
+{
+	ParticleContact* contactArray = contacts.data();
+
+	// ̶ ִ contact  ƼŬ 
+	for (unsigned i = 0; i < numContacts; ++i)
+	{
+		GPEDParticle* first = contactArray[i].particle[0];
+		GPEDParticle* second = contactArray[i].particle[1];
+		if (!second) continue;
+
+		bool firstAwake = first->isAwake();
+		bool secondAwake = second->isAwake();
+		if (firstAwake && !secondAwake) wakeParticle(second);
+		else if (!firstAwake && secondAwake) wakeParticle(first);
+	}
+
+	//  ƼŬ  contact ذ ʴ´
+	unsigned kept = 0;
+	for (unsigned i = 0; i < numContacts; ++i)
+	{
+		GPEDParticle* second = contactArray[i].particle[1];
+		bool awake = contactArray[i].particle[0]->isAwake() || (second && second->isAwake());
+		if (!awake) continue;
+
+		if (kept != i) contactArray[kept] = contactArray[i];
+		++kept;
+	}
+	return kept;
+}
+
+unsigned ParticleWorld::findIslandRoot(unsigned index)
+{
+	while (islandParent[index] != index)
+	{
+		// θ  δ
+		islandParent[index] = islandParent[islandParent[index]];
+		index = islandParent[index];
+	}
+	return index;
+}
+
+void ParticleWorld::updateSleep(real duration, unsigned numContacts)
+{
+	//   Ѵ
+	store.updateMotion(real_pow(real(0.5), duration));
+
+	const unsigned awakeCount = store.getAwakeCount();
+	islandParent.resize(awakeCount);
+	for (unsigned i = 0; i < awakeCount; ++i) islandParent[i] = i;
+	islandRestless.assign(awakeCount, 0);
+
+	// contact ̾ ƼŬ ϳ  ´
+	ParticleContact* contactArray = contacts.data();
+	for (unsigned i = 0; i < numContacts; ++i)
+	{
+		GPEDParticle* first = contactArray[i].particle[0];
+		GPEDParticle* second = contactArray[i].particle[1];
+		bool firstOwned = (first->getStore() == &store);
+		bool secondOwned = second && (second->getStore() == &store);
+
+		// ٸ  ƼŬ  Ƿ װͰ     
+		if (firstOwned && second && !secondOwned) islandRestless[first->getIndex()] = 1;
+		if (secondOwned && !firstOwned) islandRestless[second->getIndex()] = 1;
+		if (!firstOwned || !secondOwned) continue;
+
+		unsigned a = findIslandRoot(first->getIndex());
+		unsigned b = findIslandRoot(second->getIndex());
+		if (a != b) islandParent[a] = b;
+	}
+
+	// ϳ ̴ ƼŬ ִ  ִ´
+	const real epsilon = getSleepEpsilon();
+	for (unsigned i = 0; i < awakeCount; ++i)
+	{
+		if (islandRestless[i] || store.motion[i] >= epsilon) islandRestless[findIslandRoot(i)] = 1;
+	}
+
+	//   ȣ ְ ƼŬ ڵ 
+	islandOfRoot.assign(awakeCount, NO_SLEEP_ISLAND);
+	std::vector<unsigned> newIslands;
+	for (unsigned i = 0; i < awakeCount; ++i)
+	{
+		unsigned root = findIslandRoot(i);
+		if (islandRestless[root]) continue;
+
+		if (islandOfRoot[root] == NO_SLEEP_ISLAND)
+		{
+			unsigned island;
+			if (!freeIslands.empty())
+			{
+				island = freeIslands.back();
+				freeIslands.pop_back();
+			}
+			else
+			{
+				island = (unsigned)sleepingIslands.size();
+				sleepingIslands.push_back(std::vector<ParticleHandle>());
+			}
+			islandOfRoot[root] = island;
+			newIslands.push_back(island);
+			++sleepingIslandCount;
+		}
+		sleepingIslands[islandOfRoot[root]].push_back(store.handleOf(i));
+	}
+
+	// .  index ٲǷ ڵ ٽ ã´
+	for (unsigned k = 0; k < newIslands.size(); ++k)
+	{
+		const std::vector<ParticleHandle>& members = sleepingIslands[newIslands[k]];
+		for (unsigned i = 0; i < members.size(); ++i)
+		{
+			store.setAwake(store.indexOf(members[i]), false);
+			store.sleepIsland[store.indexOf(members[i])] = newIslands[k];
+		}
+	}
+}
+
+void GroundContacts::init(ParticleWorld::Particles* particles)
+{
+	GroundContacts::particles = particles;
+}
+
+unsigned GroundContacts::addContact(ParticleContact* contact, unsigned limit) const
+{
+	unsigned count = 0;
+	for (ParticleWorld::Particles::iterator p = particles->begin(); p != particles->end(); ++p)
+	{
+		//  ƼŬ ǳʶڴ
+		if (!(*p)->isAwake()) continue;
+
+		real y = (*p)->getPosition().y;
+		if (y < 0.0f)
+		{
+			contact->contactNormal = glm::vec3(0, 1, 0);
+			contact->particle[0] = *p;
+			contact->particle[1] = NULL;
+			contact->penetration = -y;
+			contact->restitution = 0.2f;
+			contact++;
+			count++;
+		}
+
+		if (count >= limit) return count;
+	}
+	return count;
+}
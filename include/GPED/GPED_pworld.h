@@ -3,7 +3,8 @@
 
 #include <vector>
 
-#include "GPED_Pcontact.h"
+#include "GPED_Pcontacts.h"
+#include "GPED_Pstore.h"
 #include "GPED_Pfgen.h"
 
 namespace GPED
@@ -18,6 +19,11 @@ namespace GPED
 		typedef std::vector<ParticleContactGenerator*> ContactGenerators;
 	
 	protected:
+		/*
+		 谡 ϴ ƼŬ ¸ ӵ 迭 Ѵ
+		*/
+		ParticleStore store;
+
 		/*
 		ƼŬ Ѵ
 		*/
@@ -27,7 +33,7 @@ namespace GPED
 		谡  ӿ  ڿ ִ ݺ Ƚ
 		ؾϴ 쿡 true̴
 		*/
-		bool calculaterations;
+		bool calculateIterations;
 
 		/*
 		ƼŬ  ߻⸦ Ѵ
@@ -37,7 +43,7 @@ namespace GPED
 		/*
 		contact  resolver Ѵ
 		*/
-		ParticleForceRegistry resolver;
+		ParticleContactResolver resolver;
 
 		/*
 		contact ߻
@@ -45,30 +51,82 @@ namespace GPED
 		ContactGenerators contactGenerators;
 
 		/*
-		contact  Ѵ
+		contact  Ѵ. ϸ ڶǷ contact   
+		*/
+		ParticleContactArena contacts;
+
+		/*
+		 Ű contact ذ(RESOLVE_COLORED)  ó ۾ Ǯ. NULL̸  忡 óѴ
+		*/
+		JobPool* jobPool;
+
+		/*
+		runFixedSteps ϴ  ð ݰ   ȣ⿡  ִ ܰ 
+		*/
+		real fixedStep;
+		unsigned maxSubsteps;
+
+		/*
+		 ùķ̼  ð Ƶд
+		*/
+		real accumulator;
+
+		/*
+		 runFixedSteps ȣ   ¿      (0 ~ 1)
+		*/
+		real interpolationAlpha;
+
+		/*
+		ƼŬ    true̴
 		*/
-		ParticleContact* contacts;
+		bool canSleep;
 
 		/*
-		Ǵ ִ contact  Ÿ (, contact 迭 ũ)
+		    ƼŬ ڵ Ѵ. ȣ ParticleStore::sleepIsland ϵȴ
 		*/
-		unsigned maxContacts;
+		std::vector<std::vector<ParticleHandle> > sleepingIslands;
+
+		/* ٽ   ִ  ȣ */
+		std::vector<unsigned> freeIslands;
+
+		/*    */
+		unsigned sleepingIslandCount;
+
+		/*
+		 ã   ۾  (ִ ƼŬ index )
+		*/
+		std::vector<unsigned> islandParent;
+		std::vector<unsigned> islandOfRoot;
+		std::vector<unsigned char> islandRestless;
 	
 	public:
 		/*
-		  ־   ó  ִ ο ƼŬ ùķ͸ Ѵ
+		ο ƼŬ ùķ͸ Ѵ. maxContacts contact  ó ũ̸
+		׺  contact  ۰ ڶ
 		,   contact Ȯ ݺ Ƚ   ִ
 		ݺ Ƚ   contact    ȴ
+		contact  鿡 resolver ˰ RESOLVE_PRIORITY   ִ
 		*/
-		ParticleWorld(unsigned maxContacts, unsigned iterations = 0);
+		ParticleWorld(unsigned maxContacts, unsigned iterations = 0,
+			ParticleContactResolver::Algorithm algorithm = ParticleContactResolver::RESOLVE_SCAN);
 		~ParticleWorld();
 
 		/*
 		ϵ  contact ڿ  ش contact Ѵ
 		 contact  ȯѴ
+
+		contact ۴ ȣ  ó ٽ ä.
+		Ⱑ    ä ߸ contact   Ƿ
+		۸ ø  ⸦ ٽ ȣѴ
 		*/
 		unsigned generateContacts();
 
+		/*
+		   ƼŬ ־ ðŭ Ѵ
+		ҿ ִ ƼŬ ϳ  óǰ,
+		ٸ ҿ ߰ ƼŬ ϳ óȴ
+		*/
+		void integrate(real duration);
 
 		/*
 		   ƼŬ ־ ðŭ  Ѵ
@@ -82,6 +140,55 @@ namespace GPED
 		*/
 		void startFrame();
 
+		/*
+		runFixedSteps   ð ݰ  ӿ  ִ ܰ  Ѵ
+		*/
+		void setFixedTimestep(real step, unsigned maxSubsteps = 8);
+
+		/*
+		 ð ⿡ ϰ,  ðŭ  ð  startFrame runPhysics ݺѴ
+		 ܰ  ȯѴ
+
+		 ӿ maxSubsteps   ܰ谡 ʿϸ  ð 
+		׷  ũ ʾ    maxSubsteps ܰ踦  ʴ´
+		 ܰ踶 startFrame ȣǹǷ ƼŬ ִ  force Ʈ ؾ Ѵ
+		*/
+		unsigned runFixedSteps(real frameDuration);
+
+		/*
+		 ܰ  ġ  ġ    ȯѴ
+		*/
+		real getInterpolationAlpha() const;
+
+		/*
+		   ġ ȯѴ
+		ٸ ҿ ߰ ƼŬ  ġ Ƿ  ġ ȯѴ
+		*/
+		glm::vec3 getInterpolatedPosition(const GPEDParticle* particle) const;
+
+
+		/*
+		  ҿ ο ƼŬ  Ͽ ߰Ѵ
+		̷  ƼŬ 谡 ϸ  Բ ȴ
+		*/
+		GPEDParticle* createParticle();
+
+		/*
+		ƼŬ Ͽ Ѵ
+		谡  ƼŬ̶  Ѵ
+		*/
+		void removeParticle(GPEDParticle* particle);
+
+		/*
+		 ܰ踦  ó ۾ Ǯ Ѵ. NULL̸  ó 
+		Ǯ 谡  ʴ´
+		*/
+		void setJobPool(JobPool* pool);
+
+		/*
+		ƼŬ  Ҹ Ѵ
+		*/
+		ParticleStore& getParticleStore();
 
 		/*
 		ƼŬ  Ѵ
@@ -97,6 +204,51 @@ namespace GPED
 		force Ʈ ش
 		*/
 		ParticleForceRegistry& getForceRegistry();
+
+	protected:
+		/* ־ ȣ   */
+		void wakeIsland(unsigned island);
+
+		/*
+		ִ ƼŬ   ƼŬ  ,
+		 ƼŬ  contact Ͽ .  contact  ȯѴ
+		*/
+		unsigned wakeTouchedIslands(unsigned numContacts);
+
+		/*   ϰ,    */
+		void updateSleep(real duration, unsigned numContacts);
+
+		/*  ã   Ʈ ã */
+		unsigned findIslandRoot(unsigned index);
+
+	public:
+		/*
+		contact ۸ ش. Ӹ   ִ 뷮 Ȯ  ִ
+		*/
+		const ParticleContactArena& getContactArena() const;
+
+		/*
+		ƼŬ  Ѵ. ⺻ false̴
+
+		  runPhysics contact ̾ ƼŬ () ã,
+		  ƼŬ  getSleepEpsilon()    ü .
+		 ƼŬ ,  , contact  ,
+		ִ ƼŬ contact   ü Բ .
+		  contact   ƼŬ   contact  ʾƾ Ѵ
+		( ذ ʰ ).
+		  ƼŬ  
+		*/
+		void setCanSleep(const bool canSleep = true);
+
+		/*
+		ƼŬ  ƼŬ   
+		*/
+		void wakeParticle(GPEDParticle* particle);
+
+		/*
+		   ȯѴ
+		*/
+		unsigned getSleepingIslandCount() const;
 	};
 
 	/*
@@ -19,7 +19,10 @@
 #ifndef CYCLONE_BODY_H
 #define CYCLONE_BODY_H
 
+#include <assert.h>
+
 #include "core.h"
+#include "bodystore.h"
 
 namespace cyclone {
 
@@ -33,11 +36,9 @@ namespace cyclone {
      * to it. The rigid body manages its state and allows access
      * through a set of methods.
      *
-     * A ridid body contains 64 words (the size of which is given
-     * by the precision: sizeof(real)). It contains no virtual
-     * functions, so should take up exactly 64 words in memory. Of
-     * this total 15 words are padding, distributed among the
-     * Vector3 data members.
+     * The state of a rigid body lives in a RigidBodyStore, and the
+     * rigid body is a small handle to it. Copying a rigid body
+     * creates a new body in the same store with the same state.
      */
     class RigidBody
     {
@@ -48,204 +49,102 @@ namespace cyclone {
 
     protected:
         /**
-         * @name Characteristic Data and State
-         *
-         * This data holds the state of the rigid body. There are two
-         * sets of data: characteristics and state.
-         *
-         * Characteristics are properties of the rigid body
-         * independent of its current kinematic situation. This
-         * includes mass, moment of inertia and damping
-         * properties. Two identical rigid bodys will have the same
-         * values for their characteristics.
-         *
-         * State includes all the characteristics and also includes
-         * the kinematic situation of the rigid body in the current
-         * simulation. By setting the whole state data, a rigid body's
-         * exact game state can be replicated. Note that state does
-         * not include any forces applied to the body. Two identical
-         * rigid bodies in the same simulation will not share the same
-         * state values.
-         *
-         * The state values make up the smallest set of independent
-         * data for the rigid body. Other state data is calculated
-         * from their current values. When state data is changed the
-         * dependent values need to be updated: this can be achieved
-         * either by integrating the simulation, or by calling the
-         * calculateInternals function. This two stage process is used
-         * because recalculating internals can be a costly process:
-         * all state changes should be carried out at the same time,
-         * allowing for a single call.
-         *
-         * @see calculateInternals
-         */
-        /*@{*/
-        /**
-         * Holds the inverse of the mass of the rigid body. It
-         * is more useful to hold the inverse mass because
-         * integration is simpler, and because in real time
-         * simulation it is more useful to have bodies with
-         * infinite mass (immovable) than zero mass
-         * (completely unstable in numerical simulation).
-         */
-        real inverseMass;
-
-        /**
-         * Holds the inverse of the body's inertia tensor. The
-         * inertia tensor provided must not be degenerate
-         * (that would mean the body had zero inertia for
-         * spinning along one axis). As long as the tensor is
-         * finite, it will be invertible. The inverse tensor
-         * is used for similar reasons to the use of inverse
-         * mass.
+         * @name Store Handle
          *
-         * The inertia tensor, unlike the other variables that
-         * define a rigid body, is given in body space.
+         * The state of the rigid body is held in a RigidBodyStore,
+         * split into groups by how often each value is used. The
+         * rigid body itself only holds the store and a handle into
+         * it, so code can keep working through body pointers while
+         * the world integrates the store in a single pass.
          *
-         * @see inverseMass
+         * @see RigidBodyStore
          */
-        Matrix3 inverseInertiaTensor;
+        /*@{*/
 
         /**
-         * Holds the amount of damping applied to linear
-         * motion.  Damping is required to remove energy added
-         * through numerical instability in the integrator.
+         * Holds the store that holds the state of this body.
          */
-        real linearDamping;
+        RigidBodyStore *store;
 
         /**
-         * Holds the amount of damping applied to angular
-         * motion.  Damping is required to remove energy added
-         * through numerical instability in the integrator.
+         * Holds the handle of this body in the store.
          */
-        real angularDamping;
+        BodyHandle handle;
 
         /**
-         * Holds the linear position of the rigid body in
-         * world space.
+         * Holds the position of this body in the broadphase list of
+         * the world it is registered with, or NO_BROADPHASE_ENTRY.
+         * Set by World::addBroadphaseBody.
          */
-        Vector3 position;
+        unsigned broadphaseEntry;
 
-        /**
-         * Holds the angular orientation of the rigid body in
-         * world space.
-         */
-        Quaternion orientation;
+        /** Marks a body that isn't registered with a broadphase. */
+        static const unsigned NO_BROADPHASE_ENTRY = 0xffffffff;
 
-        /**
-         * Holds the linear velocity of the rigid body in
-         * world space.
-         */
-        Vector3 velocity;
-
-        /**
-         * Holds the angular velocity, or rotation, or the
-         * rigid body in world space.
-         */
-        Vector3 rotation;
+        friend class World;
 
         /*@}*/
 
 
+    public:
         /**
-         * @name Derived Data
+         * @name Constructor and Destructor
          *
-         * These data members hold information that is derived from
-         * the other data in the class.
+         * A rigid body adds its state to a store when it is created
+         * and removes it when it is destroyed. Bodies that are
+         * created without a store use RigidBodyStore::standalone.
          */
         /*@{*/
 
         /**
-         * Holds the inverse inertia tensor of the body in world
-         * space. The inverse inertia tensor member is specified in
-         * the body's local space.
-         *
-         * @see inverseInertiaTensor
-         */
-        Matrix3 inverseInertiaTensorWorld;
-
-        /**
-         * Holds the amount of motion of the body. This is a recency
-         * weighted mean that can be used to put a body to sleap.
-         */
-        real motion;
-
-        /**
-         * A body can be put to sleep to avoid it being updated
-         * by the integration functions or affected by collisions
-         * with the world.
+         * Creates a new body in the standalone store.
          */
-        bool isAwake;
+        RigidBody();
 
         /**
-         * Some bodies may never be allowed to fall asleep.
-         * User controlled bodies, for example, should be
-         * always awake.
+         * Creates a new body in the given store.
          */
-        bool canSleep;
+        explicit RigidBody(RigidBodyStore *store);
 
         /**
-         * Holds a transform matrix for converting body space into
-         * world space and vice versa. This can be achieved by calling
-         * the getPointIn*Space functions.
-         *
-         * @see getPointInLocalSpace
-         * @see getPointInWorldSpace
-         * @see getTransform
+         * Creates a new body in the same store as the given body,
+         * with the same state.
          */
-        Matrix4 transformMatrix;
-
-        /*@}*/
-
+        RigidBody(const RigidBody &other);
 
         /**
-         * @name Force and Torque Accumulators
-         *
-         * These data members store the current force, torque and
-         * acceleration of the rigid body. Forces can be added to the
-         * rigid body in any order, and the class decomposes them into
-         * their constituents, accumulating them for the next
-         * simulation step. At the simulation step, the accelerations
-         * are calculated and stored to be applied to the rigid body.
+         * Copies the state of the given body into this one.
          */
-        /*@{*/
+        RigidBody& operator=(const RigidBody &other);
 
         /**
-         * Holds the accumulated force to be applied at the next
-         * integration step.
+         * Removes the body from its store.
          */
-        Vector3 forceAccum;
+        ~RigidBody();
 
         /**
-         * Holds the accumulated torque to be applied at the next
-         * integration step.
-         */
-        Vector3 torqueAccum;
-
-       /**
-         * Holds the acceleration of the rigid body.  This value
-         * can be used to set acceleration due to gravity (its primary
-         * use), or any other constant acceleration.
+         * Returns the store that holds the state of this body.
          */
-        Vector3 acceleration;
+        RigidBodyStore* getStore() const
+        {
+            return store;
+        }
 
         /**
-         * Holds the linear acceleration of the rigid body, for the
-         * previous frame.
+         * Returns the handle of this body in its store.
          */
-        Vector3 lastFrameAcceleration;
-
-        /*@}*/
+        BodyHandle getHandle() const
+        {
+            return handle;
+        }
 
-    public:
         /**
-         * @name Constructor and Destructor
-         *
-         * There are no data members in the rigid body class that are
-         * created on the heap. So all data storage is handled
-         * automatically.
+         * Returns the current index of this body in its store.
          */
-        /*@{*/
+        unsigned getIndex() const
+        {
+            return store->indexOf(handle);
+        }
 
         /*@}*/
 
@@ -800,7 +699,7 @@ namespace cyclone {
          */
         bool getAwake() const
         {
-            return isAwake;
+            return store->isAwake(getIndex());
         }
 
         /**
@@ -819,7 +718,7 @@ namespace cyclone {
          */
         bool getCanSleep() const
         {
-            return canSleep;
+            return store->properties[getIndex()].canSleep;
         }
 
         /**
@@ -973,6 +872,410 @@ namespace cyclone {
 
     };
 
+    /*
+     * The rigid body functions below forward to the body's entry in
+     * its store.
+     */
+
+    inline RigidBody::RigidBody()
+        : store(&RigidBodyStore::standalone()), broadphaseEntry(NO_BROADPHASE_ENTRY)
+    {
+        handle = store->create();
+    }
+
+    inline RigidBody::RigidBody(RigidBodyStore *store)
+        : store(store), broadphaseEntry(NO_BROADPHASE_ENTRY)
+    {
+        handle = store->create();
+    }
+
+    inline RigidBody::RigidBody(const RigidBody &other)
+        : store(other.store), broadphaseEntry(NO_BROADPHASE_ENTRY)
+    {
+        handle = store->create();
+        *this = other;
+    }
+
+    inline RigidBody& RigidBody::operator=(const RigidBody &other)
+    {
+        if (this == &other) return *this;
+
+        // Match the awake state first, since that can move the body.
+        store->setAwake(getIndex(), other.getAwake());
+
+        unsigned index = getIndex();
+        unsigned otherIndex = other.getIndex();
+        store->motion[index] = other.store->motion[otherIndex];
+        store->mass[index] = other.store->mass[otherIndex];
+        store->forces[index] = other.store->forces[otherIndex];
+        store->transforms[index] = other.store->transforms[otherIndex];
+        store->properties[index] = other.store->properties[otherIndex];
+        return *this;
+    }
+
+    inline RigidBody::~RigidBody()
+    {
+        store->destroy(handle);
+    }
+
+    inline void RigidBody::calculateDerivedData()
+    {
+        store->calculateDerivedData(getIndex());
+    }
+
+    inline void RigidBody::integrate(real duration)
+    {
+        unsigned index = getIndex();
+        store->integrate(index, duration);
+        store->updateMotion(index, duration);
+    }
+
+    inline void RigidBody::setMass(const real mass)
+    {
+        assert(mass != 0);
+        store->mass[getIndex()].inverseMass = ((real)1.0)/mass;
+    }
+
+    inline real RigidBody::getMass() const
+    {
+        real inverseMass = store->mass[getIndex()].inverseMass;
+        if (inverseMass == 0) return REAL_MAX;
+        return ((real)1.0)/inverseMass;
+    }
+
+    inline void RigidBody::setInverseMass(const real inverseMass)
+    {
+        store->mass[getIndex()].inverseMass = inverseMass;
+    }
+
+    inline real RigidBody::getInverseMass() const
+    {
+        return store->mass[getIndex()].inverseMass;
+    }
+
+    inline bool RigidBody::hasFiniteMass() const
+    {
+        return store->mass[getIndex()].inverseMass >= 0.0f;
+    }
+
+    inline void RigidBody::setInertiaTensor(const Matrix3 &inertiaTensor)
+    {
+        store->properties[getIndex()].inverseInertiaTensor.setInverse(inertiaTensor);
+    }
+
+    inline void RigidBody::getInertiaTensor(Matrix3 *inertiaTensor) const
+    {
+        inertiaTensor->setInverse(store->properties[getIndex()].inverseInertiaTensor);
+    }
+
+    inline Matrix3 RigidBody::getInertiaTensor() const
+    {
+        Matrix3 it;
+        getInertiaTensor(&it);
+        return it;
+    }
+
+    inline void RigidBody::getInertiaTensorWorld(Matrix3 *inertiaTensor) const
+    {
+        inertiaTensor->setInverse(store->mass[getIndex()].inverseInertiaTensorWorld);
+    }
+
+    inline Matrix3 RigidBody::getInertiaTensorWorld() const
+    {
+        Matrix3 it;
+        getInertiaTensorWorld(&it);
+        return it;
+    }
+
+    inline void RigidBody::setInverseInertiaTensor(const Matrix3 &inverseInertiaTensor)
+    {
+        store->properties[getIndex()].inverseInertiaTensor = inverseInertiaTensor;
+    }
+
+    inline void RigidBody::getInverseInertiaTensor(Matrix3 *inverseInertiaTensor) const
+    {
+        *inverseInertiaTensor = store->properties[getIndex()].inverseInertiaTensor;
+    }
+
+    inline Matrix3 RigidBody::getInverseInertiaTensor() const
+    {
+        return store->properties[getIndex()].inverseInertiaTensor;
+    }
+
+    inline void RigidBody::getInverseInertiaTensorWorld(Matrix3 *inverseInertiaTensor) const
+    {
+        *inverseInertiaTensor = store->mass[getIndex()].inverseInertiaTensorWorld;
+    }
+
+    inline Matrix3 RigidBody::getInverseInertiaTensorWorld() const
+    {
+        return store->mass[getIndex()].inverseInertiaTensorWorld;
+    }
+
+    inline void RigidBody::setDamping(const real linearDamping,
+                                      const real angularDamping)
+    {
+        BodyProperties &properties = store->properties[getIndex()];
+        properties.linearDamping = linearDamping;
+        properties.angularDamping = angularDamping;
+    }
+
+    inline void RigidBody::setLinearDamping(const real linearDamping)
+    {
+        store->properties[getIndex()].linearDamping = linearDamping;
+    }
+
+    inline real RigidBody::getLinearDamping() const
+    {
+        return store->properties[getIndex()].linearDamping;
+    }
+
+    inline void RigidBody::setAngularDamping(const real angularDamping)
+    {
+        store->properties[getIndex()].angularDamping = angularDamping;
+    }
+
+    inline real RigidBody::getAngularDamping() const
+    {
+        return store->properties[getIndex()].angularDamping;
+    }
+
+    inline void RigidBody::setPosition(const Vector3 &position)
+    {
+        store->motion[getIndex()].position = position;
+    }
+
+    inline void RigidBody::setPosition(const real x, const real y, const real z)
+    {
+        setPosition(Vector3(x, y, z));
+    }
+
+    inline void RigidBody::getPosition(Vector3 *position) const
+    {
+        *position = store->motion[getIndex()].position;
+    }
+
+    inline Vector3 RigidBody::getPosition() const
+    {
+        return store->motion[getIndex()].position;
+    }
+
+    inline void RigidBody::setOrientation(const Quaternion &orientation)
+    {
+        Quaternion &stored = store->motion[getIndex()].orientation;
+        stored = orientation;
+        stored.normalise();
+    }
+
+    inline void RigidBody::setOrientation(const real r, const real i,
+                                          const real j, const real k)
+    {
+        setOrientation(Quaternion(r, i, j, k));
+    }
+
+    inline void RigidBody::getOrientation(Quaternion *orientation) const
+    {
+        *orientation = store->motion[getIndex()].orientation;
+    }
+
+    inline Quaternion RigidBody::getOrientation() const
+    {
+        return store->motion[getIndex()].orientation;
+    }
+
+    inline void RigidBody::getOrientation(Matrix3 *matrix) const
+    {
+        getOrientation(matrix->data);
+    }
+
+    inline void RigidBody::getOrientation(real matrix[9]) const
+    {
+        const Matrix4 &transform = store->transforms[getIndex()];
+        matrix[0] = transform.data[0];
+        matrix[1] = transform.data[1];
+        matrix[2] = transform.data[2];
+
+        matrix[3] = transform.data[4];
+        matrix[4] = transform.data[5];
+        matrix[5] = transform.data[6];
+
+        matrix[6] = transform.data[8];
+        matrix[7] = transform.data[9];
+        matrix[8] = transform.data[10];
+    }
+
+    inline void RigidBody::getTransform(Matrix4 *transform) const
+    {
+        *transform = store->transforms[getIndex()];
+    }
+
+    inline void RigidBody::getTransform(real matrix[16]) const
+    {
+        const Matrix4 &transform = store->transforms[getIndex()];
+        for (unsigned i = 0; i < 12; i++) matrix[i] = transform.data[i];
+        matrix[12] = matrix[13] = matrix[14] = 0;
+        matrix[15] = 1;
+    }
+
+    inline void RigidBody::getGLTransform(float matrix[16]) const
+    {
+        store->transforms[getIndex()].fillGLArray(matrix);
+    }
+
+    inline Matrix4 RigidBody::getTransform() const
+    {
+        return store->transforms[getIndex()];
+    }
+
+    inline Vector3 RigidBody::getPointInLocalSpace(const Vector3 &point) const
+    {
+        return store->transforms[getIndex()].transformInverse(point);
+    }
+
+    inline Vector3 RigidBody::getPointInWorldSpace(const Vector3 &point) const
+    {
+        return store->transforms[getIndex()].transform(point);
+    }
+
+    inline Vector3 RigidBody::getDirectionInLocalSpace(const Vector3 &direction) const
+    {
+        return store->transforms[getIndex()].transformInverseDirection(direction);
+    }
+
+    inline Vector3 RigidBody::getDirectionInWorldSpace(const Vector3 &direction) const
+    {
+        return store->transforms[getIndex()].transformDirection(direction);
+    }
+
+    inline void RigidBody::setVelocity(const Vector3 &velocity)
+    {
+        store->motion[getIndex()].velocity = velocity;
+    }
+
+    inline void RigidBody::setVelocity(const real x, const real y, const real z)
+    {
+        setVelocity(Vector3(x, y, z));
+    }
+
+    inline void RigidBody::getVelocity(Vector3 *velocity) const
+    {
+        *velocity = store->motion[getIndex()].velocity;
+    }
+
+    inline Vector3 RigidBody::getVelocity() const
+    {
+        return store->motion[getIndex()].velocity;
+    }
+
+    inline void RigidBody::addVelocity(const Vector3 &deltaVelocity)
+    {
+        store->motion[getIndex()].velocity += deltaVelocity;
+    }
+
+    inline void RigidBody::setRotation(const Vector3 &rotation)
+    {
+        store->motion[getIndex()].rotation = rotation;
+    }
+
+    inline void RigidBody::setRotation(const real x, const real y, const real z)
+    {
+        setRotation(Vector3(x, y, z));
+    }
+
+    inline void RigidBody::getRotation(Vector3 *rotation) const
+    {
+        *rotation = store->motion[getIndex()].rotation;
+    }
+
+    inline Vector3 RigidBody::getRotation() const
+    {
+        return store->motion[getIndex()].rotation;
+    }
+
+    inline void RigidBody::addRotation(const Vector3 &deltaRotation)
+    {
+        store->motion[getIndex()].rotation += deltaRotation;
+    }
+
+    inline void RigidBody::setAwake(const bool awake)
+    {
+        store->setAwake(getIndex(), awake);
+    }
+
+    inline void RigidBody::setCanSleep(const bool canSleep)
+    {
+        store->properties[getIndex()].canSleep = canSleep;
+        if (!canSleep && !getAwake()) setAwake();
+    }
+
+    inline void RigidBody::getLastFrameAcceleration(Vector3 *linearAcceleration) const
+    {
+        *linearAcceleration = store->mass[getIndex()].lastFrameAcceleration;
+    }
+
+    inline Vector3 RigidBody::getLastFrameAcceleration() const
+    {
+        return store->mass[getIndex()].lastFrameAcceleration;
+    }
+
+    inline void RigidBody::clearAccumulators()
+    {
+        BodyForces &forces = store->forces[getIndex()];
+        forces.forceAccum.clear();
+        forces.torqueAccum.clear();
+    }
+
+    inline void RigidBody::addForce(const Vector3 &force)
+    {
+        setAwake();
+        store->forces[getIndex()].forceAccum += force;
+    }
+
+    inline void RigidBody::addForceAtPoint(const Vector3 &force,
+                                           const Vector3 &point)
+    {
+        // Convert to coordinates relative to center of mass.
+        setAwake();
+        unsigned index = getIndex();
+        Vector3 pt = point - store->motion[index].position;
+
+        store->forces[index].forceAccum += force;
+        store->forces[index].torqueAccum += pt % force;
+    }
+
+    inline void RigidBody::addForceAtBodyPoint(const Vector3 &force,
+                                               const Vector3 &point)
+    {
+        // Convert to coordinates relative to center of mass.
+        addForceAtPoint(force, getPointInWorldSpace(point));
+    }
+
+    inline void RigidBody::addTorque(const Vector3 &torque)
+    {
+        setAwake();
+        store->forces[getIndex()].torqueAccum += torque;
+    }
+
+    inline void RigidBody::setAcceleration(const Vector3 &acceleration)
+    {
+        store->forces[getIndex()].acceleration = acceleration;
+    }
+
+    inline void RigidBody::setAcceleration(const real x, const real y, const real z)
+    {
+        setAcceleration(Vector3(x, y, z));
+    }
+
+    inline void RigidBody::getAcceleration(Vector3 *acceleration) const
+    {
+        *acceleration = store->forces[getIndex()].acceleration;
+    }
+
+    inline Vector3 RigidBody::getAcceleration() const
+    {
+        return store->forces[getIndex()].acceleration;
+    }
+
 } // namespace cyclone
 
 #endif // CYCLONE_BODY_H
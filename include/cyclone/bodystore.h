@@ -0,0 +1,554 @@
+/*
+ * Interface file for the rigid body store.
+ *
+ * Part of the Cyclone physics system.
+ *
+ * Copyright (c) Icosagon 2003. All Rights Reserved.
+ *
+ * This software is distributed under licence. Use of this software
+ * implies agreement with all terms and conditions of the accompanying
+ * software licence.
+ */
+
+/**
+ * @file
+ *
+ * This file contains the store that holds the state of any number of
+ * rigid bodies in contiguous arrays.
+ */
+#ifndef CYCLONE_BODYSTORE_H
+#define CYCLONE_BODYSTORE_H
+
+#include <vector>
+#include <algorithm>
+
+#include "core.h"
+#include "jobs.h"
+
+namespace cyclone {
+
+    /**
+     * Identifies a body in a RigidBodyStore. The position of a body
+     * in the store's arrays changes as other bodies are removed or
+     * fall asleep, but its handle stays the same.
+     */
+    typedef unsigned BodyHandle;
+
+    /**
+     * A handle that refers to no body.
+     */
+    const BodyHandle INVALID_BODY_HANDLE = ~0u;
+
+    /**
+     * Holds the kinematic state of a body. This is read and written
+     * by every integration step, and read by the contact resolver
+     * for every contact the body is part of.
+     */
+    struct BodyMotion
+    {
+        Vector3 position;
+        Quaternion orientation;
+        Vector3 velocity;
+        Vector3 rotation;
+    };
+
+    /**
+     * Holds the values the contact resolver needs besides the
+     * kinematic state: the inverse mass, the inverse inertia tensor
+     * in world space and the acceleration of the last step.
+     */
+    struct BodyMass
+    {
+        Matrix3 inverseInertiaTensorWorld;
+        Vector3 lastFrameAcceleration;
+        real inverseMass;
+    };
+
+    /**
+     * Holds the force and torque accumulated for the next step, and
+     * the constant acceleration of the body. These are only touched
+     * by force generators and by integration.
+     */
+    struct BodyForces
+    {
+        Vector3 forceAccum;
+        Vector3 torqueAccum;
+        Vector3 acceleration;
+    };
+
+    /**
+     * Holds the characteristics of a body that change rarely: the
+     * inertia tensor in body space, the damping and the sleep
+     * settings. These are read once per step by integration and are
+     * never touched by collision detection or contact resolution.
+     */
+    struct BodyProperties
+    {
+        Matrix3 inverseInertiaTensor;
+        real linearDamping;
+        real angularDamping;
+        real motion;
+        bool canSleep;
+    };
+
+    /**
+     * Holds the state of a set of rigid bodies in contiguous arrays.
+     *
+     * The state is split by how often it is used, so that each pass
+     * over the bodies only pulls in the data it needs. Integration
+     * streams through motion, mass, forces and properties in order,
+     * and the contact resolver only touches motion and mass, which
+     * for a body are a few cache lines rather than the whole body.
+     *
+     * Bodies are accessed through handles. Removal moves the last
+     * body into the gap, so the arrays never have holes.
+     *
+     * Awake bodies are always at the front of the arrays, in
+     * [0, getAwakeCount()). Putting a body to sleep or waking it
+     * swaps it with the body at the boundary, so its index changes.
+     * Integration only processes the awake range.
+     */
+    class RigidBodyStore
+    {
+    public:
+        /** Holds the kinematic state of each body. */
+        std::vector<BodyMotion> motion;
+
+        /** Holds the mass properties used by contact resolution. */
+        std::vector<BodyMass> mass;
+
+        /** Holds the accumulators and constant acceleration. */
+        std::vector<BodyForces> forces;
+
+        /**
+         * Holds the transform of each body, calculated from its
+         * position and orientation by calculateDerivedData.
+         */
+        std::vector<Matrix4> transforms;
+
+        /** Holds the rarely changing characteristics of each body. */
+        std::vector<BodyProperties> properties;
+
+    protected:
+        /**
+         * Maps each handle to the index of its body, or to
+         * INVALID_BODY_HANDLE for a handle that is not in use.
+         */
+        std::vector<unsigned> handleToIndex;
+
+        /** Maps each index to the handle of its body. */
+        std::vector<BodyHandle> indexToHandle;
+
+        /** Holds the handles that can be reused. */
+        std::vector<BodyHandle> freeHandles;
+
+        /** Holds the number of awake bodies. */
+        unsigned awakeCount;
+
+        /**
+         * Holds the pool that integration and derived data are split
+         * across, or NULL to run them on the calling thread.
+         */
+        JobPool *jobPool;
+
+    public:
+        /**
+         * Holds the number of bodies each job processes.
+         */
+        static const unsigned JOB_CHUNK_SIZE = 256;
+
+        RigidBodyStore()
+            : awakeCount(0), jobPool(0)
+        {
+        }
+
+        /**
+         * Sets the pool that integrate and calculateDerivedData split
+         * their work across. Each body only touches its own entries,
+         * so the results are the same for any number of threads.
+         * NULL runs them on the calling thread.
+         */
+        void setJobPool(JobPool *pool)
+        {
+            jobPool = pool;
+        }
+
+        /** Returns the pool used for integration, or NULL. */
+        JobPool* getJobPool() const
+        {
+            return jobPool;
+        }
+
+        /**
+         * Adds a new awake body with unit mass and inertia, no
+         * velocity and no damping, and returns its handle.
+         */
+        BodyHandle create()
+        {
+            BodyHandle handle;
+            if (!freeHandles.empty())
+            {
+                handle = freeHandles.back();
+                freeHandles.pop_back();
+            }
+            else
+            {
+                handle = (BodyHandle)handleToIndex.size();
+                handleToIndex.push_back(INVALID_BODY_HANDLE);
+            }
+
+            BodyMotion bodyMotion;
+            bodyMotion.orientation = Quaternion(1, 0, 0, 0);
+            BodyMass bodyMass;
+            bodyMass.inverseInertiaTensorWorld.setDiagonal(1, 1, 1);
+            bodyMass.inverseMass = 1;
+            BodyForces bodyForces;
+            BodyProperties bodyProperties;
+            bodyProperties.inverseInertiaTensor.setDiagonal(1, 1, 1);
+            bodyProperties.linearDamping = 1;
+            bodyProperties.angularDamping = 1;
+            bodyProperties.motion = getSleepEpsilon() * 2;
+            bodyProperties.canSleep = true;
+
+            unsigned index = size();
+            motion.push_back(bodyMotion);
+            mass.push_back(bodyMass);
+            forces.push_back(bodyForces);
+            transforms.push_back(Matrix4());
+            properties.push_back(bodyProperties);
+            indexToHandle.push_back(handle);
+            handleToIndex[handle] = index;
+
+            // New bodies are awake, so move it to the awake range.
+            swapBodies(index, awakeCount);
+            awakeCount++;
+            return handle;
+        }
+
+        /**
+         * Removes the body with the given handle. The last body is
+         * moved into its place, so that body's index changes.
+         */
+        void destroy(BodyHandle handle)
+        {
+            unsigned index = indexOf(handle);
+
+            // Keep the awake range packed.
+            if (index < awakeCount)
+            {
+                awakeCount--;
+                swapBodies(index, awakeCount);
+                index = awakeCount;
+            }
+
+            swapBodies(index, size() - 1);
+            motion.pop_back();
+            mass.pop_back();
+            forces.pop_back();
+            transforms.pop_back();
+            properties.pop_back();
+            indexToHandle.pop_back();
+
+            handleToIndex[handle] = INVALID_BODY_HANDLE;
+            freeHandles.push_back(handle);
+        }
+
+        /**
+         * Returns true if the handle refers to a body in this store.
+         */
+        bool isValid(BodyHandle handle) const
+        {
+            return handle < handleToIndex.size() &&
+                handleToIndex[handle] != INVALID_BODY_HANDLE;
+        }
+
+        /** Returns the current index of the body with the given handle. */
+        unsigned indexOf(BodyHandle handle) const
+        {
+            return handleToIndex[handle];
+        }
+
+        /** Returns the handle of the body at the given index. */
+        BodyHandle handleOf(unsigned index) const
+        {
+            return indexToHandle[index];
+        }
+
+        /** Returns the number of bodies in the store. */
+        unsigned size() const
+        {
+            return (unsigned)indexToHandle.size();
+        }
+
+        /** Returns the number of awake bodies. */
+        unsigned getAwakeCount() const
+        {
+            return awakeCount;
+        }
+
+        /** Returns true if the body at the given index is awake. */
+        bool isAwake(unsigned index) const
+        {
+            return index < awakeCount;
+        }
+
+        /**
+         * Wakes or puts to sleep the body at the given index. The body
+         * is swapped with the body at the edge of the awake range, so
+         * the index of both changes. A body put to sleep loses its
+         * velocity, as in RigidBody::setAwake.
+         */
+        void setAwake(unsigned index, bool awake)
+        {
+            if (awake == isAwake(index)) return;
+
+            if (awake)
+            {
+                swapBodies(index, awakeCount);
+                properties[awakeCount].motion = getSleepEpsilon() * 2;
+                awakeCount++;
+            }
+            else
+            {
+                awakeCount--;
+                swapBodies(index, awakeCount);
+                motion[awakeCount].velocity.clear();
+                motion[awakeCount].rotation.clear();
+            }
+        }
+
+        /**
+         * Reserves room for the given number of bodies, so adding
+         * bodies up to that number doesn't move the arrays.
+         */
+        void reserve(unsigned count)
+        {
+            motion.reserve(count);
+            mass.reserve(count);
+            forces.reserve(count);
+            transforms.reserve(count);
+            properties.reserve(count);
+            indexToHandle.reserve(count);
+            handleToIndex.reserve(count);
+        }
+
+        /**
+         * Normalises the orientation of the body at the given index
+         * and calculates its transform and world space inverse
+         * inertia tensor.
+         */
+        void calculateDerivedData(unsigned index)
+        {
+            BodyMotion &bodyMotion = motion[index];
+            bodyMotion.orientation.normalise();
+
+            Matrix4 &transform = transforms[index];
+            transform.setOrientationAndPos(bodyMotion.orientation,
+                                           bodyMotion.position);
+
+            // Rotate the inertia tensor into world space: R * I * R^T.
+            Matrix3 rotationMatrix(
+                transform.data[0], transform.data[1], transform.data[2],
+                transform.data[4], transform.data[5], transform.data[6],
+                transform.data[8], transform.data[9], transform.data[10]
+                );
+            mass[index].inverseInertiaTensorWorld = rotationMatrix *
+                properties[index].inverseInertiaTensor *
+                rotationMatrix.transpose();
+        }
+
+        /**
+         * Calculates the derived data of every body, split across
+         * the job pool if one is set.
+         */
+        void calculateDerivedData()
+        {
+            const unsigned count = size();
+            if (!jobPool || count <= JOB_CHUNK_SIZE)
+            {
+                for (unsigned i = 0; i < count; i++) calculateDerivedData(i);
+                return;
+            }
+
+            const unsigned chunks = (count + JOB_CHUNK_SIZE - 1) / JOB_CHUNK_SIZE;
+            jobPool->parallelFor(chunks, [this, count](unsigned chunk, unsigned)
+            {
+                unsigned end = (std::min)(count, (chunk + 1) * JOB_CHUNK_SIZE);
+                for (unsigned i = chunk * JOB_CHUNK_SIZE; i < end; i++)
+                {
+                    calculateDerivedData(i);
+                }
+            });
+        }
+
+        /**
+         * Integrates the body at the given index forward in time, in
+         * the same way as RigidBody::integrate, but doesn't put the
+         * body to sleep. Sleeping bodies are left unchanged.
+         */
+        void integrate(unsigned index, real duration)
+        {
+            if (!isAwake(index)) return;
+
+            BodyMotion &bodyMotion = motion[index];
+            BodyMass &bodyMass = mass[index];
+            BodyForces &bodyForces = forces[index];
+            const BodyProperties &bodyProperties = properties[index];
+
+            // Work out the linear and angular acceleration.
+            bodyMass.lastFrameAcceleration = bodyForces.acceleration;
+            bodyMass.lastFrameAcceleration.addScaledVector(
+                bodyForces.forceAccum, bodyMass.inverseMass);
+            Vector3 angularAcceleration =
+                bodyMass.inverseInertiaTensorWorld.transform(bodyForces.torqueAccum);
+
+            // Update the velocities, then impose drag.
+            bodyMotion.velocity.addScaledVector(bodyMass.lastFrameAcceleration, duration);
+            bodyMotion.rotation.addScaledVector(angularAcceleration, duration);
+            bodyMotion.velocity *= real_pow(bodyProperties.linearDamping, duration);
+            bodyMotion.rotation *= real_pow(bodyProperties.angularDamping, duration);
+
+            // Update the position and orientation.
+            bodyMotion.position.addScaledVector(bodyMotion.velocity, duration);
+            bodyMotion.orientation.addScaledVector(bodyMotion.rotation, duration);
+
+            calculateDerivedData(index);
+
+            bodyForces.forceAccum.clear();
+            bodyForces.torqueAccum.clear();
+        }
+
+        /**
+         * Integrates every awake body forward in time, then puts to
+         * sleep the bodies that can sleep and have barely moved for a
+         * while. The integration is split across the job pool if one
+         * is set.
+         */
+        void integrate(real duration)
+        {
+            const unsigned count = awakeCount;
+            if (!jobPool || count <= JOB_CHUNK_SIZE)
+            {
+                for (unsigned i = 0; i < count; i++) integrate(i, duration);
+            }
+            else
+            {
+                const unsigned chunks = (count + JOB_CHUNK_SIZE - 1) / JOB_CHUNK_SIZE;
+                jobPool->parallelFor(chunks, [this, count, duration](unsigned chunk, unsigned)
+                {
+                    unsigned end = (std::min)(count, (chunk + 1) * JOB_CHUNK_SIZE);
+                    for (unsigned i = chunk * JOB_CHUNK_SIZE; i < end; i++)
+                    {
+                        integrate(i, duration);
+                    }
+                });
+            }
+
+            // Putting bodies to sleep moves them, so it stays serial.
+            updateMotion(duration);
+        }
+
+        /**
+         * Clears the force and torque accumulators of every body.
+         */
+        void clearAccumulators()
+        {
+            const unsigned count = size();
+            for (unsigned i = 0; i < count; i++)
+            {
+                forces[i].forceAccum.clear();
+                forces[i].torqueAccum.clear();
+            }
+        }
+
+        /**
+         * Removes every body. Outstanding handles become invalid.
+         */
+        void clear()
+        {
+            motion.clear();
+            mass.clear();
+            forces.clear();
+            transforms.clear();
+            properties.clear();
+            handleToIndex.clear();
+            indexToHandle.clear();
+            freeHandles.clear();
+            awakeCount = 0;
+        }
+
+        /**
+         * Returns the store used by rigid bodies that are created
+         * without one. It is never destroyed, so bodies in static
+         * objects can safely outlive the other statics.
+         */
+        static RigidBodyStore& standalone()
+        {
+            static RigidBodyStore *store = new RigidBodyStore();
+            return *store;
+        }
+
+        /**
+         * Updates the recent-weighted motion of the body at the given
+         * index, and puts it to sleep if that has fallen below the
+         * sleep epsilon. Only awake bodies that can sleep are updated.
+         * Returns true if the body was put to sleep, in which case it
+         * has been moved to the end of the awake range.
+         */
+        bool updateMotion(unsigned index, real duration)
+        {
+            BodyProperties &bodyProperties = properties[index];
+            if (!isAwake(index) || !bodyProperties.canSleep) return false;
+
+            const BodyMotion &bodyMotion = motion[index];
+            real currentMotion =
+                bodyMotion.velocity.scalarProduct(bodyMotion.velocity) +
+                bodyMotion.rotation.scalarProduct(bodyMotion.rotation);
+            real bias = real_pow((real)0.5, duration);
+            bodyProperties.motion = bias*bodyProperties.motion + (1-bias)*currentMotion;
+
+            const real epsilon = getSleepEpsilon();
+            if (bodyProperties.motion < epsilon)
+            {
+                setAwake(index, false);
+                return true;
+            }
+            if (bodyProperties.motion > 10 * epsilon)
+            {
+                bodyProperties.motion = 10 * epsilon;
+            }
+            return false;
+        }
+
+    protected:
+        /**
+         * Updates the motion of every awake body. This walks
+         * backwards, so bodies swapped out of the awake range have
+         * already been visited.
+         */
+        void updateMotion(real duration)
+        {
+            for (unsigned i = awakeCount; i > 0; i--) updateMotion(i - 1, duration);
+        }
+
+        /**
+         * Swaps the bodies at the two indices, keeping their handles.
+         */
+        void swapBodies(unsigned a, unsigned b)
+        {
+            if (a == b) return;
+
+            std::swap(motion[a], motion[b]);
+            std::swap(mass[a], mass[b]);
+            std::swap(forces[a], forces[b]);
+            std::swap(transforms[a], transforms[b]);
+            std::swap(properties[a], properties[b]);
+            std::swap(indexToHandle[a], indexToHandle[b]);
+            handleToIndex[indexToHandle[a]] = a;
+            handleToIndex[indexToHandle[b]] = b;
+        }
+    };
+
+} // namespace cyclone
+
+#endif // CYCLONE_BODYSTORE_H
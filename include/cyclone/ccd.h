@@ -0,0 +1,592 @@
+/*
+ * Interface file for continuous collision detection.
+ *
+ * Part of the Cyclone physics system.
+ *
+ * Copyright (c) Icosagon 2003. All Rights Reserved.
+ *
+ * This software is distributed under licence. Use of this software
+ * implies agreement with all terms and conditions of the accompanying
+ * software licence.
+ */
+
+/**
+ * @file
+ *
+ * This file contains swept sphere tests, and a pass that uses them
+ * to stop fast particles and rigid bodies from passing through thin
+ * geometry between two steps.
+ *
+ * The discrete collision tests only see where objects are at the end
+ * of each step, so an object that moves further than the thickness
+ * of a target in one step can jump over it. The swept tests find the
+ * first time in the step at which a sphere moving in a straight line
+ * touches the target, and the pass moves the object back to that
+ * point.
+ */
+#ifndef CYCLONE_CCD_H
+#define CYCLONE_CCD_H
+
+#include <vector>
+
+#include "collide_fine.h"
+#include "particle.h"
+
+namespace cyclone {
+
+    /**
+     * Holds the result of a swept test.
+     */
+    struct SweepHit
+    {
+        /**
+         * The fraction of the motion, from 0 to 1, at which the
+         * sphere first touches the target.
+         */
+        real time;
+
+        /** The centre of the sphere at the time of impact. */
+        Vector3 position;
+
+        /** The point where the sphere touches the target. */
+        Vector3 point;
+
+        /** The surface normal of the target at the point of impact. */
+        Vector3 normal;
+    };
+
+    /**
+     * A wrapper class that holds swept sphere tests.
+     *
+     * Each test takes a sphere of the given radius whose centre moves
+     * from start to start + motion, and a target that stays still
+     * during the motion. It returns true and fills in the hit if the
+     * sphere touches the target. A sphere that already overlaps the
+     * target at the start is reported at time 0 if it is moving
+     * further in, and not at all if it is moving out: the discrete
+     * tests deal with objects that are already in contact.
+     */
+    class SweepTests
+    {
+    public:
+        /**
+         * Sweeps a sphere against a half-space, whose normal points
+         * out of the half-space.
+         */
+        static bool sphereAndHalfSpace(
+            const Vector3 &start, const Vector3 &motion, real radius,
+            const CollisionPlane &plane,
+            SweepHit *hit)
+        {
+            real distance = start * plane.direction - plane.offset;
+            real approach = motion * plane.direction;
+            if (approach >= 0) return false;
+
+            real time = 0;
+            if (distance > radius)
+            {
+                time = (radius - distance) / approach;
+                if (time > 1) return false;
+            }
+
+            hit->time = time;
+            hit->position = start + motion * time;
+            hit->normal = plane.direction;
+            hit->point = hit->position - plane.direction * radius;
+            return true;
+        }
+
+        /**
+         * Sweeps a sphere against a collision sphere.
+         */
+        static bool sphereAndSphere(
+            const Vector3 &start, const Vector3 &motion, real radius,
+            const CollisionSphere &sphere,
+            SweepHit *hit)
+        {
+            Vector3 centre = sphere.getAxis(3);
+            real time;
+            if (!sweepPoint(start - centre, motion, radius + sphere.radius, time))
+            {
+                return false;
+            }
+
+            hit->time = time;
+            hit->position = start + motion * time;
+            hit->normal = hit->position - centre;
+            hit->normal.normalise();
+            hit->point = centre + hit->normal * sphere.radius;
+            return true;
+        }
+
+        /**
+         * Sweeps a sphere against a collision box. The sphere can
+         * touch a face, an edge or a corner of the box first, so each
+         * is tried, once a test against the box grown by the radius
+         * has shown that the sphere comes close enough.
+         */
+        static bool sphereAndBox(
+            const Vector3 &start, const Vector3 &motion, real radius,
+            const CollisionBox &box,
+            SweepHit *hit)
+        {
+            const Matrix4 &transform = box.getTransform();
+            const Vector3 &h = box.halfSize;
+            Vector3 s = transform.transformInverse(start);
+            Vector3 m = transform.transformInverseDirection(motion);
+
+            // The sphere may already be touching the box.
+            Vector3 closest = s;
+            for (unsigned i = 0; i < 3; i++)
+            {
+                if (closest[i] > h[i]) closest[i] = h[i];
+                else if (closest[i] < -h[i]) closest[i] = -h[i];
+            }
+            Vector3 outward = s - closest;
+            if (outward.squareMagnitude() <= radius * radius)
+            {
+                Vector3 normal;
+                if (outward.squareMagnitude() > 0)
+                {
+                    normal = outward.unit();
+                }
+                else
+                {
+                    // The centre is inside: use the nearest face.
+                    unsigned axis = 0;
+                    real least = REAL_MAX;
+                    for (unsigned i = 0; i < 3; i++)
+                    {
+                        real depth = h[i] - real_abs(s[i]);
+                        if (depth < least)
+                        {
+                            least = depth;
+                            axis = i;
+                        }
+                    }
+                    normal[axis] = s[axis] < 0 ? -1.0f : 1.0f;
+                }
+                if (m * normal >= 0) return false;
+                return fillBoxHit(start, motion, radius, transform, 0, normal, hit);
+            }
+
+            // Early out against the box grown by the radius.
+            real enter = 0, leave = 1;
+            for (unsigned i = 0; i < 3; i++)
+            {
+                real limit = h[i] + radius;
+                if (real_abs(m[i]) < (real)1e-12)
+                {
+                    if (s[i] > limit || s[i] < -limit) return false;
+                    continue;
+                }
+                real t0 = (-limit - s[i]) / m[i];
+                real t1 = (limit - s[i]) / m[i];
+                if (t0 > t1) { real swap = t0; t0 = t1; t1 = swap; }
+                if (t0 > enter) enter = t0;
+                if (t1 < leave) leave = t1;
+                if (enter > leave) return false;
+            }
+
+            real best = REAL_MAX;
+            Vector3 normal;
+
+            // Faces: the sphere touches the face plane pushed out by
+            // the radius, inside the face.
+            for (unsigned k = 0; k < 3; k++)
+            {
+                if (m[k] == 0) continue;
+                real side = m[k] < 0 ? 1.0f : -1.0f;
+                real time = (side * (h[k] + radius) - s[k]) / m[k];
+                if (time < 0 || time > 1 || time >= best) continue;
+
+                unsigned i = (k + 1) % 3, j = (k + 2) % 3;
+                if (real_abs(s[i] + m[i] * time) > h[i]) continue;
+                if (real_abs(s[j] + m[j] * time) > h[j]) continue;
+
+                best = time;
+                normal = Vector3();
+                normal[k] = side;
+            }
+
+            // Edges: the sphere touches the cylinder around the edge,
+            // between its ends.
+            for (unsigned k = 0; k < 3; k++)
+            {
+                unsigned i = (k + 1) % 3, j = (k + 2) % 3;
+                real a = m[i]*m[i] + m[j]*m[j];
+                if (a < (real)1e-12) continue;
+
+                for (unsigned corner = 0; corner < 4; corner++)
+                {
+                    real ci = (corner & 1) ? h[i] : -h[i];
+                    real cj = (corner & 2) ? h[j] : -h[j];
+                    real fi = s[i] - ci, fj = s[j] - cj;
+                    real b = fi*m[i] + fj*m[j];
+                    real c = fi*fi + fj*fj - radius*radius;
+                    real discriminant = b*b - a*c;
+                    if (b >= 0 || discriminant < 0) continue;
+
+                    real time = (-b - real_sqrt(discriminant)) / a;
+                    if (time < 0 || time > 1 || time >= best) continue;
+                    if (real_abs(s[k] + m[k] * time) > h[k]) continue;
+
+                    best = time;
+                    normal = Vector3();
+                    normal[i] = fi + m[i] * time;
+                    normal[j] = fj + m[j] * time;
+                    normal.normalise();
+                }
+            }
+
+            // Corners.
+            for (unsigned corner = 0; corner < 8; corner++)
+            {
+                Vector3 point(
+                    (corner & 1) ? h.x : -h.x,
+                    (corner & 2) ? h.y : -h.y,
+                    (corner & 4) ? h.z : -h.z);
+                real time;
+                if (!sweepPoint(s - point, m, radius, time)) continue;
+                if (time >= best) continue;
+
+                best = time;
+                normal = (s + m * time) - point;
+                normal.normalise();
+            }
+
+            if (best > 1) return false;
+            return fillBoxHit(start, motion, radius, transform, best, normal, hit);
+        }
+
+    protected:
+        /**
+         * Finds the first time in [0, 1] at which a point starting at
+         * offset and moving by motion comes within the given distance
+         * of the origin.
+         */
+        static bool sweepPoint(const Vector3 &offset, const Vector3 &motion,
+                               real distance, real &time)
+        {
+            real c = offset.squareMagnitude() - distance * distance;
+            real b = offset * motion;
+            if (b >= 0) return false;
+            if (c <= 0)
+            {
+                time = 0;
+                return true;
+            }
+
+            real a = motion.squareMagnitude();
+            real discriminant = b*b - a*c;
+            if (discriminant < 0) return false;
+
+            time = (-b - real_sqrt(discriminant)) / a;
+            return time <= 1;
+        }
+
+        /**
+         * Fills in a hit against a box from a normal in the box's
+         * local space.
+         */
+        static bool fillBoxHit(const Vector3 &start, const Vector3 &motion,
+                               real radius, const Matrix4 &transform,
+                               real time, const Vector3 &localNormal,
+                               SweepHit *hit)
+        {
+            hit->time = time;
+            hit->position = start + motion * time;
+            hit->normal = transform.transformDirection(localNormal);
+            hit->point = hit->position - hit->normal * radius;
+            return true;
+        }
+    };
+
+    /**
+     * Holds the targets and the fast moving objects for continuous
+     * collision detection, and runs the pass that keeps the objects
+     * from passing through the targets.
+     *
+     * Particles and bodies are registered with the radius of a sphere
+     * that encloses them. Call beginStep before they are integrated
+     * and endStep after: beginStep notes where each object faster
+     * than the speed threshold starts, and endStep sweeps those
+     * objects from there to where they have got to. An object that
+     * hits a target is moved back to the point of impact and loses
+     * the part of its velocity going into the target, so the discrete
+     * contact tests take over in the next step. Objects below the
+     * threshold are skipped.
+     */
+    class ContinuousCollision
+    {
+    public:
+        /**
+         * Holds a hit found in the last pass. Either the particle or
+         * the body is set.
+         */
+        struct Hit
+        {
+            Particle *particle;
+            RigidBody *body;
+            SweepHit sweep;
+        };
+
+    protected:
+        template <class Object>
+        struct Mover
+        {
+            Object *object;
+            real radius;
+
+            /** Where the object started the step, if it is fast. */
+            Vector3 start;
+            bool fast;
+        };
+
+        std::vector< Mover<Particle> > particles;
+        std::vector< Mover<RigidBody> > bodies;
+
+        std::vector<const CollisionPlane*> planes;
+        std::vector<const CollisionSphere*> spheres;
+        std::vector<const CollisionBox*> boxes;
+
+        std::vector<Hit> hits;
+
+        real speedThreshold;
+
+        /**
+         * Holds the fraction of the velocity into the target that
+         * is kept, reversed, after a hit.
+         */
+        real restitution;
+
+    public:
+        ContinuousCollision(real speedThreshold = 10, real restitution = 0)
+            : speedThreshold(speedThreshold), restitution(restitution)
+        {
+        }
+
+        /**
+         * Sets the speed above which objects are swept.
+         */
+        void setSpeedThreshold(real speed)
+        {
+            speedThreshold = speed;
+        }
+
+        real getSpeedThreshold() const
+        {
+            return speedThreshold;
+        }
+
+        /**
+         * Sets how much of the velocity into a target is kept,
+         * reversed, after a hit. Zero stops the object against the
+         * target.
+         */
+        void setRestitution(real value)
+        {
+            restitution = value;
+        }
+
+        void addPlane(const CollisionPlane *plane) { planes.push_back(plane); }
+        void addSphere(const CollisionSphere *sphere) { spheres.push_back(sphere); }
+        void addBox(const CollisionBox *box) { boxes.push_back(box); }
+
+        /**
+         * Removes every target.
+         */
+        void clearTargets()
+        {
+            planes.clear();
+            spheres.clear();
+            boxes.clear();
+        }
+
+        /**
+         * Registers a particle to be swept, enclosed in a sphere of
+         * the given radius.
+         */
+        void addParticle(Particle *particle, real radius)
+        {
+            Mover<Particle> mover;
+            mover.object = particle;
+            mover.radius = radius;
+            mover.fast = false;
+            particles.push_back(mover);
+        }
+
+        void removeParticle(Particle *particle)
+        {
+            for (unsigned i = 0; i < particles.size(); i++)
+            {
+                if (particles[i].object != particle) continue;
+                particles[i] = particles.back();
+                particles.pop_back();
+                return;
+            }
+        }
+
+        /**
+         * Registers a rigid body to be swept, enclosed in a sphere of
+         * the given radius around its centre.
+         */
+        void addBody(RigidBody *body, real radius)
+        {
+            Mover<RigidBody> mover;
+            mover.object = body;
+            mover.radius = radius;
+            mover.fast = false;
+            bodies.push_back(mover);
+        }
+
+        void removeBody(RigidBody *body)
+        {
+            for (unsigned i = 0; i < bodies.size(); i++)
+            {
+                if (bodies[i].object != body) continue;
+                bodies[i] = bodies.back();
+                bodies.pop_back();
+                return;
+            }
+        }
+
+        /**
+         * Finds the first target that a sphere moving from start to
+         * end touches. Targets attached to the ignored body are
+         * skipped, so a body is not swept against itself.
+         */
+        bool sweep(const Vector3 &start, const Vector3 &end, real radius,
+                   SweepHit *hit, const RigidBody *ignore = 0) const
+        {
+            Vector3 motion = end - start;
+            SweepHit candidate;
+            bool found = false;
+            hit->time = REAL_MAX;
+
+            for (unsigned i = 0; i < planes.size(); i++)
+            {
+                if (SweepTests::sphereAndHalfSpace(start, motion, radius,
+                        *planes[i], &candidate) &&
+                    candidate.time < hit->time)
+                {
+                    *hit = candidate;
+                    found = true;
+                }
+            }
+            for (unsigned i = 0; i < spheres.size(); i++)
+            {
+                if (ignore && spheres[i]->body == ignore) continue;
+                if (SweepTests::sphereAndSphere(start, motion, radius,
+                        *spheres[i], &candidate) &&
+                    candidate.time < hit->time)
+                {
+                    *hit = candidate;
+                    found = true;
+                }
+            }
+            for (unsigned i = 0; i < boxes.size(); i++)
+            {
+                if (ignore && boxes[i]->body == ignore) continue;
+                if (SweepTests::sphereAndBox(start, motion, radius,
+                        *boxes[i], &candidate) &&
+                    candidate.time < hit->time)
+                {
+                    *hit = candidate;
+                    found = true;
+                }
+            }
+            return found;
+        }
+
+        /**
+         * Notes where each registered object faster than the
+         * threshold starts the step. Call before integrating.
+         */
+        void beginStep()
+        {
+            hits.clear();
+            real threshold = speedThreshold * speedThreshold;
+            for (unsigned i = 0; i < particles.size(); i++)
+            {
+                Mover<Particle> &mover = particles[i];
+                mover.fast = mover.object->getVelocity().squareMagnitude() > threshold;
+                if (mover.fast) mover.start = mover.object->getPosition();
+            }
+            for (unsigned i = 0; i < bodies.size(); i++)
+            {
+                Mover<RigidBody> &mover = bodies[i];
+                mover.fast = mover.object->getAwake() &&
+                    mover.object->getVelocity().squareMagnitude() > threshold;
+                if (mover.fast) mover.start = mover.object->getPosition();
+            }
+        }
+
+        /**
+         * Sweeps each object noted by beginStep from its start to its
+         * current position, and moves the ones that hit a target back
+         * to the point of impact. Call after integrating. Returns the
+         * number of hits, which can then be read with getHits.
+         */
+        unsigned endStep()
+        {
+            for (unsigned i = 0; i < particles.size(); i++)
+            {
+                Mover<Particle> &mover = particles[i];
+                if (!mover.fast) continue;
+
+                Hit hit;
+                if (!sweep(mover.start, mover.object->getPosition(),
+                        mover.radius, &hit.sweep)) continue;
+
+                mover.object->setPosition(hit.sweep.position);
+                mover.object->setVelocity(
+                    removeApproach(mover.object->getVelocity(), hit.sweep.normal));
+                hit.particle = mover.object;
+                hit.body = 0;
+                hits.push_back(hit);
+            }
+            for (unsigned i = 0; i < bodies.size(); i++)
+            {
+                Mover<RigidBody> &mover = bodies[i];
+                if (!mover.fast) continue;
+
+                Hit hit;
+                if (!sweep(mover.start, mover.object->getPosition(),
+                        mover.radius, &hit.sweep, mover.object)) continue;
+
+                mover.object->setPosition(hit.sweep.position);
+                mover.object->setVelocity(
+                    removeApproach(mover.object->getVelocity(), hit.sweep.normal));
+                mover.object->calculateDerivedData();
+                hit.particle = 0;
+                hit.body = mover.object;
+                hits.push_back(hit);
+            }
+            return (unsigned)hits.size();
+        }
+
+        /**
+         * Returns the hits found by the last call to endStep.
+         */
+        const std::vector<Hit>& getHits() const
+        {
+            return hits;
+        }
+
+    protected:
+        /**
+         * Removes the part of the velocity going into the surface,
+         * keeping the restitution fraction of it reversed.
+         */
+        Vector3 removeApproach(const Vector3 &velocity, const Vector3 &normal) const
+        {
+            real approach = velocity * normal;
+            if (approach >= 0) return velocity;
+            return velocity - normal * (approach * (1 + restitution));
+        }
+    };
+
+} // namespace cyclone
+
+#endif // CYCLONE_CCD_H
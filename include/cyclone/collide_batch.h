@@ -0,0 +1,651 @@
+/*
+ * Interface file for the batched box collision tests.
+ *
+ * Part of the Cyclone physics system.
+ *
+ * Copyright (c) Icosagon 2003. All Rights Reserved.
+ *
+ * This software is distributed under licence. Use of this software
+ * implies agreement with all terms and conditions of the accompanying
+ * software licence.
+ */
+
+/**
+ * @file
+ *
+ * This file contains box-box tests that work on arrays of pairs,
+ * such as the potential contacts returned by the broadphase. The
+ * separating axis test is run on several pairs at once, one pair
+ * in each SIMD lane, and the contacts for the pairs that touch are
+ * written straight into the collision data.
+ */
+#ifndef CYCLONE_COLLIDE_BATCH_H
+#define CYCLONE_COLLIDE_BATCH_H
+
+#include "collide_fine.h"
+
+namespace cyclone {
+
+    /**
+     * Holds a pair of boxes to be tested against each other.
+     */
+    struct BoxPair
+    {
+        const CollisionBox *one;
+        const CollisionBox *two;
+    };
+
+    /**
+     * Holds one real for each pair in a batch. The arithmetic works
+     * on all the lanes at once: in SSE or NEON registers when the
+     * build has them, otherwise on a single lane.
+     *
+     * Comparisons return masks, which are RealLanes with every bit of
+     * a lane set or clear. Masks are only meant to be combined with
+     * the mask functions and passed to select.
+     */
+    struct RealLanes
+    {
+#if defined(CYCLONE_SIMD_SSE) || defined(CYCLONE_SIMD_NEON)
+        enum { WIDTH = 4 };
+#else
+        // Without SIMD, one pair at a time keeps the early out per
+        // pair.
+        enum { WIDTH = 1 };
+#endif
+
+#if defined(CYCLONE_SIMD_SSE)
+        __m128 v;
+
+        static RealLanes make(__m128 v) { RealLanes r; r.v = v; return r; }
+        static RealLanes load(const real *p) { return make(_mm_loadu_ps(p)); }
+        static RealLanes splat(real x) { return make(_mm_set1_ps(x)); }
+        void store(real *p) const { _mm_storeu_ps(p, v); }
+
+        RealLanes operator+(const RealLanes &o) const { return make(_mm_add_ps(v, o.v)); }
+        RealLanes operator-(const RealLanes &o) const { return make(_mm_sub_ps(v, o.v)); }
+        RealLanes operator*(const RealLanes &o) const { return make(_mm_mul_ps(v, o.v)); }
+        RealLanes operator/(const RealLanes &o) const { return make(_mm_div_ps(v, o.v)); }
+
+        static RealLanes absolute(const RealLanes &a)
+        {
+            return make(_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v));
+        }
+        static RealLanes squareRoot(const RealLanes &a) { return make(_mm_sqrt_ps(a.v)); }
+        static RealLanes lessThan(const RealLanes &a, const RealLanes &b)
+        {
+            return make(_mm_cmplt_ps(a.v, b.v));
+        }
+        static RealLanes maskAnd(const RealLanes &a, const RealLanes &b)
+        {
+            return make(_mm_and_ps(a.v, b.v));
+        }
+        static RealLanes maskOr(const RealLanes &a, const RealLanes &b)
+        {
+            return make(_mm_or_ps(a.v, b.v));
+        }
+        /** Returns the lanes of a that are not set in b. */
+        static RealLanes maskAndNot(const RealLanes &a, const RealLanes &b)
+        {
+            return make(_mm_andnot_ps(b.v, a.v));
+        }
+        /** Takes the lanes of a where the mask is set, else of b. */
+        static RealLanes select(const RealLanes &mask,
+                                const RealLanes &a, const RealLanes &b)
+        {
+            return make(_mm_or_ps(_mm_and_ps(mask.v, a.v),
+                                  _mm_andnot_ps(mask.v, b.v)));
+        }
+        /** Returns one bit for each lane of the mask, lane 0 lowest. */
+        static unsigned maskBits(const RealLanes &mask)
+        {
+            return (unsigned)_mm_movemask_ps(mask.v);
+        }
+
+#elif defined(CYCLONE_SIMD_NEON)
+        float32x4_t v;
+
+        static RealLanes make(float32x4_t v) { RealLanes r; r.v = v; return r; }
+        static RealLanes fromMask(uint32x4_t m) { return make(vreinterpretq_f32_u32(m)); }
+        uint32x4_t bits() const { return vreinterpretq_u32_f32(v); }
+        static RealLanes load(const real *p) { return make(vld1q_f32(p)); }
+        static RealLanes splat(real x) { return make(vdupq_n_f32(x)); }
+        void store(real *p) const { vst1q_f32(p, v); }
+
+        RealLanes operator+(const RealLanes &o) const { return make(vaddq_f32(v, o.v)); }
+        RealLanes operator-(const RealLanes &o) const { return make(vsubq_f32(v, o.v)); }
+        RealLanes operator*(const RealLanes &o) const { return make(vmulq_f32(v, o.v)); }
+        RealLanes operator/(const RealLanes &o) const
+        {
+#if defined(__aarch64__)
+            return make(vdivq_f32(v, o.v));
+#else
+            real a[WIDTH], b[WIDTH];
+            store(a); o.store(b);
+            for (unsigned i = 0; i < WIDTH; i++) a[i] /= b[i];
+            return load(a);
+#endif
+        }
+
+        static RealLanes absolute(const RealLanes &a) { return make(vabsq_f32(a.v)); }
+        static RealLanes squareRoot(const RealLanes &a)
+        {
+#if defined(__aarch64__)
+            return make(vsqrtq_f32(a.v));
+#else
+            real r[WIDTH];
+            a.store(r);
+            for (unsigned i = 0; i < WIDTH; i++) r[i] = real_sqrt(r[i]);
+            return load(r);
+#endif
+        }
+        static RealLanes lessThan(const RealLanes &a, const RealLanes &b)
+        {
+            return fromMask(vcltq_f32(a.v, b.v));
+        }
+        static RealLanes maskAnd(const RealLanes &a, const RealLanes &b)
+        {
+            return fromMask(vandq_u32(a.bits(), b.bits()));
+        }
+        static RealLanes maskOr(const RealLanes &a, const RealLanes &b)
+        {
+            return fromMask(vorrq_u32(a.bits(), b.bits()));
+        }
+        static RealLanes maskAndNot(const RealLanes &a, const RealLanes &b)
+        {
+            return fromMask(vbicq_u32(a.bits(), b.bits()));
+        }
+        static RealLanes select(const RealLanes &mask,
+                                const RealLanes &a, const RealLanes &b)
+        {
+            return make(vbslq_f32(mask.bits(), a.v, b.v));
+        }
+        static unsigned maskBits(const RealLanes &mask)
+        {
+            unsigned lanes[WIDTH];
+            vst1q_u32(lanes, mask.bits());
+            unsigned bits = 0;
+            for (unsigned i = 0; i < WIDTH; i++) bits |= (lanes[i] & 1u) << i;
+            return bits;
+        }
+
+#else
+        // Masks hold 1 in the set lanes and 0 in the others.
+        real v[WIDTH];
+
+        static RealLanes load(const real *p)
+        {
+            RealLanes r;
+            for (unsigned i = 0; i < WIDTH; i++) r.v[i] = p[i];
+            return r;
+        }
+        static RealLanes splat(real x)
+        {
+            RealLanes r;
+            for (unsigned i = 0; i < WIDTH; i++) r.v[i] = x;
+            return r;
+        }
+        void store(real *p) const
+        {
+            for (unsigned i = 0; i < WIDTH; i++) p[i] = v[i];
+        }
+
+        RealLanes operator+(const RealLanes &o) const
+        {
+            RealLanes r;
+            for (unsigned i = 0; i < WIDTH; i++) r.v[i] = v[i] + o.v[i];
+            return r;
+        }
+        RealLanes operator-(const RealLanes &o) const
+        {
+            RealLanes r;
+            for (unsigned i = 0; i < WIDTH; i++) r.v[i] = v[i] - o.v[i];
+            return r;
+        }
+        RealLanes operator*(const RealLanes &o) const
+        {
+            RealLanes r;
+            for (unsigned i = 0; i < WIDTH; i++) r.v[i] = v[i] * o.v[i];
+            return r;
+        }
+        RealLanes operator/(const RealLanes &o) const
+        {
+            RealLanes r;
+            for (unsigned i = 0; i < WIDTH; i++) r.v[i] = v[i] / o.v[i];
+            return r;
+        }
+
+        static RealLanes absolute(const RealLanes &a)
+        {
+            RealLanes r;
+            for (unsigned i = 0; i < WIDTH; i++) r.v[i] = real_abs(a.v[i]);
+            return r;
+        }
+        static RealLanes squareRoot(const RealLanes &a)
+        {
+            RealLanes r;
+            for (unsigned i = 0; i < WIDTH; i++) r.v[i] = real_sqrt(a.v[i]);
+            return r;
+        }
+        static RealLanes lessThan(const RealLanes &a, const RealLanes &b)
+        {
+            RealLanes r;
+            for (unsigned i = 0; i < WIDTH; i++) r.v[i] = a.v[i] < b.v[i] ? 1 : 0;
+            return r;
+        }
+        static RealLanes maskAnd(const RealLanes &a, const RealLanes &b)
+        {
+            RealLanes r;
+            for (unsigned i = 0; i < WIDTH; i++) r.v[i] = (a.v[i] != 0 && b.v[i] != 0) ? 1 : 0;
+            return r;
+        }
+        static RealLanes maskOr(const RealLanes &a, const RealLanes &b)
+        {
+            RealLanes r;
+            for (unsigned i = 0; i < WIDTH; i++) r.v[i] = (a.v[i] != 0 || b.v[i] != 0) ? 1 : 0;
+            return r;
+        }
+        static RealLanes maskAndNot(const RealLanes &a, const RealLanes &b)
+        {
+            RealLanes r;
+            for (unsigned i = 0; i < WIDTH; i++) r.v[i] = (a.v[i] != 0 && b.v[i] == 0) ? 1 : 0;
+            return r;
+        }
+        static RealLanes select(const RealLanes &mask,
+                                const RealLanes &a, const RealLanes &b)
+        {
+            RealLanes r;
+            for (unsigned i = 0; i < WIDTH; i++) r.v[i] = mask.v[i] != 0 ? a.v[i] : b.v[i];
+            return r;
+        }
+        static unsigned maskBits(const RealLanes &mask)
+        {
+            unsigned bits = 0;
+            for (unsigned i = 0; i < WIDTH; i++) if (mask.v[i] != 0) bits |= 1u << i;
+            return bits;
+        }
+#endif
+    };
+
+    /**
+     * Holds box-box tests that take arrays of pairs.
+     *
+     * The pairs are taken RealLanes::WIDTH at a time. For each group
+     * the fifteen separating axes are tested on all the pairs of the
+     * group together, and the group stops as soon as every pair in
+     * it has a separating axis. The pairs that are left get the same
+     * contact as CollisionDetector::boxAndBox would give them: a
+     * vertex-face contact on the axis of least penetration, or an
+     * edge-edge contact.
+     *
+     * The tests work in the frame of the first box, and assume the
+     * box transforms are rotations and translations only, as they
+     * are for primitives attached to rigid bodies.
+     */
+    class BatchCollisionDetector
+    {
+    public:
+        /**
+         * Tests each pair for overlap, and writes true or false into
+         * the matching entry of results. Returns the number of pairs
+         * that overlap.
+         */
+        static unsigned boxAndBoxIntersections(
+            const BoxPair *pairs,
+            unsigned count,
+            bool *results)
+        {
+            unsigned overlapping = 0;
+            for (unsigned first = 0; first < count; first += RealLanes::WIDTH)
+            {
+                GroupResult group;
+                testGroup(pairs + first, groupSize(first, count), group);
+                for (unsigned lane = 0; lane < groupSize(first, count); lane++)
+                {
+                    results[first + lane] = (group.overlapping >> lane) & 1;
+                    if (results[first + lane]) overlapping++;
+                }
+            }
+            return overlapping;
+        }
+
+        /**
+         * Generates the contacts for each pair, and returns the
+         * number of contacts written. Stops early if the collision
+         * data runs out of room.
+         */
+        static unsigned boxAndBox(
+            const BoxPair *pairs,
+            unsigned count,
+            CollisionData *data)
+        {
+            unsigned written = 0;
+            for (unsigned first = 0; first < count; first += RealLanes::WIDTH)
+            {
+                GroupResult group;
+                testGroup(pairs + first, groupSize(first, count), group);
+                if (group.overlapping == 0) continue;
+
+                for (unsigned lane = 0; lane < groupSize(first, count); lane++)
+                {
+                    if (!((group.overlapping >> lane) & 1)) continue;
+                    if (!data->hasMoreContacts()) return written;
+
+                    fillContact(*pairs[first + lane].one, *pairs[first + lane].two,
+                        (unsigned)group.best[lane],
+                        (unsigned)group.bestSingleAxis[lane],
+                        group.penetration[lane], data);
+                    data->addContacts(1);
+                    written++;
+                }
+            }
+            return written;
+        }
+
+    protected:
+        /**
+         * Holds the result of the axis tests for one group of pairs.
+         * The axes are numbered as in CollisionDetector::boxAndBox:
+         * 0-2 are the faces of the first box, 3-5 the faces of the
+         * second, and 6-14 the edge-edge axes.
+         */
+        struct GroupResult
+        {
+            /** Holds one bit for each pair that has no separating axis. */
+            unsigned overlapping;
+
+            /** Holds the least penetration found for each pair. */
+            real penetration[RealLanes::WIDTH];
+
+            /** Holds the axis of least penetration for each pair. */
+            real best[RealLanes::WIDTH];
+
+            /** Holds the best of the face axes for each pair. */
+            real bestSingleAxis[RealLanes::WIDTH];
+
+            /** Holds the penetration on the best face axis. */
+            real singlePenetration[RealLanes::WIDTH];
+        };
+
+        static unsigned groupSize(unsigned first, unsigned count)
+        {
+            return count - first < (unsigned)RealLanes::WIDTH ?
+                count - first : (unsigned)RealLanes::WIDTH;
+        }
+
+        /**
+         * Folds the penetration on one axis into the running result.
+         * A negative penetration separates the pair; otherwise the
+         * axis becomes the best if it is strictly better, so ties go
+         * to the lower numbered axis. Lanes in skip are left alone.
+         */
+        static void testAxis(const RealLanes &penetration, real axis,
+                             const RealLanes &skip,
+                             RealLanes &separated, RealLanes &smallest,
+                             RealLanes &best)
+        {
+            const RealLanes zero = RealLanes::splat(0);
+            separated = RealLanes::maskOr(separated, RealLanes::maskAndNot(
+                RealLanes::lessThan(penetration, zero), skip));
+            const RealLanes better = RealLanes::maskAndNot(
+                RealLanes::lessThan(penetration, smallest), skip);
+            smallest = RealLanes::select(better, penetration, smallest);
+            best = RealLanes::select(better, RealLanes::splat(axis), best);
+        }
+
+        /**
+         * Runs the separating axis test on up to RealLanes::WIDTH
+         * pairs. Unused lanes repeat the last pair and are dropped
+         * from the result.
+         */
+        static void testGroup(const BoxPair *pairs, unsigned count,
+                              GroupResult &result)
+        {
+            typedef RealLanes L;
+            const unsigned W = L::WIDTH;
+
+            // Lay the transforms and sizes out one lane per pair.
+            real oneData[12][W], twoData[12][W];
+            real oneSize[3][W], twoSize[3][W];
+            for (unsigned lane = 0; lane < W; lane++)
+            {
+                const BoxPair &pair = pairs[lane < count ? lane : count - 1];
+                const real *one = pair.one->getTransform().data;
+                const real *two = pair.two->getTransform().data;
+                for (unsigned k = 0; k < 12; k++)
+                {
+                    oneData[k][lane] = one[k];
+                    twoData[k][lane] = two[k];
+                }
+                for (unsigned k = 0; k < 3; k++)
+                {
+                    oneSize[k][lane] = pair.one->halfSize[k];
+                    twoSize[k][lane] = pair.two->halfSize[k];
+                }
+            }
+
+            // The axis vectors are the columns of the transforms.
+            L oneAxis[3][3], twoAxis[3][3], toCentre[3];
+            L hOne[3], hTwo[3];
+            for (unsigned i = 0; i < 3; i++)
+            {
+                for (unsigned c = 0; c < 3; c++)
+                {
+                    oneAxis[i][c] = L::load(oneData[c*4 + i]);
+                    twoAxis[i][c] = L::load(twoData[c*4 + i]);
+                }
+                toCentre[i] = L::load(twoData[i*4 + 3]) - L::load(oneData[i*4 + 3]);
+                hOne[i] = L::load(oneSize[i]);
+                hTwo[i] = L::load(twoSize[i]);
+            }
+
+            // R[i][j] is the second box's axis j in the first box's
+            // frame, and t is the centre offset in both frames.
+            L R[3][3], absR[3][3], t[3], tTwo[3];
+            for (unsigned i = 0; i < 3; i++)
+            {
+                for (unsigned j = 0; j < 3; j++)
+                {
+                    R[i][j] = oneAxis[i][0]*twoAxis[j][0] +
+                        oneAxis[i][1]*twoAxis[j][1] + oneAxis[i][2]*twoAxis[j][2];
+                    absR[i][j] = L::absolute(R[i][j]);
+                }
+                t[i] = oneAxis[i][0]*toCentre[0] +
+                    oneAxis[i][1]*toCentre[1] + oneAxis[i][2]*toCentre[2];
+                tTwo[i] = twoAxis[i][0]*toCentre[0] +
+                    twoAxis[i][1]*toCentre[1] + twoAxis[i][2]*toCentre[2];
+            }
+
+            // Unused lanes start out separated, so they never hold
+            // the group up and never report a contact.
+            real laneIndex[W];
+            for (unsigned lane = 0; lane < W; lane++) laneIndex[lane] = (real)lane;
+            const L none = L::lessThan(L::splat(0), L::splat(0));
+            const unsigned allLanes = (1u << W) - 1;
+
+            L separated = L::lessThan(L::splat((real)count - (real)0.5),
+                                      L::load(laneIndex));
+            L smallest = L::splat(REAL_MAX);
+            L best = L::splat(0);
+
+            // The faces of the first box.
+            for (unsigned i = 0; i < 3 && L::maskBits(separated) != allLanes; i++)
+            {
+                L penetration = hOne[i] +
+                    hTwo[0]*absR[i][0] + hTwo[1]*absR[i][1] + hTwo[2]*absR[i][2] -
+                    L::absolute(t[i]);
+                testAxis(penetration, (real)i, none, separated, smallest, best);
+            }
+
+            // The faces of the second box.
+            for (unsigned j = 0; j < 3 && L::maskBits(separated) != allLanes; j++)
+            {
+                L penetration =
+                    hOne[0]*absR[0][j] + hOne[1]*absR[1][j] + hOne[2]*absR[2][j] +
+                    hTwo[j] - L::absolute(tTwo[j]);
+                testAxis(penetration, (real)(3 + j), none, separated, smallest, best);
+            }
+
+            const L bestSingleAxis = best;
+            const L singlePenetration = smallest;
+
+            // The edge-edge axes, skipping almost parallel edges.
+            const L parallelLimit = L::splat((real)0.0001);
+            for (unsigned i = 0; i < 3 && L::maskBits(separated) != allLanes; i++)
+            {
+                const unsigned i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+                for (unsigned j = 0; j < 3; j++)
+                {
+                    const unsigned j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+
+                    L squareLength = R[i1][j]*R[i1][j] + R[i2][j]*R[i2][j];
+                    L parallel = L::lessThan(squareLength, parallelLimit);
+                    squareLength = L::select(parallel, L::splat(1), squareLength);
+
+                    L penetration =
+                        hOne[i1]*absR[i2][j] + hOne[i2]*absR[i1][j] +
+                        hTwo[j1]*absR[i][j2] + hTwo[j2]*absR[i][j1] -
+                        L::absolute(t[i2]*R[i1][j] - t[i1]*R[i2][j]);
+                    penetration = penetration / L::squareRoot(squareLength);
+                    testAxis(penetration, (real)(6 + i*3 + j), parallel,
+                             separated, smallest, best);
+                }
+            }
+
+            result.overlapping = ~L::maskBits(separated) & allLanes;
+            smallest.store(result.penetration);
+            best.store(result.best);
+            bestSingleAxis.store(result.bestSingleAxis);
+            singlePenetration.store(result.singlePenetration);
+        }
+
+        /**
+         * Writes the contact for a face axis of the first box, using
+         * the vertex of the second box that lies deepest along the
+         * face normal. The first box becomes the first body of the
+         * contact.
+         */
+        static void fillPointFace(const CollisionBox &one,
+                                  const CollisionBox &two,
+                                  const Vector3 &toCentre,
+                                  unsigned best, real penetration,
+                                  CollisionData *data)
+        {
+            Contact *contact = data->contacts;
+
+            Vector3 normal = one.getAxis(best);
+            if (normal * toCentre > 0) normal = normal * -1.0f;
+
+            Vector3 vertex = two.halfSize;
+            if (two.getAxis(0) * normal < 0) vertex.x = -vertex.x;
+            if (two.getAxis(1) * normal < 0) vertex.y = -vertex.y;
+            if (two.getAxis(2) * normal < 0) vertex.z = -vertex.z;
+
+            contact->contactNormal = normal;
+            contact->penetration = penetration;
+            contact->contactPoint = two.getTransform() * vertex;
+            contact->setBodyData(one.body, two.body,
+                data->friction, data->restitution);
+        }
+
+        /**
+         * Returns the point halfway between the closest points of two
+         * edges. If the edges are parallel, or the closest points lie
+         * off the ends of the edges, the middle of one of the edges
+         * is used instead.
+         */
+        static Vector3 edgeContactPoint(
+            const Vector3 &pOne, const Vector3 &dOne, real oneSize,
+            const Vector3 &pTwo, const Vector3 &dTwo, real twoSize,
+            bool useOne)
+        {
+            real smOne = dOne.squareMagnitude();
+            real smTwo = dTwo.squareMagnitude();
+            real dpOneTwo = dTwo * dOne;
+
+            Vector3 toSt = pOne - pTwo;
+            real dpStaOne = dOne * toSt;
+            real dpStaTwo = dTwo * toSt;
+
+            real denom = smOne * smTwo - dpOneTwo * dpOneTwo;
+            if (real_abs(denom) < (real)0.0001) return useOne ? pOne : pTwo;
+
+            real mua = (dpOneTwo * dpStaTwo - smTwo * dpStaOne) / denom;
+            real mub = (smOne * dpStaTwo - dpOneTwo * dpStaOne) / denom;
+
+            if (mua > oneSize || mua < -oneSize ||
+                mub > twoSize || mub < -twoSize)
+            {
+                return useOne ? pOne : pTwo;
+            }
+
+            Vector3 cOne = pOne + dOne * mua;
+            Vector3 cTwo = pTwo + dTwo * mub;
+            return cOne * 0.5f + cTwo * 0.5f;
+        }
+
+        /**
+         * Writes the contact for a pair whose axis of least
+         * penetration is known.
+         */
+        static void fillContact(const CollisionBox &one,
+                                const CollisionBox &two,
+                                unsigned best, unsigned bestSingleAxis,
+                                real penetration, CollisionData *data)
+        {
+            Vector3 toCentre = two.getAxis(3) - one.getAxis(3);
+
+            if (best < 3)
+            {
+                fillPointFace(one, two, toCentre, best, penetration, data);
+                return;
+            }
+            if (best < 6)
+            {
+                // A vertex of the first box is on a face of the
+                // second, so the boxes swap roles.
+                fillPointFace(two, one, toCentre * -1.0f, best - 3,
+                    penetration, data);
+                return;
+            }
+
+            Contact *contact = data->contacts;
+
+            best -= 6;
+            unsigned oneAxisIndex = best / 3;
+            unsigned twoAxisIndex = best % 3;
+            Vector3 oneAxis = one.getAxis(oneAxisIndex);
+            Vector3 twoAxis = two.getAxis(twoAxisIndex);
+            Vector3 axis = oneAxis % twoAxis;
+            axis.normalise();
+            if (axis * toCentre > 0) axis = axis * -1.0f;
+
+            // Find the edge of each box that lies along the axis
+            // towards the other box, then its middle point.
+            Vector3 ptOnOneEdge = one.halfSize;
+            Vector3 ptOnTwoEdge = two.halfSize;
+            for (unsigned i = 0; i < 3; i++)
+            {
+                if (i == oneAxisIndex) ptOnOneEdge[i] = 0;
+                else if (one.getAxis(i) * axis > 0) ptOnOneEdge[i] = -ptOnOneEdge[i];
+
+                if (i == twoAxisIndex) ptOnTwoEdge[i] = 0;
+                else if (two.getAxis(i) * axis < 0) ptOnTwoEdge[i] = -ptOnTwoEdge[i];
+            }
+            ptOnOneEdge = one.getTransform() * ptOnOneEdge;
+            ptOnTwoEdge = two.getTransform() * ptOnTwoEdge;
+
+            contact->penetration = penetration;
+            contact->contactNormal = axis;
+            contact->contactPoint = edgeContactPoint(
+                ptOnOneEdge, oneAxis, one.halfSize[oneAxisIndex],
+                ptOnTwoEdge, twoAxis, two.halfSize[twoAxisIndex],
+                bestSingleAxis > 2);
+            contact->setBodyData(one.body, two.body,
+                data->friction, data->restitution);
+        }
+    };
+
+} // namespace cyclone
+
+#endif // CYCLONE_COLLIDE_BATCH_H
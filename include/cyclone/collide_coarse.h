@@ -21,6 +21,8 @@
 #define CYCLONE_COLLISION_COARSE_H
 
 #include <vector>
+#include <algorithm>
+#include <unordered_map>
 #include <cstddef>
 #include "contacts.h"
 
@@ -73,6 +75,93 @@ namespace cyclone {
         }
     };
 
+    /**
+     * Represents an axis aligned bounding box that can be tested for
+     * overlap. It provides the same interface as BoundingSphere, so it
+     * can also be used with BVHNode.
+     */
+    struct BoundingBox
+    {
+        Vector3 min;
+        Vector3 max;
+
+    public:
+        BoundingBox() {}
+
+        /**
+         * Creates a new bounding box with the given corners.
+         */
+        BoundingBox(const Vector3 &min, const Vector3 &max)
+            : min(min), max(max)
+        {
+        }
+
+        /**
+         * Creates a bounding box to enclose the two given bounding
+         * boxes.
+         */
+        BoundingBox(const BoundingBox &one, const BoundingBox &two)
+        {
+            min.x = one.min.x < two.min.x ? one.min.x : two.min.x;
+            min.y = one.min.y < two.min.y ? one.min.y : two.min.y;
+            min.z = one.min.z < two.min.z ? one.min.z : two.min.z;
+            max.x = one.max.x > two.max.x ? one.max.x : two.max.x;
+            max.y = one.max.y > two.max.y ? one.max.y : two.max.y;
+            max.z = one.max.z > two.max.z ? one.max.z : two.max.z;
+        }
+
+        /**
+         * Checks if the bounding box overlaps with the other given
+         * bounding box.
+         */
+        bool overlaps(const BoundingBox *other) const
+        {
+            return min.x <= other->max.x && other->min.x <= max.x &&
+                min.y <= other->max.y && other->min.y <= max.y &&
+                min.z <= other->max.z && other->min.z <= max.z;
+        }
+
+        /**
+         * Checks if the other given bounding box lies entirely inside
+         * this one.
+         */
+        bool contains(const BoundingBox &other) const
+        {
+            return min.x <= other.min.x && min.y <= other.min.y &&
+                min.z <= other.min.z && other.max.x <= max.x &&
+                other.max.y <= max.y && other.max.z <= max.z;
+        }
+
+        /**
+         * Returns the surface area of the box. This is the cost
+         * measure used to build trees of boxes.
+         */
+        real getSurfaceArea() const
+        {
+            Vector3 d = max - min;
+            return ((real)2.0) * (d.x*d.y + d.y*d.z + d.z*d.x);
+        }
+
+        /**
+         * Reports how much the surface area of this box would grow by
+         * to incorporate the given box.
+         */
+        real getGrowth(const BoundingBox &other) const
+        {
+            return BoundingBox(*this, other).getSurfaceArea() -
+                getSurfaceArea();
+        }
+
+        /**
+         * Returns the volume of this bounding box.
+         */
+        real getSize() const
+        {
+            Vector3 d = max - min;
+            return d.x * d.y * d.z;
+        }
+    };
+
     /**
      * Stores a potential contact to check later.
      */
@@ -204,7 +293,7 @@ namespace cyclone {
         const BVHNode<BoundingVolumeClass> * other
         ) const
     {
-        return volume->overlaps(other->volume);
+        return volume.overlaps(&other->volume);
     }
 
     template<class BoundingVolumeClass>
@@ -349,7 +438,7 @@ namespace cyclone {
         // a leaf, then we descend the other. If both are branches,
         // then we use the one with the largest size.
         if (other->isLeaf() ||
-            (!isLeaf() && volume->getSize() >= other->volume->getSize()))
+            (!isLeaf() && volume.getSize() >= other->volume.getSize()))
         {
             // Recurse into ourself
             unsigned count = children[0]->getPotentialContactsWith(
@@ -383,6 +472,828 @@ namespace cyclone {
         }
     }
 
+    /**
+     * This is the basic polymorphic interface for broadphases that
+     * track the bounding boxes of moving bodies and report the pairs
+     * that may be in contact. Bodies are referred to by the proxy
+     * returned from insert.
+     */
+    class Broadphase
+    {
+    public:
+        virtual ~Broadphase() {}
+
+        /**
+         * Adds the given body with the given bounding box, and
+         * returns its proxy.
+         */
+        virtual unsigned insert(RigidBody *body, const BoundingBox &box) = 0;
+
+        /**
+         * Removes the given proxy.
+         */
+        virtual void remove(unsigned proxy) = 0;
+
+        /**
+         * Tells the broadphase the new bounding box of the given
+         * proxy. The displacement is how far the body is expected to
+         * move before the next update, which a broadphase may use to
+         * avoid work. Returns true if the broadphase had to do work
+         * for the change.
+         */
+        virtual bool update(unsigned proxy, const BoundingBox &box,
+                            const Vector3 &displacement = Vector3()) = 0;
+
+        /**
+         * Writes every pair of bodies whose boxes may overlap to the
+         * given array (up to the given limit), and returns the number
+         * of pairs written. Each pair is reported once.
+         */
+        virtual unsigned getPotentialContacts(PotentialContact* contacts,
+                                              unsigned limit) = 0;
+    };
+
+    /**
+     * A bounding volume hierarchy of axis aligned boxes for bodies
+     * that move from frame to frame.
+     *
+     * Each body is stored in a leaf with a box that has been fattened
+     * by a margin, so small movements don't touch the tree at all.
+     * When a body leaves its fat box the leaf is removed and
+     * reinserted next to the sibling with the lowest surface area
+     * cost, and the nodes on the way back up are rotated wherever a
+     * rotation shrinks the total surface area of the tree. The
+     * nodes live in a single contiguous pool and are recycled through
+     * a free list, so a tree that has reached its working size makes
+     * no further allocations.
+     *
+     * Bodies are referred to by the proxy index returned from insert.
+     */
+    class DynamicAABBTree : public Broadphase
+    {
+    public:
+        /** Marks the absence of a node. */
+        static const unsigned NULL_NODE = 0xffffffff;
+
+    protected:
+        /**
+         * Holds a single node of the tree. Leaves have no children.
+         * Free nodes have a height of -1 and use parent as the link
+         * to the next free node.
+         */
+        struct Node
+        {
+            BoundingBox box;
+            RigidBody *body;
+            unsigned parent;
+            unsigned children[2];
+            int height;
+
+            bool isLeaf() const
+            {
+                return children[0] == NULL_NODE;
+            }
+        };
+
+        /** Holds the node pool. */
+        std::vector<Node> nodes;
+
+        /** Holds the root node, or NULL_NODE for an empty tree. */
+        unsigned root;
+
+        /** Holds the first free node in the pool. */
+        unsigned freeList;
+
+        /** Holds the number of bodies in the tree. */
+        unsigned proxyCount;
+
+        /** Holds how much each leaf box is fattened by. */
+        real margin;
+
+        /** Holds the nodes still to visit in a query. */
+        mutable std::vector<unsigned> stack;
+
+        /** Holds a candidate sibling still to visit when inserting. */
+        struct SearchEntry
+        {
+            unsigned node;
+            real inherited;
+
+            SearchEntry(unsigned node, real inherited)
+                : node(node), inherited(inherited)
+            {
+            }
+        };
+
+        /** Holds the candidates still to visit when inserting. */
+        std::vector<SearchEntry> searchStack;
+
+    public:
+        /**
+         * Creates an empty tree whose leaf boxes are fattened by the
+         * given margin on every side.
+         */
+        DynamicAABBTree(real margin = (real)0.1)
+            : root(NULL_NODE), freeList(NULL_NODE), proxyCount(0),
+              margin(margin)
+        {
+        }
+
+        /**
+         * Inserts the given body with the given tight bounding box,
+         * and returns its proxy.
+         */
+        virtual unsigned insert(RigidBody *body, const BoundingBox &box)
+        {
+            unsigned proxy = allocateNode();
+            nodes[proxy].box = fatten(box);
+            nodes[proxy].body = body;
+            nodes[proxy].height = 0;
+            insertLeaf(proxy);
+            proxyCount++;
+            return proxy;
+        }
+
+        /**
+         * Removes the given proxy from the tree.
+         */
+        virtual void remove(unsigned proxy)
+        {
+            removeLeaf(proxy);
+            freeNode(proxy);
+            proxyCount--;
+        }
+
+        /**
+         * Tells the tree that the given proxy now has the given tight
+         * bounding box. If the box is still inside the fat box of the
+         * leaf nothing happens; otherwise the leaf is reinserted.
+         * Returns true if the leaf was reinserted.
+         *
+         * The displacement is how far the body is expected to move
+         * before the next update (its velocity times the step). The
+         * new fat box is stretched by twice this in the direction of
+         * motion, so steadily moving bodies are reinserted less often.
+         */
+        virtual bool update(unsigned proxy, const BoundingBox &box,
+                            const Vector3 &displacement = Vector3())
+        {
+            if (nodes[proxy].box.contains(box)) return false;
+
+            removeLeaf(proxy);
+
+            BoundingBox fat = fatten(box);
+            for (unsigned i = 0; i < 3; i++)
+            {
+                real d = displacement[i] * ((real)2.0);
+                if (d < 0) fat.min[i] += d;
+                else fat.max[i] += d;
+            }
+            nodes[proxy].box = fat;
+
+            insertLeaf(proxy);
+            return true;
+        }
+
+        /**
+         * Returns the body held by the given proxy.
+         */
+        RigidBody* getBody(unsigned proxy) const
+        {
+            return nodes[proxy].body;
+        }
+
+        /**
+         * Returns the fat box held for the given proxy.
+         */
+        const BoundingBox& getFatBox(unsigned proxy) const
+        {
+            return nodes[proxy].box;
+        }
+
+        /**
+         * Returns the number of bodies in the tree.
+         */
+        unsigned getProxyCount() const
+        {
+            return proxyCount;
+        }
+
+        /**
+         * Returns the height of the tree, or zero for an empty tree.
+         */
+        unsigned getHeight() const
+        {
+            return root == NULL_NODE ? 0 : (unsigned)nodes[root].height;
+        }
+
+        /**
+         * Writes every pair of bodies whose fat boxes overlap to the
+         * given array (up to the given limit), and returns the number
+         * of pairs written. Each pair is reported once, and the order
+         * only depends on the shape of the tree.
+         */
+        virtual unsigned getPotentialContacts(PotentialContact* contacts,
+                                              unsigned limit)
+        {
+            if (root == NULL_NODE || limit == 0) return 0;
+
+            // Each entry is a pair of nodes to test against each
+            // other. A node paired with itself means the pairs inside
+            // that subtree.
+            unsigned count = 0;
+            stack.clear();
+            stack.push_back(root);
+            stack.push_back(root);
+
+            while (!stack.empty())
+            {
+                unsigned b = stack.back(); stack.pop_back();
+                unsigned a = stack.back(); stack.pop_back();
+                const Node &nodeA = nodes[a];
+                const Node &nodeB = nodes[b];
+
+                if (a == b)
+                {
+                    if (nodeA.isLeaf()) continue;
+                    pushPair(nodeA.children[0], nodeA.children[1]);
+                    pushPair(nodeA.children[1], nodeA.children[1]);
+                    pushPair(nodeA.children[0], nodeA.children[0]);
+                    continue;
+                }
+
+                if (!nodeA.box.overlaps(&nodeB.box)) continue;
+
+                if (nodeA.isLeaf() && nodeB.isLeaf())
+                {
+                    contacts->body[0] = nodeA.body;
+                    contacts->body[1] = nodeB.body;
+                    contacts++;
+                    if (++count == limit) break;
+                    continue;
+                }
+
+                // Descend into the larger of the two nodes.
+                if (nodeB.isLeaf() || (!nodeA.isLeaf() &&
+                    nodeA.box.getSurfaceArea() >= nodeB.box.getSurfaceArea()))
+                {
+                    pushPair(nodeA.children[1], b);
+                    pushPair(nodeA.children[0], b);
+                }
+                else
+                {
+                    pushPair(a, nodeB.children[1]);
+                    pushPair(a, nodeB.children[0]);
+                }
+            }
+            return count;
+        }
+
+    protected:
+        void pushPair(unsigned a, unsigned b) const
+        {
+            stack.push_back(a);
+            stack.push_back(b);
+        }
+
+        BoundingBox fatten(const BoundingBox &box) const
+        {
+            Vector3 extra(margin, margin, margin);
+            return BoundingBox(box.min - extra, box.max + extra);
+        }
+
+        unsigned allocateNode()
+        {
+            unsigned index;
+            if (freeList != NULL_NODE)
+            {
+                index = freeList;
+                freeList = nodes[index].parent;
+            }
+            else
+            {
+                index = (unsigned)nodes.size();
+                nodes.push_back(Node());
+            }
+
+            Node &node = nodes[index];
+            node.body = NULL;
+            node.parent = NULL_NODE;
+            node.children[0] = node.children[1] = NULL_NODE;
+            node.height = 0;
+            return index;
+        }
+
+        void freeNode(unsigned index)
+        {
+            nodes[index].parent = freeList;
+            nodes[index].height = -1;
+            freeList = index;
+        }
+
+        /**
+         * Recalculates the box and height of a branch from its
+         * children.
+         */
+        void refit(unsigned index)
+        {
+            Node &node = nodes[index];
+            const Node &one = nodes[node.children[0]];
+            const Node &two = nodes[node.children[1]];
+            node.box = BoundingBox(one.box, two.box);
+            node.height = 1 + (one.height > two.height ? one.height : two.height);
+        }
+
+        void insertLeaf(unsigned leaf)
+        {
+            if (root == NULL_NODE)
+            {
+                root = leaf;
+                nodes[leaf].parent = NULL_NODE;
+                return;
+            }
+
+            // Find the sibling with the lowest surface area cost by
+            // branch and bound. Pairing the leaf with a node costs the
+            // area of their union, plus the growth of every ancestor.
+            const BoundingBox leafBox = nodes[leaf].box;
+            const real leafArea = leafBox.getSurfaceArea();
+            unsigned best = root;
+            real bestCost = BoundingBox(nodes[root].box, leafBox).getSurfaceArea();
+
+            // Entries are (node, cost inherited from its ancestors).
+            searchStack.clear();
+            searchStack.push_back(SearchEntry(root, 0));
+            while (!searchStack.empty())
+            {
+                SearchEntry entry = searchStack.back();
+                searchStack.pop_back();
+
+                const Node &node = nodes[entry.node];
+                real combinedArea = BoundingBox(node.box, leafBox).getSurfaceArea();
+                real cost = combinedArea + entry.inherited;
+                if (cost < bestCost)
+                {
+                    best = entry.node;
+                    bestCost = cost;
+                }
+
+                // The children can't do better than this bound.
+                if (node.isLeaf()) continue;
+                real inherited = entry.inherited + combinedArea -
+                    node.box.getSurfaceArea();
+                if (leafArea + inherited < bestCost)
+                {
+                    // Visit the child nearer the leaf first, so the
+                    // bound tightens early.
+                    unsigned near = node.children[0], far = node.children[1];
+                    if (nodes[far].box.getGrowth(leafBox) < nodes[near].box.getGrowth(leafBox))
+                    {
+                        near = node.children[1];
+                        far = node.children[0];
+                    }
+                    searchStack.push_back(SearchEntry(far, inherited));
+                    searchStack.push_back(SearchEntry(near, inherited));
+                }
+            }
+            unsigned index = best;
+
+            // Make a new parent for the sibling and the leaf.
+            unsigned sibling = index;
+            unsigned oldParent = nodes[sibling].parent;
+            unsigned newParent = allocateNode();
+            nodes[newParent].parent = oldParent;
+            nodes[newParent].children[0] = sibling;
+            nodes[newParent].children[1] = leaf;
+            nodes[sibling].parent = newParent;
+            nodes[leaf].parent = newParent;
+
+            if (oldParent != NULL_NODE)
+            {
+                Node &parent = nodes[oldParent];
+                parent.children[parent.children[0] == sibling ? 0 : 1] = newParent;
+            }
+            else
+            {
+                root = newParent;
+            }
+
+            // Walk back up, refitting and rotating.
+            index = newParent;
+            while (index != NULL_NODE)
+            {
+                refit(index);
+                rotate(index);
+                index = nodes[index].parent;
+            }
+        }
+
+        void removeLeaf(unsigned leaf)
+        {
+            if (leaf == root)
+            {
+                root = NULL_NODE;
+                return;
+            }
+
+            // The sibling takes the place of the parent.
+            unsigned parent = nodes[leaf].parent;
+            unsigned grandParent = nodes[parent].parent;
+            unsigned sibling = nodes[parent].children[
+                nodes[parent].children[0] == leaf ? 1 : 0];
+
+            if (grandParent != NULL_NODE)
+            {
+                Node &node = nodes[grandParent];
+                node.children[node.children[0] == parent ? 0 : 1] = sibling;
+                nodes[sibling].parent = grandParent;
+                freeNode(parent);
+
+                unsigned index = grandParent;
+                while (index != NULL_NODE)
+                {
+                    refit(index);
+                    rotate(index);
+                    index = nodes[index].parent;
+                }
+            }
+            else
+            {
+                root = sibling;
+                nodes[sibling].parent = NULL_NODE;
+                freeNode(parent);
+            }
+        }
+
+        /**
+         * Looks for a swap of a child of the given node with one of
+         * its grandchildren that shrinks the surface area of the
+         * tree, and makes the best one. The node's own box is not
+         * changed by a swap, so the rotation only affects this
+         * subtree.
+         */
+        void rotate(unsigned a)
+        {
+            Node &node = nodes[a];
+            if (node.isLeaf()) return;
+
+            // For each child that is a branch, try swapping each of
+            // its children with the other child of this node. The
+            // gain is the area the branch loses.
+            unsigned bestChild = NULL_NODE, bestGrandchild = NULL_NODE;
+            real bestGain = 0;
+            for (unsigned side = 0; side < 2; side++)
+            {
+                const Node &branch = nodes[node.children[side]];
+                if (branch.isLeaf()) continue;
+
+                const Node &other = nodes[node.children[1 - side]];
+                real area = branch.box.getSurfaceArea();
+                for (unsigned g = 0; g < 2; g++)
+                {
+                    // The grandchild that stays behind joins the other child.
+                    const Node &stays = nodes[branch.children[1 - g]];
+                    real gain = area - BoundingBox(stays.box, other.box).getSurfaceArea();
+                    if (gain > bestGain)
+                    {
+                        bestGain = gain;
+                        bestChild = side;
+                        bestGrandchild = g;
+                    }
+                }
+            }
+            if (bestChild == NULL_NODE) return;
+
+            // Swap the other child with the chosen grandchild.
+            unsigned branch = node.children[bestChild];
+            unsigned other = node.children[1 - bestChild];
+            unsigned grandchild = nodes[branch].children[bestGrandchild];
+
+            node.children[1 - bestChild] = grandchild;
+            nodes[grandchild].parent = a;
+            nodes[branch].children[bestGrandchild] = other;
+            nodes[other].parent = branch;
+
+            refit(branch);
+            refit(a);
+        }
+    };
+
+    /**
+     * A sweep and prune broadphase.
+     *
+     * The minimum and maximum of every box are kept as endpoints in
+     * one sorted array per axis, and the set of overlapping pairs is
+     * kept from query to query. Each query refreshes the endpoint
+     * values and restores the order of each array with an insertion
+     * sort. Every swap of a minimum with a maximum means two boxes
+     * started or stopped overlapping along that axis, so only those
+     * pairs are tested and added to or removed from the set. When the
+     * bodies have only moved a little the arrays are nearly sorted
+     * and the cost is close to linear in the number of bodies.
+     *
+     * This suits scenes where most bodies are still or only jitter.
+     * Large batches of new bodies are sorted with a full sort and the
+     * pair set is rebuilt from scratch instead. Removals are held
+     * until the next query, which drops their endpoints and pairs in
+     * one pass.
+     */
+    class SweepAndPrune : public Broadphase
+    {
+    protected:
+        /**
+         * Holds one end of a box along one axis. The low bit of data
+         * is set for a maximum, and the rest is the proxy.
+         */
+        struct Endpoint
+        {
+            real value;
+            unsigned data;
+
+            unsigned getProxy() const { return data >> 1; }
+            bool isMax() const { return (data & 1) != 0; }
+
+            bool operator<(const Endpoint &other) const
+            {
+                // Minimums go first on ties, so touching boxes overlap.
+                if (value != other.value) return value < other.value;
+                return (data & 1) < (other.data & 1);
+            }
+        };
+
+        /** Holds the box of each proxy. */
+        std::vector<BoundingBox> boxes;
+
+        /** Holds the body of each proxy, or NULL for a removed proxy. */
+        std::vector<RigidBody*> bodies;
+
+        /** Holds the proxies that can be reused. */
+        std::vector<unsigned> freeProxies;
+
+        /** Holds the proxies removed since the last query. */
+        std::vector<unsigned> removedProxies;
+
+        /** Holds the sorted endpoints along each axis. */
+        std::vector<Endpoint> endpoints[3];
+
+        /** Holds the overlapping pairs, as (lower proxy, higher proxy). */
+        std::vector<unsigned long long> pairs;
+
+        /** Maps each pair to its position in pairs. */
+        std::unordered_map<unsigned long long, unsigned> pairIndex;
+
+        /** Holds the number of proxies added since the last query. */
+        unsigned unsorted;
+
+        /** Holds the number of swaps made by the last query. */
+        unsigned lastSwaps;
+
+    public:
+        SweepAndPrune()
+            : unsorted(0), lastSwaps(0)
+        {
+        }
+
+        virtual unsigned insert(RigidBody *body, const BoundingBox &box)
+        {
+            unsigned proxy;
+            if (!freeProxies.empty())
+            {
+                proxy = freeProxies.back();
+                freeProxies.pop_back();
+                boxes[proxy] = box;
+                bodies[proxy] = body;
+            }
+            else
+            {
+                proxy = (unsigned)boxes.size();
+                boxes.push_back(box);
+                bodies.push_back(body);
+            }
+
+            // The endpoints are placed at the end, and move into
+            // place at the next query.
+            for (unsigned axis = 0; axis < 3; axis++)
+            {
+                Endpoint endpoint;
+                endpoint.value = box.min[axis];
+                endpoint.data = proxy << 1;
+                endpoints[axis].push_back(endpoint);
+                endpoint.value = box.max[axis];
+                endpoint.data = (proxy << 1) | 1;
+                endpoints[axis].push_back(endpoint);
+            }
+            unsorted++;
+            return proxy;
+        }
+
+        virtual void remove(unsigned proxy)
+        {
+            // The endpoints and pairs are dropped at the next query.
+            // The proxy can only be reused after that.
+            bodies[proxy] = NULL;
+            removedProxies.push_back(proxy);
+        }
+
+        virtual bool update(unsigned proxy, const BoundingBox &box,
+                            const Vector3 & = Vector3())
+        {
+            boxes[proxy] = box;
+            return true;
+        }
+
+        /**
+         * Returns the number of endpoint swaps made by the last
+         * query. This measures how much the order changed.
+         */
+        unsigned getLastSwaps() const
+        {
+            return lastSwaps;
+        }
+
+        virtual unsigned getPotentialContacts(PotentialContact* contacts,
+                                              unsigned limit)
+        {
+            if (!removedProxies.empty()) dropRemoved();
+
+            const unsigned size = (unsigned)endpoints[0].size();
+            if (unsorted > 16 && unsorted * 16 > size) rebuild();
+            else sort();
+            unsorted = 0;
+
+            unsigned count = 0;
+            for (unsigned i = 0; i < pairs.size() && count < limit; i++)
+            {
+                contacts->body[0] = bodies[(unsigned)(pairs[i] >> 32)];
+                contacts->body[1] = bodies[(unsigned)pairs[i]];
+                contacts++;
+                count++;
+            }
+            return count;
+        }
+
+    protected:
+        static unsigned long long pairKey(unsigned a, unsigned b)
+        {
+            if (a > b) std::swap(a, b);
+            return ((unsigned long long)a << 32) | b;
+        }
+
+        void addPair(unsigned a, unsigned b)
+        {
+            if (!bodies[a] || !bodies[b]) return;
+            if (!boxes[a].overlaps(&boxes[b])) return;
+
+            unsigned long long key = pairKey(a, b);
+            if (pairIndex.find(key) != pairIndex.end()) return;
+            pairIndex[key] = (unsigned)pairs.size();
+            pairs.push_back(key);
+        }
+
+        void removePair(unsigned a, unsigned b)
+        {
+            std::unordered_map<unsigned long long, unsigned>::iterator found =
+                pairIndex.find(pairKey(a, b));
+            if (found == pairIndex.end()) return;
+
+            // Move the last pair into the gap.
+            unsigned index = found->second;
+            pairIndex.erase(found);
+            if (index + 1 != pairs.size())
+            {
+                pairs[index] = pairs.back();
+                pairIndex[pairs[index]] = index;
+            }
+            pairs.pop_back();
+        }
+
+        /**
+         * Takes the endpoints and pairs of every proxy removed since
+         * the last query out in one pass over each array, keeping
+         * the order of the rest, and frees the proxies for reuse.
+         */
+        void dropRemoved()
+        {
+            for (unsigned axis = 0; axis < 3; axis++)
+            {
+                std::vector<Endpoint> &list = endpoints[axis];
+                unsigned kept = 0;
+                for (unsigned i = 0; i < list.size(); i++)
+                {
+                    if (bodies[list[i].getProxy()]) list[kept++] = list[i];
+                }
+                list.resize(kept);
+            }
+
+            unsigned kept = 0;
+            for (unsigned i = 0; i < pairs.size(); i++)
+            {
+                unsigned long long key = pairs[i];
+                if (!bodies[(unsigned)(key >> 32)] || !bodies[(unsigned)key])
+                {
+                    pairIndex.erase(key);
+                    continue;
+                }
+                if (kept != i)
+                {
+                    pairs[kept] = key;
+                    pairIndex[key] = kept;
+                }
+                kept++;
+            }
+            pairs.resize(kept);
+
+            freeProxies.insert(freeProxies.end(),
+                removedProxies.begin(), removedProxies.end());
+            removedProxies.clear();
+        }
+
+        /**
+         * Refreshes the endpoint values and restores the order of each
+         * axis, updating the pair set as minimums and maximums pass
+         * each other.
+         */
+        void sort()
+        {
+            lastSwaps = 0;
+            for (unsigned axis = 0; axis < 3; axis++)
+            {
+                std::vector<Endpoint> &list = endpoints[axis];
+                const unsigned size = (unsigned)list.size();
+                for (unsigned i = 0; i < size; i++)
+                {
+                    const BoundingBox &box = boxes[list[i].getProxy()];
+                    list[i].value = list[i].isMax() ? box.max[axis] : box.min[axis];
+                }
+
+                for (unsigned i = 1; i < size; i++)
+                {
+                    Endpoint endpoint = list[i];
+                    unsigned j = i;
+                    while (j > 0 && endpoint < list[j - 1])
+                    {
+                        const Endpoint &passed = list[j - 1];
+                        if (endpoint.isMax() != passed.isMax())
+                        {
+                            // A minimum passing a maximum downwards
+                            // starts an overlap, a maximum passing a
+                            // minimum downwards ends one.
+                            if (endpoint.isMax())
+                            {
+                                removePair(endpoint.getProxy(), passed.getProxy());
+                            }
+                            else
+                            {
+                                addPair(endpoint.getProxy(), passed.getProxy());
+                            }
+                        }
+                        list[j] = passed;
+                        j--;
+                    }
+                    list[j] = endpoint;
+                    lastSwaps += i - j;
+                }
+            }
+        }
+
+        /**
+         * Sorts every axis from scratch and rebuilds the pair set by
+         * sweeping along the first axis.
+         */
+        void rebuild()
+        {
+            lastSwaps = 0;
+            for (unsigned axis = 0; axis < 3; axis++)
+            {
+                std::vector<Endpoint> &list = endpoints[axis];
+                for (unsigned i = 0; i < list.size(); i++)
+                {
+                    const BoundingBox &box = boxes[list[i].getProxy()];
+                    list[i].value = list[i].isMax() ? box.max[axis] : box.min[axis];
+                }
+                std::sort(list.begin(), list.end());
+            }
+
+            // Every box that starts while another is open overlaps it
+            // along the first axis; test the rest of the box.
+            pairs.clear();
+            pairIndex.clear();
+            std::vector<unsigned> open;
+            const std::vector<Endpoint> &list = endpoints[0];
+            for (unsigned i = 0; i < list.size(); i++)
+            {
+                unsigned proxy = list[i].getProxy();
+                if (list[i].isMax())
+                {
+                    open.erase(std::find(open.begin(), open.end(), proxy));
+                    continue;
+                }
+                for (unsigned k = 0; k < open.size(); k++) addPair(proxy, open[k]);
+                open.push_back(proxy);
+            }
+        }
+    };
+
 } // namespace cyclone
 
 #endif // CYCLONE_COLLISION_FINE_H
\ No newline at end of file
@@ -179,9 +179,23 @@ namespace cyclone {
     /**
      * A helper structure that contains information for the detector to use
      * in building its contact data.
+     *
+     * The contacts can be written either into a fixed array, set up
+     * by filling in contactArray and calling reset, or into a
+     * ContactArena given to useArena. With an arena there is no limit
+     * on the number of contacts: reset and addContacts grow the arena
+     * so that at least MAX_CONTACTS_PER_TEST contacts are always free
+     * at contacts, and contactsLeft is kept up to date, so detectors
+     * that only check contactsLeft can't write past the end.
      */
     struct CollisionData
     {
+        /**
+         * The most contacts any single detector call writes. The arena
+         * always keeps this much room free ahead of the next detector.
+         */
+        enum { MAX_CONTACTS_PER_TEST = 8 };
+
         /**
          * Holds the base of the collision data: the first contact
          * in the array. This is used so that the contact pointer (below)
@@ -211,23 +225,56 @@ namespace cyclone {
          */
         real tolerance;
 
+        /**
+         * Holds the arena the contacts are written into, or NULL if
+         * the fixed contactArray is used.
+         */
+        ContactArena *arena;
+
+        CollisionData()
+            : contactArray(0), contacts(0), contactsLeft(0), contactCount(0),
+              friction(0), restitution(0), tolerance(0), arena(0)
+        {
+        }
+
+        /**
+         * Writes contacts into the given arena from now on, and
+         * starts a new frame in it.
+         */
+        void useArena(ContactArena *contactArena)
+        {
+            arena = contactArena;
+            reset(0);
+        }
+
         /**
          * Checks if there are more contacts available in the contact
-         * data.
+         * data. With an arena this always succeeds.
          */
         bool hasMoreContacts()
         {
+            if (arena) return true;
             return contactsLeft > 0;
         }
 
         /**
          * Resets the data so that it has no used contacts recorded.
+         * With an arena this starts a new frame in the arena and
+         * maxContacts is ignored.
          */
         void reset(unsigned maxContacts)
         {
-            contactsLeft = maxContacts;
             contactCount = 0;
-            contacts = contactArray;
+            if (arena)
+            {
+                arena->reset();
+                reserveArena();
+            }
+            else
+            {
+                contactsLeft = maxContacts;
+                contacts = contactArray;
+            }
         }
 
         /**
@@ -242,6 +289,24 @@ namespace cyclone {
 
             // Move the array forward
             contacts += count;
+
+            if (arena)
+            {
+                arena->commit(count);
+                reserveArena();
+            }
+        }
+
+        /**
+         * Makes sure the arena has room for the next detector call,
+         * and points contacts, contactArray and contactsLeft at it.
+         */
+        void reserveArena()
+        {
+            // Growing may move the contacts, so rebase the pointers.
+            contacts = arena->reserve(MAX_CONTACTS_PER_TEST);
+            contactArray = arena->data();
+            contactsLeft = (int)(arena->capacity() - contactCount);
         }
     };
 
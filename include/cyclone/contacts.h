@@ -26,7 +26,12 @@
 #ifndef CYCLONE_CONTACTS_H
 #define CYCLONE_CONTACTS_H
 
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
 #include "body.h"
+#include "jobs.h"
 
 namespace cyclone {
 
@@ -318,6 +323,67 @@ namespace cyclone {
          */
         bool validSettings;
 
+    protected:
+        /**
+         * Holds the scratch space used by resolveContactIslands. It
+         * initialises itself. A copy of a resolver starts with empty
+         * scratch space, so each island can be solved by a cheap
+         * copy of the resolver.
+         */
+        struct IslandState
+        {
+            /** The pool islands are solved on, or NULL. */
+            JobPool *jobPool;
+
+            /** Maps each movable body to a contact that touches it. */
+            std::unordered_map<const RigidBody*, unsigned> bodyContact;
+
+            /** Holds the union-find parent of each contact. */
+            std::vector<unsigned> parent;
+
+            /** Holds the island of each contact. */
+            std::vector<unsigned> islandOf;
+
+            /**
+             * The contacts of island i are sorted[islandStart[i]] up
+             * to sorted[islandStart[i+1]].
+             */
+            std::vector<unsigned> islandStart;
+
+            /** True for islands that have an awake body. */
+            std::vector<unsigned char> islandAwake;
+
+            /** The awake islands, largest first. */
+            std::vector<unsigned> islandOrder;
+
+            /** The contacts sorted by island. */
+            std::vector<Contact> sorted;
+
+            /**
+             * The immovable body taken out of each sorted contact, and
+             * whether the contact was reversed to do so.
+             */
+            std::vector<RigidBody*> detachedBody;
+            std::vector<unsigned char> detachedSwapped;
+
+            /** The iterations used for each island. */
+            std::vector<unsigned> velocityUsed;
+            std::vector<unsigned> positionUsed;
+
+            IslandState() : jobPool(0) {}
+            IslandState(const IslandState &other) : jobPool(other.jobPool) {}
+            IslandState& operator=(const IslandState &other)
+            {
+                jobPool = other.jobPool;
+                return *this;
+            }
+        };
+
+        /**
+         * Holds the island scratch space for this resolver.
+         */
+        IslandState islands;
+
     public:
         /**
          * Creates a new contact resolver with the given number of iterations
@@ -394,6 +460,264 @@ namespace cyclone {
             unsigned numContacts,
             real duration);
 
+        /**
+         * Sets the pool that resolveContactIslands solves islands on.
+         * NULL solves them one after another on the calling thread.
+         * The resolver doesn't own the pool.
+         */
+        void setJobPool(JobPool *pool)
+        {
+            islands.jobPool = pool;
+        }
+
+        /**
+         * Returns the pool islands are solved on, or NULL.
+         */
+        JobPool* getJobPool() const
+        {
+            return islands.jobPool;
+        }
+
+        /**
+         * Resolves a set of contacts by splitting them into islands
+         * and passing each island to a separate call to
+         * resolveContacts, on the job pool if one is set.
+         *
+         * Two contacts are in the same island if they share a body
+         * that can move. Bodies that can't move (no inverse mass or
+         * inverse inertia, and no velocity) don't join islands, so a
+         * ground body under several stacks leaves each stack its own
+         * island. They are taken out of the contacts while solving,
+         * which gives the same result as leaving them in.
+         *
+         * Islands sleep and wake as a whole: if any body in an island
+         * is awake the whole island is woken first, as
+         * Contact::matchAwakeState would do one contact at a time,
+         * and islands with no awake body are not solved at all.
+         *
+         * Each island is solved the same way whichever thread picks
+         * it up, so the result doesn't depend on the number of
+         * threads. On return the contacts are sorted by island.
+         */
+        void resolveContactIslands(Contact *contactArray,
+            unsigned numContacts,
+            real duration)
+        {
+            if (numContacts == 0) return;
+            if (!isValid()) return;
+
+            IslandState &state = islands;
+            buildIslands(contactArray, numContacts);
+            const unsigned islandCount = (unsigned)state.islandAwake.size();
+
+            // Wake every island that has an awake body. This moves
+            // bodies in their stores, so it must happen before any
+            // island is solved.
+            for (unsigned c = 0; c < numContacts; c++)
+            {
+                if (!state.islandAwake[state.islandOf[c]]) continue;
+                for (unsigned b = 0; b < 2; b++)
+                {
+                    RigidBody *body = contactArray[c].body[b];
+                    if (body && !isImmovable(body) && !body->getAwake())
+                    {
+                        body->setAwake();
+                    }
+                }
+            }
+
+            // Sort the contacts by island, keeping their order, and
+            // take out the immovable bodies.
+            state.sorted.assign(contactArray, contactArray + numContacts);
+            std::vector<unsigned> next(state.islandStart.begin(),
+                                       state.islandStart.end() - 1);
+            for (unsigned c = 0; c < numContacts; c++)
+            {
+                state.sorted[next[state.islandOf[c]]++] = contactArray[c];
+            }
+            state.detachedBody.assign(numContacts, (RigidBody*)0);
+            state.detachedSwapped.assign(numContacts, 0);
+            for (unsigned c = 0; c < numContacts; c++)
+            {
+                Contact &contact = state.sorted[c];
+                if (contact.body[0] && contact.body[1] &&
+                    isImmovable(contact.body[0]) && !isImmovable(contact.body[1]))
+                {
+                    contact.swapBodies();
+                    state.detachedSwapped[c] = 1;
+                }
+                if (contact.body[1] && isImmovable(contact.body[1]))
+                {
+                    state.detachedBody[c] = contact.body[1];
+                    contact.body[1] = 0;
+                }
+            }
+
+            // Solve the largest islands first, so the last ones to
+            // finish are small.
+            state.islandOrder.clear();
+            for (unsigned i = 0; i < islandCount; i++)
+            {
+                if (state.islandAwake[i]) state.islandOrder.push_back(i);
+            }
+            std::stable_sort(state.islandOrder.begin(), state.islandOrder.end(),
+                IslandSizeOrder(state.islandStart));
+
+            state.velocityUsed.assign(islandCount, 0);
+            state.positionUsed.assign(islandCount, 0);
+            JobPool::Job job = [this, &state, duration](unsigned k, unsigned)
+            {
+                unsigned island = state.islandOrder[k];
+                unsigned start = state.islandStart[island];
+                ContactResolver local(*this);
+                local.resolveContacts(&state.sorted[start],
+                    state.islandStart[island + 1] - start, duration);
+                state.velocityUsed[island] = local.velocityIterationsUsed;
+                state.positionUsed[island] = local.positionIterationsUsed;
+            };
+            const unsigned awakeIslands = (unsigned)state.islandOrder.size();
+            if (state.jobPool) state.jobPool->parallelFor(awakeIslands, job);
+            else for (unsigned k = 0; k < awakeIslands; k++) job(k, 0);
+
+            // Put the immovable bodies back and return the results.
+            for (unsigned c = 0; c < numContacts; c++)
+            {
+                Contact &contact = state.sorted[c];
+                if (state.detachedBody[c]) contact.body[1] = state.detachedBody[c];
+                if (state.detachedSwapped[c]) contact.swapBodies();
+                contactArray[c] = contact;
+            }
+
+            velocityIterationsUsed = 0;
+            positionIterationsUsed = 0;
+            for (unsigned i = 0; i < islandCount; i++)
+            {
+                velocityIterationsUsed = (std::max)(velocityIterationsUsed, state.velocityUsed[i]);
+                positionIterationsUsed = (std::max)(positionIterationsUsed, state.positionUsed[i]);
+            }
+        }
+
+    protected:
+        /**
+         * Orders islands by their number of contacts, largest first.
+         */
+        struct IslandSizeOrder
+        {
+            const std::vector<unsigned> &islandStart;
+
+            IslandSizeOrder(const std::vector<unsigned> &islandStart)
+                : islandStart(islandStart)
+            {
+            }
+
+            bool operator()(unsigned a, unsigned b) const
+            {
+                return islandStart[a + 1] - islandStart[a] >
+                    islandStart[b + 1] - islandStart[b];
+            }
+        };
+
+        /**
+         * Returns true if the body can't be moved by a contact and
+         * isn't moving, so contacts can share it without joining
+         * their islands.
+         */
+        static bool isImmovable(const RigidBody *body)
+        {
+            if (body->getInverseMass() != 0) return false;
+            if (body->getVelocity().squareMagnitude() != 0) return false;
+            if (body->getRotation().squareMagnitude() != 0) return false;
+            if (body->getLastFrameAcceleration().squareMagnitude() != 0) return false;
+
+            Matrix3 inverseInertiaTensor;
+            body->getInverseInertiaTensorWorld(&inverseInertiaTensor);
+            for (unsigned i = 0; i < 9; i++)
+            {
+                if (inverseInertiaTensor.data[i] != 0) return false;
+            }
+            return true;
+        }
+
+        /**
+         * Returns the island root of the given contact, halving the
+         * path as it goes.
+         */
+        unsigned findIslandRoot(unsigned contact)
+        {
+            std::vector<unsigned> &parent = islands.parent;
+            while (parent[contact] != contact)
+            {
+                parent[contact] = parent[parent[contact]];
+                contact = parent[contact];
+            }
+            return contact;
+        }
+
+        /**
+         * Splits the contacts into islands, filling islandOf,
+         * islandStart and islandAwake. Islands are numbered in the
+         * order their first contact appears.
+         */
+        void buildIslands(const Contact *contactArray, unsigned numContacts)
+        {
+            IslandState &state = islands;
+            state.parent.resize(numContacts);
+            for (unsigned c = 0; c < numContacts; c++) state.parent[c] = c;
+
+            // Join each contact with an earlier contact on the same body.
+            state.bodyContact.clear();
+            for (unsigned c = 0; c < numContacts; c++)
+            {
+                for (unsigned b = 0; b < 2; b++)
+                {
+                    const RigidBody *body = contactArray[c].body[b];
+                    if (!body || isImmovable(body)) continue;
+
+                    std::pair<std::unordered_map<const RigidBody*, unsigned>::iterator, bool>
+                        found = state.bodyContact.insert(std::make_pair(body, c));
+                    if (found.second) continue;
+
+                    unsigned a = findIslandRoot(c);
+                    unsigned o = findIslandRoot(found.first->second);
+                    if (a != o) state.parent[(std::max)(a, o)] = (std::min)(a, o);
+                }
+            }
+
+            // Number the islands, count their contacts and see which
+            // have an awake body. Roots always come before the rest
+            // of their island.
+            state.islandOf.resize(numContacts);
+            state.islandStart.assign(1, 0);
+            state.islandAwake.clear();
+            for (unsigned c = 0; c < numContacts; c++)
+            {
+                unsigned root = findIslandRoot(c);
+                unsigned island;
+                if (root == c)
+                {
+                    island = (unsigned)state.islandAwake.size();
+                    state.islandAwake.push_back(0);
+                    state.islandStart.push_back(0);
+                }
+                else island = state.islandOf[root];
+                state.islandOf[c] = island;
+                state.islandStart[island + 1]++;
+
+                for (unsigned b = 0; b < 2; b++)
+                {
+                    const RigidBody *body = contactArray[c].body[b];
+                    if (body && !isImmovable(body) && body->getAwake())
+                    {
+                        state.islandAwake[island] = 1;
+                    }
+                }
+            }
+            for (unsigned i = 1; i < state.islandStart.size(); i++)
+            {
+                state.islandStart[i] += state.islandStart[i - 1];
+            }
+        }
+
     protected:
         /**
          * Sets up contacts ready for processing. This makes sure their
@@ -438,6 +762,118 @@ namespace cyclone {
         virtual unsigned addContact(Contact *contact, unsigned limit) const = 0;
     };
 
+    /**
+     * A growable, frame-scoped buffer of contacts.
+     *
+     * The arena keeps its memory between frames: reset only rewinds
+     * it, so once it has grown to the largest frame seen there are no
+     * further heap allocations. The contacts are always contiguous,
+     * so the buffer can be handed straight to the contact resolver.
+     * Growing the arena moves the contacts, so pointers into it are
+     * only valid until the next call to reserve.
+     */
+    class ContactArena
+    {
+        /** Holds the contact storage. Its size is the capacity. */
+        std::vector<Contact> storage;
+
+        /** Holds the number of contacts used this frame. */
+        unsigned used;
+
+        /** Holds the number of contacts used by the previous frame. */
+        unsigned lastFrameCount;
+
+        /** Holds the most contacts used by any frame. */
+        unsigned highWater;
+
+        /** Holds the number of times the storage has been grown. */
+        unsigned growCount;
+
+    public:
+        /**
+         * Creates an arena with room for the given number of
+         * contacts.
+         */
+        ContactArena(unsigned capacity = 256)
+            : storage(capacity > 0 ? capacity : 1), used(0),
+              lastFrameCount(0), highWater(0), growCount(0)
+        {
+        }
+
+        /**
+         * Starts a new frame. The contacts of the previous frame are
+         * discarded, but the memory is kept.
+         */
+        void reset()
+        {
+            lastFrameCount = used;
+            used = 0;
+        }
+
+        /**
+         * Makes sure there is room for at least the given number of
+         * contacts after the ones already used, growing the storage
+         * if needed. Returns the first unused contact.
+         */
+        Contact* reserve(unsigned count)
+        {
+            if (used + count > storage.size())
+            {
+                size_t capacity = storage.size() * 2;
+                if (capacity < used + count) capacity = used + count;
+                storage.resize(capacity);
+                growCount++;
+            }
+            return &storage[0] + used;
+        }
+
+        /**
+         * Marks the given number of contacts after the ones already
+         * used as used.
+         */
+        void commit(unsigned count)
+        {
+            used += count;
+            if (used > highWater) highWater = used;
+        }
+
+        /** Returns the first contact of the frame. */
+        Contact* data()
+        {
+            return &storage[0];
+        }
+
+        /** Returns the number of contacts used this frame. */
+        unsigned size() const
+        {
+            return used;
+        }
+
+        /** Returns the number of contacts the arena can hold. */
+        unsigned capacity() const
+        {
+            return (unsigned)storage.size();
+        }
+
+        /** Returns the number of contacts used by the previous frame. */
+        unsigned getLastFrameCount() const
+        {
+            return lastFrameCount;
+        }
+
+        /** Returns the most contacts used by any frame. */
+        unsigned getHighWater() const
+        {
+            return highWater;
+        }
+
+        /** Returns the number of times the storage has been grown. */
+        unsigned getGrowCount() const
+        {
+            return growCount;
+        }
+    };
+
 } // namespace cyclone
 
 #endif // CYCLONE_CONTACTS_H
@@ -99,6 +99,24 @@
 
 #include "precision.h"
 
+/*
+ * The single precision build uses SSE or NEON for the matrix and
+ * quaternion kernels below when the target has them. Each kernel does
+ * the same multiplies and adds in the same order as the scalar code,
+ * so the results match it exactly as long as the compiler doesn't
+ * fuse the scalar multiplies and adds. Define CYCLONE_NO_SIMD to use
+ * the scalar code.
+ */
+#if defined(SINGLE_PRECISION) && !defined(CYCLONE_NO_SIMD)
+    #if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+        #define CYCLONE_SIMD_SSE
+        #include <xmmintrin.h>
+    #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+        #define CYCLONE_SIMD_NEON
+        #include <arm_neon.h>
+    #endif
+#endif
+
 /**
  * The cyclone namespace includes all cyclone functions and
  * classes. It is defined as a namespace to allow function and class
@@ -569,6 +587,37 @@ namespace cyclone {
          */
         void operator *=(const Quaternion &multiplier)
         {
+#if defined(CYCLONE_SIMD_SSE)
+            // Each lane is one component: ((a + b) + c) - d, with the
+            // signs of the scalar code folded into b and c.
+            const __m128 q = _mm_loadu_ps(data);
+            const __m128 m = _mm_loadu_ps(multiplier.data);
+            const __m128 negateR = _mm_set_ps(0.0f, 0.0f, 0.0f, -0.0f);
+            __m128 a = _mm_mul_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(0,0,0,0)), m);
+            __m128 b = _mm_mul_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(3,2,1,1)),
+                                  _mm_shuffle_ps(m, m, _MM_SHUFFLE(0,0,0,1)));
+            __m128 c = _mm_mul_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(1,3,2,2)),
+                                  _mm_shuffle_ps(m, m, _MM_SHUFFLE(2,1,3,2)));
+            __m128 d = _mm_mul_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(2,1,3,3)),
+                                  _mm_shuffle_ps(m, m, _MM_SHUFFLE(1,3,2,3)));
+            __m128 sum = _mm_add_ps(a, _mm_xor_ps(b, negateR));
+            sum = _mm_add_ps(sum, _mm_xor_ps(c, negateR));
+            _mm_storeu_ps(data, _mm_sub_ps(sum, d));
+#elif defined(CYCLONE_SIMD_NEON)
+            // NEON has no general shuffle, so the lanes are gathered
+            // through memory.
+            const real *m = multiplier.data;
+            const real bq[4] = { -data[1], data[1], data[2], data[3] };
+            const real bm[4] = { m[1], m[0], m[0], m[0] };
+            const real cq[4] = { -data[2], data[2], data[3], data[1] };
+            const real cm[4] = { m[2], m[3], m[1], m[2] };
+            const real dq[4] = { data[3], data[3], data[1], data[2] };
+            const real dm[4] = { m[3], m[2], m[3], m[1] };
+            float32x4_t sum = vaddq_f32(vmulq_n_f32(vld1q_f32(m), data[0]),
+                                        vmulq_f32(vld1q_f32(bq), vld1q_f32(bm)));
+            sum = vaddq_f32(sum, vmulq_f32(vld1q_f32(cq), vld1q_f32(cm)));
+            vst1q_f32(data, vsubq_f32(sum, vmulq_f32(vld1q_f32(dq), vld1q_f32(dm))));
+#else
             Quaternion q = *this;
             r = q.r*multiplier.r - q.i*multiplier.i -
                 q.j*multiplier.j - q.k*multiplier.k;
@@ -578,6 +627,7 @@ namespace cyclone {
                 q.k*multiplier.i - q.i*multiplier.k;
             k = q.r*multiplier.k + q.k*multiplier.r +
                 q.i*multiplier.j - q.j*multiplier.i;
+#endif
         }
 
         /**
@@ -652,6 +702,34 @@ namespace cyclone {
         Matrix4 operator*(const Matrix4 &o) const
         {
             Matrix4 result;
+#if defined(CYCLONE_SIMD_SSE)
+            // Each row of the result is a combination of the rows of o.
+            const __m128 row0 = _mm_loadu_ps(o.data);
+            const __m128 row1 = _mm_loadu_ps(o.data + 4);
+            const __m128 row2 = _mm_loadu_ps(o.data + 8);
+            for (unsigned r = 0; r < 12; r += 4)
+            {
+                __m128 sum = _mm_add_ps(_mm_mul_ps(row0, _mm_set1_ps(data[r])),
+                                        _mm_mul_ps(row1, _mm_set1_ps(data[r+1])));
+                sum = _mm_add_ps(sum, _mm_mul_ps(row2, _mm_set1_ps(data[r+2])));
+                sum = _mm_add_ps(sum, _mm_set_ps(data[r+3], 0.0f, 0.0f, 0.0f));
+                _mm_storeu_ps(result.data + r, sum);
+            }
+            return result;
+#elif defined(CYCLONE_SIMD_NEON)
+            const float32x4_t row0 = vld1q_f32(o.data);
+            const float32x4_t row1 = vld1q_f32(o.data + 4);
+            const float32x4_t row2 = vld1q_f32(o.data + 8);
+            for (unsigned r = 0; r < 12; r += 4)
+            {
+                const real translation[4] = { 0.0f, 0.0f, 0.0f, data[r+3] };
+                float32x4_t sum = vaddq_f32(vmulq_n_f32(row0, data[r]),
+                                            vmulq_n_f32(row1, data[r+1]));
+                sum = vaddq_f32(sum, vmulq_n_f32(row2, data[r+2]));
+                vst1q_f32(result.data + r, vaddq_f32(sum, vld1q_f32(translation)));
+            }
+            return result;
+#else
             result.data[0] = (o.data[0]*data[0]) + (o.data[4]*data[1]) + (o.data[8]*data[2]);
             result.data[4] = (o.data[0]*data[4]) + (o.data[4]*data[5]) + (o.data[8]*data[6]);
             result.data[8] = (o.data[0]*data[8]) + (o.data[4]*data[9]) + (o.data[8]*data[10]);
@@ -669,6 +747,7 @@ namespace cyclone {
             result.data[11] = (o.data[3]*data[8]) + (o.data[7]*data[9]) + (o.data[11]*data[10]) + data[11];
 
             return result;
+#endif
         }
 
         /**
@@ -774,6 +853,22 @@ namespace cyclone {
          */
         Vector3 transformInverseDirection(const Vector3 &vector) const
         {
+#if defined(CYCLONE_SIMD_SSE)
+            // The transpose is a combination of the rows.
+            __m128 sum = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(vector.x), _mm_loadu_ps(data)),
+                                    _mm_mul_ps(_mm_set1_ps(vector.y), _mm_loadu_ps(data + 4)));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(vector.z), _mm_loadu_ps(data + 8)));
+            real result[4];
+            _mm_storeu_ps(result, sum);
+            return Vector3(result[0], result[1], result[2]);
+#elif defined(CYCLONE_SIMD_NEON)
+            float32x4_t sum = vaddq_f32(vmulq_n_f32(vld1q_f32(data), vector.x),
+                                        vmulq_n_f32(vld1q_f32(data + 4), vector.y));
+            sum = vaddq_f32(sum, vmulq_n_f32(vld1q_f32(data + 8), vector.z));
+            real result[4];
+            vst1q_f32(result, sum);
+            return Vector3(result[0], result[1], result[2]);
+#else
             return Vector3(
                 vector.x * data[0] +
                 vector.y * data[4] +
@@ -787,6 +882,7 @@ namespace cyclone {
                 vector.y * data[6] +
                 vector.z * data[10]
             );
+#endif
         }
 
         /**
@@ -808,6 +904,21 @@ namespace cyclone {
             tmp.x -= data[3];
             tmp.y -= data[7];
             tmp.z -= data[11];
+#if defined(CYCLONE_SIMD_SSE)
+            __m128 sum = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tmp.x), _mm_loadu_ps(data)),
+                                    _mm_mul_ps(_mm_set1_ps(tmp.y), _mm_loadu_ps(data + 4)));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(tmp.z), _mm_loadu_ps(data + 8)));
+            real result[4];
+            _mm_storeu_ps(result, sum);
+            return Vector3(result[0], result[1], result[2]);
+#elif defined(CYCLONE_SIMD_NEON)
+            float32x4_t sum = vaddq_f32(vmulq_n_f32(vld1q_f32(data), tmp.x),
+                                        vmulq_n_f32(vld1q_f32(data + 4), tmp.y));
+            sum = vaddq_f32(sum, vmulq_n_f32(vld1q_f32(data + 8), tmp.z));
+            real result[4];
+            vst1q_f32(result, sum);
+            return Vector3(result[0], result[1], result[2]);
+#else
             return Vector3(
                 tmp.x * data[0] +
                 tmp.y * data[4] +
@@ -821,6 +932,7 @@ namespace cyclone {
                 tmp.y * data[6] +
                 tmp.z * data[10]
             );
+#endif
         }
 
         /**
@@ -1038,11 +1150,31 @@ namespace cyclone {
          */
         Vector3 transformTranspose(const Vector3 &vector) const
         {
+#if defined(CYCLONE_SIMD_SSE)
+            __m128 row2 = _mm_loadu_ps(data + 5);
+            row2 = _mm_shuffle_ps(row2, row2, _MM_SHUFFLE(3,3,2,1));
+            __m128 sum = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(vector.x), _mm_loadu_ps(data)),
+                                    _mm_mul_ps(_mm_set1_ps(vector.y), _mm_loadu_ps(data + 3)));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(vector.z), row2));
+            real result[4];
+            _mm_storeu_ps(result, sum);
+            return Vector3(result[0], result[1], result[2]);
+#elif defined(CYCLONE_SIMD_NEON)
+            float32x4_t row2 = vld1q_f32(data + 5);
+            row2 = vextq_f32(row2, row2, 1);
+            float32x4_t sum = vaddq_f32(vmulq_n_f32(vld1q_f32(data), vector.x),
+                                        vmulq_n_f32(vld1q_f32(data + 3), vector.y));
+            sum = vaddq_f32(sum, vmulq_n_f32(row2, vector.z));
+            real result[4];
+            vst1q_f32(result, sum);
+            return Vector3(result[0], result[1], result[2]);
+#else
             return Vector3(
                 vector.x * data[0] + vector.y * data[3] + vector.z * data[6],
                 vector.x * data[1] + vector.y * data[4] + vector.z * data[7],
                 vector.x * data[2] + vector.y * data[5] + vector.z * data[8]
             );
+#endif
         }
 
         /**
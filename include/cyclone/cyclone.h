@@ -13,10 +13,16 @@
 #include "core.h"
 #include "random.h"
 #include "particle.h"
+#include "jobs.h"
+#include "bodystore.h"
 #include "body.h"
 #include "pcontacts.h"
 #include "pworld.h"
 #include "collide_fine.h"
+#include "collide_batch.h"
+#include "manifold.h"
+#include "ccd.h"
 #include "contacts.h"
+#include "impulse.h"
 #include "fgen.h"
 #include "joints.h"
\ No newline at end of file
@@ -0,0 +1,770 @@
+/*
+ * Interface file for the sequential impulse contact resolver.
+ *
+ * Part of the Cyclone physics system.
+ *
+ * Copyright (c) Icosagon 2003. All Rights Reserved.
+ *
+ * This software is distributed under licence. Use of this software
+ * implies agreement with all terms and conditions of the accompanying
+ * software licence.
+ */
+
+/**
+ * @file
+ *
+ * This file contains a contact resolver that works on accumulated
+ * impulses, and a cache that carries those impulses from one frame
+ * to the next so the resolver can start from the last answer.
+ */
+#ifndef CYCLONE_IMPULSE_H
+#define CYCLONE_IMPULSE_H
+
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
+#include "contacts.h"
+
+namespace cyclone {
+
+    /**
+     * Holds the impulses applied at each contact in the last frame,
+     * so they can be applied again as a first guess in the next.
+     *
+     * Contacts are matched by the pair of bodies and the feature
+     * they touch at. The feature is identified by the contact point
+     * in the local space of the first body of the pair: a contact in
+     * the new frame takes the impulses of the nearest old contact of
+     * the same pair within the match distance. Bodies that rest on
+     * each other keep their contact points still in local space, so
+     * they keep matching from frame to frame.
+     *
+     * The cache is rebuilt from the contacts of each frame, so
+     * contacts that have gone away are dropped automatically.
+     */
+    class ContactCache
+    {
+    public:
+        /**
+         * Holds the impulses of one contact. The pair is stored with
+         * the bodies in a fixed order, so the impulses match however
+         * a contact generator orders the bodies.
+         */
+        struct Entry
+        {
+            const RigidBody *first;
+            const RigidBody *second;
+
+            /** The contact point in the local space of first. */
+            Vector3 localPoint;
+
+            /** The impulse applied along the contact normal. */
+            real normalImpulse;
+
+            /**
+             * The friction impulse in world space, as applied to
+             * first.
+             */
+            Vector3 frictionImpulse;
+        };
+
+    protected:
+        /**
+         * Identifies a pair of bodies in the cache.
+         */
+        struct PairKey
+        {
+            const RigidBody *first;
+            const RigidBody *second;
+
+            bool operator==(const PairKey &other) const
+            {
+                return first == other.first && second == other.second;
+            }
+        };
+
+        struct PairHash
+        {
+            size_t operator()(const PairKey &key) const
+            {
+                size_t a = (size_t)key.first;
+                size_t b = (size_t)key.second;
+                return a ^ (b * 31 + (a >> 4));
+            }
+        };
+
+        /**
+         * Holds the entries of the last frame, grouped by pair.
+         */
+        std::vector<Entry> entries;
+
+        /**
+         * Marks the entries that have already been matched this frame.
+         */
+        std::vector<unsigned char> claimed;
+
+        /**
+         * Maps each pair to the first of its entries and their count.
+         */
+        std::unordered_map<PairKey, std::pair<unsigned, unsigned>, PairHash> pairs;
+
+        /**
+         * Holds the entries being recorded for the next frame.
+         */
+        std::vector<Entry> nextEntries;
+
+        /**
+         * Holds the largest local distance at which a contact
+         * matches a cached one.
+         */
+        real matchDistance;
+
+    public:
+        /**
+         * Creates an empty cache with the given match distance.
+         */
+        ContactCache(real matchDistance = (real)0.05)
+            : matchDistance(matchDistance)
+        {
+        }
+
+        /**
+         * Sets the largest local distance at which a contact matches
+         * a cached one.
+         */
+        void setMatchDistance(real distance)
+        {
+            matchDistance = distance;
+        }
+
+        /**
+         * Returns the number of contacts cached from the last frame.
+         */
+        unsigned size() const
+        {
+            return (unsigned)entries.size();
+        }
+
+        /**
+         * Drops every cached impulse.
+         */
+        void clear()
+        {
+            entries.clear();
+            claimed.clear();
+            pairs.clear();
+            nextEntries.clear();
+        }
+
+        /**
+         * Orders the bodies of a contact into the order the cache
+         * uses. Returns true if they had to be swapped.
+         */
+        static bool orderPair(const RigidBody *&first, const RigidBody *&second)
+        {
+            // Scenery (NULL) always comes second.
+            if (second && second < first)
+            {
+                std::swap(first, second);
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * Finds the closest unclaimed entry of the given pair to the
+         * given local point, claims it and returns it, or returns
+         * NULL if there is none within the match distance. The
+         * bodies must already be ordered with orderPair.
+         */
+        const Entry* find(const RigidBody *first, const RigidBody *second,
+                          const Vector3 &localPoint)
+        {
+            PairKey key;
+            key.first = first;
+            key.second = second;
+            std::unordered_map<PairKey, std::pair<unsigned, unsigned>, PairHash>::const_iterator
+                found = pairs.find(key);
+            if (found == pairs.end()) return 0;
+
+            unsigned best = ~0u;
+            real bestDistance = matchDistance * matchDistance;
+            unsigned end = found->second.first + found->second.second;
+            for (unsigned i = found->second.first; i < end; i++)
+            {
+                if (claimed[i]) continue;
+                real distance = (entries[i].localPoint - localPoint).squareMagnitude();
+                if (distance <= bestDistance)
+                {
+                    best = i;
+                    bestDistance = distance;
+                }
+            }
+            if (best == ~0u) return 0;
+
+            claimed[best] = 1;
+            return &entries[best];
+        }
+
+        /**
+         * Records the impulses of a contact for the next frame.
+         */
+        void record(const Entry &entry)
+        {
+            nextEntries.push_back(entry);
+        }
+
+        /**
+         * Replaces the cached entries with those recorded since the
+         * last call.
+         */
+        void commit()
+        {
+            // Group the entries by pair, keeping their order.
+            std::stable_sort(nextEntries.begin(), nextEntries.end(), PairOrder());
+            entries.swap(nextEntries);
+            nextEntries.clear();
+            claimed.assign(entries.size(), 0);
+
+            pairs.clear();
+            for (unsigned i = 0; i < entries.size(); )
+            {
+                PairKey key;
+                key.first = entries[i].first;
+                key.second = entries[i].second;
+
+                unsigned count = 1;
+                while (i + count < entries.size() &&
+                    entries[i + count].first == key.first &&
+                    entries[i + count].second == key.second)
+                {
+                    count++;
+                }
+                pairs[key] = std::make_pair(i, count);
+                i += count;
+            }
+        }
+
+    protected:
+        struct PairOrder
+        {
+            bool operator()(const Entry &a, const Entry &b) const
+            {
+                if (a.first != b.first) return a.first < b.first;
+                return a.second < b.second;
+            }
+        };
+    };
+
+    /**
+     * A contact resolver that uses sequential impulses.
+     *
+     * Each contact keeps the total impulse applied to it along the
+     * normal and in the friction plane. Each iteration visits every
+     * contact, works out the impulse that would bring its relative
+     * velocity to the target and adds it to the total, clamping the
+     * total so the normal impulse only pushes and the friction
+     * impulse stays inside the friction cone. Penetration is removed
+     * by asking for a small separating velocity (Baumgarte
+     * stabilisation) rather than by moving the bodies.
+     *
+     * With warm starting the totals from the last frame are applied
+     * before the first iteration, taken from a ContactCache. In a
+     * resting stack those totals are already nearly right, so far
+     * fewer iterations are needed than when starting from zero. The
+     * resolver stops early once no contact changes by more than the
+     * velocity epsilon.
+     *
+     * This is an alternative to ContactResolver, which resolves the
+     * worst contact first and doesn't remember anything between
+     * frames. ContactResolver is better for impacts and explosions;
+     * this resolver is better for stacks and resting contact.
+     */
+    class ImpulseContactResolver
+    {
+    protected:
+        /**
+         * Holds the velocity and mass of a body while it is being
+         * resolved. Velocities are copied in, changed, and written
+         * back at the end.
+         */
+        struct SolverBody
+        {
+            RigidBody *body;
+            Vector3 position;
+            Vector3 velocity;
+            Vector3 rotation;
+            Matrix3 inverseInertiaTensor;
+            real inverseMass;
+        };
+
+        /**
+         * Holds the working data of a contact while it is being
+         * resolved.
+         */
+        struct SolverContact
+        {
+            unsigned body[2];
+            Vector3 relativePosition[2];
+            Vector3 normal;
+            Vector3 tangent[2];
+            real normalMass;
+            real tangentMass[2];
+            real bias;
+            real friction;
+            real normalImpulse;
+            real tangentImpulse[2];
+            const Contact *contact;
+        };
+
+        /** Marks a contact with the scenery. */
+        static const unsigned NO_BODY = ~0u;
+
+        /** Holds the number of iterations to perform. */
+        unsigned velocityIterations;
+
+        /**
+         * Holds the change in velocity at every contact below which
+         * an iteration counts as converged.
+         */
+        real velocityEpsilon;
+
+        /**
+         * Holds the fraction of the penetration removed each second,
+         * over the duration of one step.
+         */
+        real baumgarte;
+
+        /**
+         * Holds the penetration that is allowed to remain, so that
+         * resting contacts stay in contact.
+         */
+        real penetrationSlop;
+
+        /**
+         * Holds the closing speed below which contacts don't bounce.
+         */
+        real restitutionThreshold;
+
+        /**
+         * True if the last frame's impulses are applied first.
+         */
+        bool warmStarting;
+
+        /** Holds the impulses between frames. */
+        ContactCache cache;
+
+        /** Scratch data, kept between calls to avoid allocation. */
+        std::vector<SolverBody> bodies;
+        std::vector<SolverContact> solverContacts;
+        std::unordered_map<const RigidBody*, unsigned> bodyIndex;
+
+    public:
+        /**
+         * Stores the number of iterations used in the last call to
+         * resolveContacts.
+         */
+        unsigned velocityIterationsUsed;
+
+        /**
+         * Stores the number of contacts that were warm started in the
+         * last call to resolveContacts.
+         */
+        unsigned warmStartedContacts;
+
+        /**
+         * Creates a resolver with the given number of iterations and
+         * velocity epsilon.
+         */
+        ImpulseContactResolver(unsigned iterations = 10,
+                               real velocityEpsilon = (real)0.001)
+            : velocityIterations(iterations), velocityEpsilon(velocityEpsilon),
+              baumgarte((real)0.2), penetrationSlop((real)0.01),
+              restitutionThreshold((real)0.25), warmStarting(true),
+              velocityIterationsUsed(0), warmStartedContacts(0)
+        {
+        }
+
+        /**
+         * Sets the number of iterations.
+         */
+        void setIterations(unsigned iterations)
+        {
+            velocityIterations = iterations;
+        }
+
+        /**
+         * Sets the change in velocity below which the resolver stops.
+         */
+        void setEpsilon(real velocityEpsilon)
+        {
+            ImpulseContactResolver::velocityEpsilon = velocityEpsilon;
+        }
+
+        /**
+         * Sets how quickly penetration is removed and how much is
+         * allowed to remain.
+         */
+        void setPositionCorrection(real baumgarte, real penetrationSlop)
+        {
+            ImpulseContactResolver::baumgarte = baumgarte;
+            ImpulseContactResolver::penetrationSlop = penetrationSlop;
+        }
+
+        /**
+         * Sets whether last frame's impulses are applied first. The
+         * cache is still kept up to date when this is off.
+         */
+        void setWarmStarting(bool warmStarting)
+        {
+            ImpulseContactResolver::warmStarting = warmStarting;
+        }
+
+        /**
+         * Returns the impulse cache.
+         */
+        ContactCache& getCache()
+        {
+            return cache;
+        }
+
+        /**
+         * Resolves the given contacts by changing the velocities of
+         * their bodies, and records their impulses for the next
+         * frame. Sleeping bodies in contact with awake ones are
+         * woken; contacts where no body is awake, or where neither
+         * body can be moved, are left alone.
+         */
+        void resolveContacts(const Contact *contactArray,
+                             unsigned numContacts,
+                             real duration)
+        {
+            velocityIterationsUsed = 0;
+            warmStartedContacts = 0;
+            if (duration <= 0) return;
+
+            prepare(contactArray, numContacts, duration);
+
+            if (warmStarting)
+            {
+                for (unsigned i = 0; i < solverContacts.size(); i++)
+                {
+                    SolverContact &c = solverContacts[i];
+                    Vector3 impulse = c.normal * c.normalImpulse +
+                        c.tangent[0] * c.tangentImpulse[0] +
+                        c.tangent[1] * c.tangentImpulse[1];
+                    applyImpulse(c, impulse);
+                }
+            }
+            else
+            {
+                for (unsigned i = 0; i < solverContacts.size(); i++)
+                {
+                    SolverContact &c = solverContacts[i];
+                    c.normalImpulse = 0;
+                    c.tangentImpulse[0] = c.tangentImpulse[1] = 0;
+                }
+            }
+
+            while (velocityIterationsUsed < velocityIterations)
+            {
+                velocityIterationsUsed++;
+
+                real largestChange = 0;
+                for (unsigned i = 0; i < solverContacts.size(); i++)
+                {
+                    real change = solveContact(solverContacts[i]);
+                    if (change > largestChange) largestChange = change;
+                }
+                if (largestChange < velocityEpsilon) break;
+            }
+
+            // Write the velocities back and remember the impulses.
+            for (unsigned i = 0; i < bodies.size(); i++)
+            {
+                bodies[i].body->setVelocity(bodies[i].velocity);
+                bodies[i].body->setRotation(bodies[i].rotation);
+            }
+            for (unsigned i = 0; i < solverContacts.size(); i++)
+            {
+                recordContact(solverContacts[i]);
+            }
+            cache.commit();
+        }
+
+    protected:
+        /**
+         * Returns the solver body of the given body, adding it if
+         * needed.
+         */
+        unsigned getSolverBody(RigidBody *body)
+        {
+            std::pair<std::unordered_map<const RigidBody*, unsigned>::iterator, bool>
+                found = bodyIndex.insert(std::make_pair(body, (unsigned)bodies.size()));
+            if (!found.second) return found.first->second;
+
+            SolverBody solverBody;
+            solverBody.body = body;
+            solverBody.position = body->getPosition();
+            solverBody.velocity = body->getVelocity();
+            solverBody.rotation = body->getRotation();
+            body->getInverseInertiaTensorWorld(&solverBody.inverseInertiaTensor);
+            solverBody.inverseMass = body->getInverseMass();
+            bodies.push_back(solverBody);
+            return found.first->second;
+        }
+
+        /**
+         * Returns the velocity of the contact point on body[0]
+         * relative to body[1].
+         */
+        Vector3 relativeVelocity(const SolverContact &c) const
+        {
+            const SolverBody &one = bodies[c.body[0]];
+            Vector3 velocity = one.velocity + (one.rotation % c.relativePosition[0]);
+            if (c.body[1] != NO_BODY)
+            {
+                const SolverBody &two = bodies[c.body[1]];
+                velocity -= two.velocity + (two.rotation % c.relativePosition[1]);
+            }
+            return velocity;
+        }
+
+        /**
+         * Returns the inverse of the mass felt by an impulse along
+         * the given direction at the contact.
+         */
+        real inverseMassAlong(const SolverContact &c, const Vector3 &direction) const
+        {
+            const SolverBody &one = bodies[c.body[0]];
+            Vector3 torquePerUnit = c.relativePosition[0] % direction;
+            real inverseMass = one.inverseMass + direction *
+                (one.inverseInertiaTensor.transform(torquePerUnit) % c.relativePosition[0]);
+            if (c.body[1] != NO_BODY)
+            {
+                const SolverBody &two = bodies[c.body[1]];
+                torquePerUnit = c.relativePosition[1] % direction;
+                inverseMass += two.inverseMass + direction *
+                    (two.inverseInertiaTensor.transform(torquePerUnit) % c.relativePosition[1]);
+            }
+            return inverseMass;
+        }
+
+        /**
+         * Returns the mass felt by an impulse along the given
+         * direction, or zero if such an impulse can't move the
+         * contact.
+         */
+        real massAlong(const SolverContact &c, const Vector3 &direction) const
+        {
+            real inverseMass = inverseMassAlong(c, direction);
+            if (inverseMass <= 0) return 0;
+            return ((real)1.0) / inverseMass;
+        }
+
+        /**
+         * Returns true if the body has infinite mass and inertia, so
+         * no impulse can change its velocity.
+         */
+        static bool isImmovable(const RigidBody *body)
+        {
+            if (body->getInverseMass() != 0) return false;
+
+            Matrix3 inverseInertiaTensor;
+            body->getInverseInertiaTensorWorld(&inverseInertiaTensor);
+            for (unsigned i = 0; i < 9; i++)
+            {
+                if (inverseInertiaTensor.data[i] != 0) return false;
+            }
+            return true;
+        }
+
+        /**
+         * Applies the given impulse to body[0], and its opposite to
+         * body[1].
+         */
+        void applyImpulse(const SolverContact &c, const Vector3 &impulse)
+        {
+            SolverBody &one = bodies[c.body[0]];
+            one.velocity.addScaledVector(impulse, one.inverseMass);
+            one.rotation += one.inverseInertiaTensor.transform(c.relativePosition[0] % impulse);
+            if (c.body[1] != NO_BODY)
+            {
+                SolverBody &two = bodies[c.body[1]];
+                two.velocity.addScaledVector(impulse, -two.inverseMass);
+                two.rotation -= two.inverseInertiaTensor.transform(c.relativePosition[1] % impulse);
+            }
+        }
+
+        /**
+         * Sets up the solver bodies and contacts, and fetches the
+         * impulses of the last frame from the cache.
+         */
+        void prepare(const Contact *contactArray, unsigned numContacts, real duration)
+        {
+            bodies.clear();
+            bodyIndex.clear();
+            solverContacts.clear();
+
+            for (unsigned i = 0; i < numContacts; i++)
+            {
+                const Contact &contact = contactArray[i];
+                RigidBody *one = contact.body[0];
+                RigidBody *two = contact.body[1];
+                if (!one) continue;
+
+                // A contact that no impulse can move has no effective
+                // mass to solve with.
+                if (isImmovable(one) && (!two || isImmovable(two))) continue;
+
+                // Wake a sleeping body touched by an awake one, and
+                // skip contacts with nothing awake.
+                bool awakeOne = one->getAwake();
+                bool awakeTwo = two && two->getAwake();
+                if (!awakeOne && !awakeTwo) continue;
+                if (two && awakeOne != awakeTwo)
+                {
+                    if (awakeOne) two->setAwake();
+                    else one->setAwake();
+                }
+
+                SolverContact c;
+                c.contact = &contact;
+                c.body[0] = getSolverBody(one);
+                c.body[1] = two ? getSolverBody(two) : NO_BODY;
+                c.relativePosition[0] = contact.contactPoint - bodies[c.body[0]].position;
+                if (two) c.relativePosition[1] = contact.contactPoint - bodies[c.body[1]].position;
+                c.normal = contact.contactNormal;
+                c.friction = contact.friction;
+                makeTangents(c.normal, &c.tangent[0], &c.tangent[1]);
+
+                c.normalMass = massAlong(c, c.normal);
+                c.tangentMass[0] = massAlong(c, c.tangent[0]);
+                c.tangentMass[1] = massAlong(c, c.tangent[1]);
+
+                // Ask for enough separating velocity to bounce, or to
+                // remove part of the penetration, whichever is larger.
+                real closingVelocity = relativeVelocity(c) * c.normal;
+                real bias = 0;
+                if (closingVelocity < -restitutionThreshold)
+                {
+                    bias = -contact.restitution * closingVelocity;
+                }
+                real penetration = contact.penetration - penetrationSlop;
+                if (penetration > 0)
+                {
+                    bias = (std::max)(bias, baumgarte * penetration / duration);
+                }
+                c.bias = bias;
+
+                fetchImpulses(c, one, two);
+                solverContacts.push_back(c);
+            }
+        }
+
+        /**
+         * Fills the contact's starting impulses from the cache, or
+         * with zero.
+         */
+        void fetchImpulses(SolverContact &c, const RigidBody *one, const RigidBody *two)
+        {
+            c.normalImpulse = 0;
+            c.tangentImpulse[0] = c.tangentImpulse[1] = 0;
+
+            const RigidBody *first = one;
+            const RigidBody *second = two;
+            bool swapped = ContactCache::orderPair(first, second);
+            Vector3 localPoint = first->getPointInLocalSpace(c.contact->contactPoint);
+
+            const ContactCache::Entry *entry = cache.find(first, second, localPoint);
+            if (!entry) return;
+
+            // The friction direction may have turned since the last
+            // frame, so project the old impulse onto the new plane.
+            Vector3 friction = swapped ? entry->frictionImpulse * -1 : entry->frictionImpulse;
+            c.normalImpulse = entry->normalImpulse;
+            c.tangentImpulse[0] = friction * c.tangent[0];
+            c.tangentImpulse[1] = friction * c.tangent[1];
+            warmStartedContacts++;
+        }
+
+        /**
+         * Records the contact's impulses in the cache.
+         */
+        void recordContact(const SolverContact &c)
+        {
+            ContactCache::Entry entry;
+            entry.first = c.contact->body[0];
+            entry.second = c.contact->body[1];
+            bool swapped = ContactCache::orderPair(entry.first, entry.second);
+            entry.localPoint = entry.first->getPointInLocalSpace(c.contact->contactPoint);
+            entry.normalImpulse = c.normalImpulse;
+            entry.frictionImpulse = c.tangent[0] * c.tangentImpulse[0] +
+                c.tangent[1] * c.tangentImpulse[1];
+            if (swapped) entry.frictionImpulse *= -1;
+            cache.record(entry);
+        }
+
+        /**
+         * Runs one iteration on a contact: friction first, then the
+         * normal. Returns the largest change in velocity it caused.
+         */
+        real solveContact(SolverContact &c)
+        {
+            real largestChange = 0;
+
+            // Friction, clamped to the cone of the current normal impulse.
+            real limit = c.friction * c.normalImpulse;
+            for (unsigned t = 0; t < 2; t++)
+            {
+                if (c.tangentMass[t] == 0) continue;
+
+                real velocity = relativeVelocity(c) * c.tangent[t];
+                real total = c.tangentImpulse[t] - velocity * c.tangentMass[t];
+                if (total > limit) total = limit;
+                else if (total < -limit) total = -limit;
+
+                real change = total - c.tangentImpulse[t];
+                c.tangentImpulse[t] = total;
+                applyImpulse(c, c.tangent[t] * change);
+                largestChange = (std::max)(largestChange, real_abs(change / c.tangentMass[t]));
+            }
+
+            // The normal impulse can only push.
+            if (c.normalMass == 0) return largestChange;
+            real velocity = relativeVelocity(c) * c.normal;
+            real total = c.normalImpulse + (c.bias - velocity) * c.normalMass;
+            if (total < 0) total = 0;
+
+            real change = total - c.normalImpulse;
+            c.normalImpulse = total;
+            applyImpulse(c, c.normal * change);
+            largestChange = (std::max)(largestChange, real_abs(change / c.normalMass));
+
+            return largestChange;
+        }
+
+        /**
+         * Fills two unit vectors that are at right angles to the
+         * normal and to each other.
+         */
+        static void makeTangents(const Vector3 &normal, Vector3 *one, Vector3 *two)
+        {
+            // Cross with whichever world axis is furthest from the normal.
+            if (real_abs(normal.x) > real_abs(normal.y))
+            {
+                *one = normal % Vector3(0, 1, 0);
+            }
+            else
+            {
+                *one = normal % Vector3(1, 0, 0);
+            }
+            one->normalise();
+            *two = normal % *one;
+        }
+    };
+
+} // namespace cyclone
+
+#endif // CYCLONE_IMPULSE_H
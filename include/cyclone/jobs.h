@@ -0,0 +1,216 @@
+/*
+ * Interface file for the job pool.
+ *
+ * Part of the Cyclone physics system.
+ *
+ * Copyright (c) Icosagon 2003. All Rights Reserved.
+ *
+ * This software is distributed under licence. Use of this software
+ * implies agreement with all terms and conditions of the accompanying
+ * software licence.
+ */
+
+/**
+ * @file
+ *
+ * This file contains a pool of worker threads used to split the
+ * stages of a physics step across cores.
+ */
+#ifndef CYCLONE_JOBS_H
+#define CYCLONE_JOBS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cyclone {
+
+    /**
+     * A pool of worker threads that runs parallel loops. The workers
+     * are created with the pool and reused until it is destroyed.
+     *
+     * parallelFor splits the index range evenly between the
+     * participants. A participant that finishes its own range takes
+     * the remaining indices from the others. The calling thread
+     * takes part as participant 0.
+     */
+    class JobPool
+    {
+    public:
+        /**
+         * A job takes the index to process and the number of the
+         * participant processing it, from 0 to getThreadCount()-1.
+         */
+        typedef std::function<void(unsigned index, unsigned thread)> Job;
+
+    protected:
+        /**
+         * Holds the range of indices given to one participant. Other
+         * participants steal from it by advancing next.
+         */
+        struct Range
+        {
+            std::atomic<unsigned> next;
+            unsigned end;
+        };
+
+        /** Holds the worker threads, not including the caller. */
+        std::vector<std::thread> workers;
+
+        /** Holds one range for each participant. */
+        std::vector<Range> ranges;
+
+        /** Holds the job being run. */
+        const Job *job;
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable finished;
+
+        /**
+         * Holds a counter that goes up each time parallelFor is
+         * called. Workers wake up when it changes.
+         */
+        unsigned generation;
+
+        /** Holds the number of workers still running the job. */
+        unsigned busyWorkers;
+
+        bool stopping;
+
+    public:
+        /**
+         * Creates a pool with the given number of participants,
+         * including the calling thread. If the count is zero, the
+         * number of hardware threads is used.
+         */
+        explicit JobPool(unsigned threadCount = 0)
+            : ranges(threadCount ? threadCount :
+                (std::thread::hardware_concurrency() ?
+                    std::thread::hardware_concurrency() : 1)),
+              job(0), generation(0), busyWorkers(0), stopping(false)
+        {
+            for (unsigned i = 0; i < ranges.size(); i++)
+            {
+                ranges[i].next = 0;
+                ranges[i].end = 0;
+            }
+
+            // Participant 0 is the thread that calls parallelFor.
+            for (unsigned i = 1; i < ranges.size(); i++)
+            {
+                workers.push_back(std::thread(&JobPool::workerLoop, this, i));
+            }
+        }
+
+        ~JobPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+
+            for (unsigned i = 0; i < workers.size(); i++) workers[i].join();
+        }
+
+        /**
+         * Returns the number of participants, including the caller.
+         */
+        unsigned getThreadCount() const
+        {
+            return (unsigned)ranges.size();
+        }
+
+        /**
+         * Calls the job once for every index in [0, count), and
+         * returns when they have all finished. Which participant runs
+         * which index is not defined.
+         */
+        void parallelFor(unsigned count, const Job &job)
+        {
+            if (count == 0) return;
+
+            // Small jobs, or pools without workers, run here.
+            const unsigned threads = getThreadCount();
+            if (threads == 1 || count == 1)
+            {
+                for (unsigned i = 0; i < count; i++) job(i, 0);
+                return;
+            }
+
+            for (unsigned t = 0; t < threads; t++)
+            {
+                ranges[t].next = (unsigned)((unsigned long long)count * t / threads);
+                ranges[t].end = (unsigned)((unsigned long long)count * (t + 1) / threads);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                JobPool::job = &job;
+                busyWorkers = (unsigned)workers.size();
+                generation++;
+            }
+            wake.notify_all();
+
+            runRanges(0);
+
+            // Wait for every worker to finish.
+            std::unique_lock<std::mutex> lock(mutex);
+            while (busyWorkers != 0) finished.wait(lock);
+            JobPool::job = 0;
+        }
+
+    protected:
+        /**
+         * The main loop of a worker thread.
+         */
+        void workerLoop(unsigned thread)
+        {
+            unsigned seen = 0;
+            for (;;)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    while (!stopping && generation == seen) wake.wait(lock);
+                    if (stopping) return;
+                    seen = generation;
+                }
+
+                runRanges(thread);
+
+                bool last;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    last = (--busyWorkers == 0);
+                }
+                if (last) finished.notify_one();
+            }
+        }
+
+        /**
+         * Runs the participant's own range, then steals from the
+         * ranges of the others in turn.
+         */
+        void runRanges(unsigned thread)
+        {
+            const unsigned threads = getThreadCount();
+            for (unsigned k = 0; k < threads; k++)
+            {
+                Range &range = ranges[(thread + k) % threads];
+                for (;;)
+                {
+                    unsigned index = range.next.fetch_add(1);
+                    if (index >= range.end) break;
+                    (*job)(index, thread);
+                }
+            }
+        }
+    };
+
+} // namespace cyclone
+
+#endif // CYCLONE_JOBS_H
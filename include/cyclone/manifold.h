@@ -0,0 +1,787 @@
+/*
+ * Interface file for persistent contact manifolds.
+ *
+ * Part of the Cyclone physics system.
+ *
+ * Copyright (c) Icosagon 2003. All Rights Reserved.
+ *
+ * This software is distributed under licence. Use of this software
+ * implies agreement with all terms and conditions of the accompanying
+ * software licence.
+ */
+
+/**
+ * @file
+ *
+ * This file contains contact manifolds: the set of contact points
+ * between one pair of primitives, kept from one frame to the next.
+ *
+ * Box-box manifolds are built by clipping the face of one box
+ * against the face of the other, and box-plane manifolds from the
+ * vertices under the plane. Either way the points are reduced to at
+ * most four that span the contact area. Each point carries an id
+ * for the features that meet at it, so a point found again in the
+ * next frame keeps its identity, and while the pair hardly moves
+ * relative to itself the points are refreshed in place instead of
+ * being generated again.
+ */
+#ifndef CYCLONE_MANIFOLD_H
+#define CYCLONE_MANIFOLD_H
+
+#include <unordered_map>
+
+#include "collide_batch.h"
+
+namespace cyclone {
+
+    /**
+     * Holds the contact points between a pair of primitives.
+     *
+     * Manifolds are normally taken from a ManifoldCache, which keeps
+     * one for each pair that is in contact, and filled in by
+     * ManifoldCollisionDetector.
+     */
+    class ContactManifold
+    {
+    public:
+        enum { MAX_POINTS = 4 };
+
+        /**
+         * Holds one point of the manifold.
+         */
+        struct Point
+        {
+            /**
+             * Identifies the features that meet at this point. The
+             * same contact found in a later frame has the same id.
+             */
+            unsigned feature;
+
+            /**
+             * The point on the incident primitive, in that
+             * primitive's local space.
+             */
+            Vector3 localPoint;
+
+            /** The contact point in world space. */
+            Vector3 position;
+
+            /** The depth of the point below the reference face. */
+            real penetration;
+
+            /** The number of frames the point has been kept for. */
+            unsigned age;
+        };
+
+        /** Holds the points of the manifold. */
+        Point points[MAX_POINTS];
+
+        /** Holds the number of points in use. */
+        unsigned pointCount;
+
+        /**
+         * Holds the contact normal in world space, in the direction
+         * that pushes the reference primitive out of the incident
+         * one.
+         */
+        Vector3 normal;
+
+        /**
+         * Holds the largest change in the relative position of the
+         * pair for which the points are refreshed rather than
+         * generated again.
+         */
+        real linearTolerance;
+
+        /**
+         * Holds the largest change in any element of the relative
+         * rotation of the pair for which the points are refreshed
+         * rather than generated again.
+         */
+        real angularTolerance;
+
+    protected:
+        friend class ManifoldCollisionDetector;
+
+        /**
+         * True if the points lie on a face of the reference box,
+         * which is the only kind of manifold that can be refreshed.
+         */
+        bool faceContact;
+
+        /** True if the reference face is on the first box. */
+        bool referenceIsOne;
+
+        /** The axis of the reference box the reference face is on. */
+        unsigned referenceAxis;
+
+        /** Is 1 or -1 for the side of the box the face is on. */
+        real referenceSign;
+
+        /**
+         * The pose of the second box in the frame of the first when
+         * the points were last generated: the rotation in the first
+         * nine elements, then the position.
+         */
+        real relativePose[12];
+
+        /** True if the last update refreshed the points. */
+        bool refreshed;
+
+    public:
+        ContactManifold()
+            : pointCount(0), linearTolerance((real)0.005),
+              angularTolerance((real)0.005), faceContact(false),
+              referenceIsOne(true), referenceAxis(0), referenceSign(1),
+              refreshed(false)
+        {
+        }
+
+        /**
+         * Returns true if the last update kept the old points in
+         * place instead of generating them again.
+         */
+        bool isRefreshed() const
+        {
+            return refreshed;
+        }
+
+        /**
+         * Forgets the points, so the next update generates them.
+         */
+        void clear()
+        {
+            pointCount = 0;
+            faceContact = false;
+        }
+    };
+
+    /**
+     * Keeps a manifold for each pair of primitives, and drops the
+     * manifolds of pairs that stop touching.
+     *
+     * Call get for each pair found in a frame, then endFrame once
+     * they have all been processed.
+     */
+    class ManifoldCache
+    {
+    protected:
+        /**
+         * Identifies a pair of primitives. The second can be a
+         * CollisionPlane, so both are stored untyped.
+         */
+        struct PairKey
+        {
+            const void *one;
+            const void *two;
+
+            bool operator==(const PairKey &other) const
+            {
+                return one == other.one && two == other.two;
+            }
+        };
+
+        struct PairHash
+        {
+            size_t operator()(const PairKey &key) const
+            {
+                size_t a = (size_t)key.one;
+                size_t b = (size_t)key.two;
+                return a ^ (b * 31 + (a >> 4));
+            }
+        };
+
+        struct Slot
+        {
+            ContactManifold manifold;
+
+            /** The frame in which the pair was last seen. */
+            unsigned frame;
+        };
+
+        std::unordered_map<PairKey, Slot, PairHash> manifolds;
+
+        /** Counts the calls to endFrame. */
+        unsigned frame;
+
+        real linearTolerance;
+        real angularTolerance;
+
+    public:
+        ManifoldCache()
+            : frame(0), linearTolerance((real)0.005),
+              angularTolerance((real)0.005)
+        {
+        }
+
+        /**
+         * Sets the tolerances that decide when the manifolds are
+         * refreshed rather than generated again. See ContactManifold.
+         */
+        void setTolerances(real linear, real angular)
+        {
+            linearTolerance = linear;
+            angularTolerance = angular;
+        }
+
+        /**
+         * Returns the manifold of the given pair, creating an empty
+         * one if the pair has none. The order of the pair matters.
+         */
+        ContactManifold& get(const void *one, const void *two)
+        {
+            PairKey key;
+            key.one = one;
+            key.two = two;
+            Slot &slot = manifolds[key];
+            slot.frame = frame;
+            slot.manifold.linearTolerance = linearTolerance;
+            slot.manifold.angularTolerance = angularTolerance;
+            return slot.manifold;
+        }
+
+        /**
+         * Drops the manifolds of the pairs that were not looked up
+         * since the last call.
+         */
+        void endFrame()
+        {
+            for (std::unordered_map<PairKey, Slot, PairHash>::iterator i =
+                manifolds.begin(); i != manifolds.end(); )
+            {
+                if (i->second.frame != frame) i = manifolds.erase(i);
+                else ++i;
+            }
+            frame++;
+        }
+
+        /**
+         * Returns the number of manifolds held.
+         */
+        unsigned size() const
+        {
+            return (unsigned)manifolds.size();
+        }
+
+        /**
+         * Drops every manifold.
+         */
+        void clear()
+        {
+            manifolds.clear();
+        }
+    };
+
+    /**
+     * Holds the collision tests that fill in contact manifolds.
+     *
+     * Each test updates the manifold of the pair and then writes its
+     * points into the collision data as contacts, returning the
+     * number written. A box-box pair whose relative pose has changed
+     * less than the manifold's tolerances since its points were
+     * generated skips the separating axis test and the clipping: the
+     * points are moved with the boxes and their depths measured
+     * again.
+     */
+    class ManifoldCollisionDetector : public BatchCollisionDetector
+    {
+    public:
+        /**
+         * Holds how much deeper the best face may be than the best
+         * edge axis and still be used.
+         */
+        static real faceBias() { return (real)1.05; }
+
+        /**
+         * Updates the manifold of two boxes and writes its contacts.
+         * The manifold must be the one kept for this pair in this
+         * order.
+         */
+        static unsigned boxAndBox(
+            const CollisionBox &one,
+            const CollisionBox &two,
+            ContactManifold &manifold,
+            CollisionData *data)
+        {
+            real pose[12];
+            relativePose(one, two, pose);
+
+            manifold.refreshed = false;
+            if (manifold.faceContact && manifold.pointCount > 0 &&
+                isPoseClose(manifold, pose))
+            {
+                refreshFace(one, two, manifold, data->tolerance);
+                manifold.refreshed = manifold.pointCount > 0;
+            }
+
+            if (!manifold.refreshed)
+            {
+                BoxPair pair;
+                pair.one = &one;
+                pair.two = &two;
+                GroupResult result;
+                testGroup(&pair, 1, result);
+                if (!result.overlapping)
+                {
+                    manifold.clear();
+                    return 0;
+                }
+
+                // An edge axis only wins if it is clearly better than
+                // the best face. Resting faces often tie with edge
+                // axes, and a face gives a full manifold.
+                unsigned edge = (unsigned)result.best[0];
+                unsigned best = edge;
+                if (best >= 6 && result.singlePenetration[0] <=
+                    result.penetration[0] * faceBias() + data->tolerance)
+                {
+                    best = (unsigned)result.bestSingleAxis[0];
+                }
+                if (best < 6)
+                {
+                    buildFace(one, two, best, manifold, data->tolerance);
+                    for (unsigned i = 0; i < 12; i++) manifold.relativePose[i] = pose[i];
+                }
+
+                // The face chosen over an edge axis can clip away
+                // every point while the boxes still overlap; the edge
+                // contact is used then.
+                if (best >= 6 || (edge >= 6 && manifold.pointCount == 0))
+                {
+                    // Edges touch at a single point, which is not
+                    // kept: it is found again each frame.
+                    manifold.clear();
+                    if (!data->hasMoreContacts()) return 0;
+                    fillContact(one, two, edge,
+                        (unsigned)result.bestSingleAxis[0],
+                        result.penetration[0], data);
+                    data->addContacts(1);
+                    return 1;
+                }
+            }
+
+            const CollisionBox &reference = manifold.referenceIsOne ? one : two;
+            const CollisionBox &incident = manifold.referenceIsOne ? two : one;
+            return writeContacts(manifold, reference.body, incident.body, data);
+        }
+
+        /**
+         * Updates the manifold of a box and a half-space and writes
+         * its contacts. The points are the box vertices under the
+         * plane, reduced to four; the contact points are placed on
+         * the plane, as in CollisionDetector::boxAndHalfSpace.
+         */
+        static unsigned boxAndHalfSpace(
+            const CollisionBox &box,
+            const CollisionPlane &plane,
+            ContactManifold &manifold,
+            CollisionData *data)
+        {
+            ContactManifold::Point candidates[8];
+            unsigned count = 0;
+            for (unsigned v = 0; v < 8; v++)
+            {
+                Vector3 local(
+                    (v & 1) ? box.halfSize.x : -box.halfSize.x,
+                    (v & 2) ? box.halfSize.y : -box.halfSize.y,
+                    (v & 4) ? box.halfSize.z : -box.halfSize.z);
+                Vector3 vertex = box.getTransform() * local;
+                real depth = plane.offset - vertex * plane.direction;
+                if (depth < 0) continue;
+
+                ContactManifold::Point &point = candidates[count++];
+                point.feature = v;
+                point.localPoint = local;
+                point.position = vertex + plane.direction * depth;
+                point.penetration = depth;
+                point.age = 0;
+            }
+
+            manifold.faceContact = false;
+            manifold.refreshed = false;
+            manifold.normal = plane.direction;
+            keepPoints(manifold, candidates, count);
+            return writeContacts(manifold, box.body, 0, data);
+        }
+
+    protected:
+        /**
+         * Holds a point of the incident face while it is clipped.
+         * Each point lies where two lines cross: the edges of the
+         * incident face are lines 0-3, and the sides of the
+         * reference face are lines 4-7.
+         */
+        struct ClipPoint
+        {
+            Vector3 position;
+            unsigned lineIn;
+            unsigned lineOut;
+        };
+
+        /**
+         * Finds the rotation and position of the second box in the
+         * frame of the first.
+         */
+        static void relativePose(const CollisionBox &one,
+                                 const CollisionBox &two,
+                                 real pose[12])
+        {
+            Vector3 toCentre = two.getAxis(3) - one.getAxis(3);
+            for (unsigned i = 0; i < 3; i++)
+            {
+                Vector3 axis = one.getAxis(i);
+                for (unsigned j = 0; j < 3; j++)
+                {
+                    pose[i*3 + j] = axis * two.getAxis(j);
+                }
+                pose[9 + i] = axis * toCentre;
+            }
+        }
+
+        static bool isPoseClose(const ContactManifold &manifold,
+                                const real pose[12])
+        {
+            for (unsigned i = 0; i < 9; i++)
+            {
+                if (real_abs(pose[i] - manifold.relativePose[i]) >
+                    manifold.angularTolerance) return false;
+            }
+            real moved = 0;
+            for (unsigned i = 9; i < 12; i++)
+            {
+                real d = pose[i] - manifold.relativePose[i];
+                moved += d * d;
+            }
+            return moved <= manifold.linearTolerance * manifold.linearTolerance;
+        }
+
+        /**
+         * Finds the reference face normal, pointing from the
+         * reference box towards the incident one, and the offset of
+         * the face along it.
+         */
+        static Vector3 referenceFace(const CollisionBox &reference,
+                                     const ContactManifold &manifold,
+                                     real &offset)
+        {
+            Vector3 normal = reference.getAxis(manifold.referenceAxis) *
+                manifold.referenceSign;
+            offset = normal * reference.getAxis(3) +
+                reference.halfSize[manifold.referenceAxis];
+            return normal;
+        }
+
+        /**
+         * Moves the points of a face manifold with the boxes and
+         * measures their depths again, dropping those that have
+         * come away.
+         */
+        static void refreshFace(const CollisionBox &one,
+                                const CollisionBox &two,
+                                ContactManifold &manifold,
+                                real tolerance)
+        {
+            const CollisionBox &reference = manifold.referenceIsOne ? one : two;
+            const CollisionBox &incident = manifold.referenceIsOne ? two : one;
+
+            real offset;
+            Vector3 faceNormal = referenceFace(reference, manifold, offset);
+            manifold.normal = faceNormal * -1.0f;
+
+            unsigned kept = 0;
+            for (unsigned i = 0; i < manifold.pointCount; i++)
+            {
+                ContactManifold::Point point = manifold.points[i];
+                point.position = incident.getTransform() * point.localPoint;
+                point.penetration = offset - point.position * faceNormal;
+                if (point.penetration < -tolerance) continue;
+                point.age++;
+                manifold.points[kept++] = point;
+            }
+            manifold.pointCount = kept;
+        }
+
+        /**
+         * Clips the polygon against the plane p * normal <= offset,
+         * which is side line number line.
+         */
+        static unsigned clip(const ClipPoint *in, unsigned count,
+                             const Vector3 &normal, real offset,
+                             unsigned line, ClipPoint *out)
+        {
+            unsigned written = 0;
+            for (unsigned i = 0; i < count; i++)
+            {
+                const ClipPoint &a = in[(i + count - 1) % count];
+                const ClipPoint &b = in[i];
+                real da = a.position * normal - offset;
+                real db = b.position * normal - offset;
+
+                if ((da <= 0) != (db <= 0))
+                {
+                    // The segment from a to b lies on line a.lineOut.
+                    ClipPoint &cross = out[written++];
+                    cross.position = a.position +
+                        (b.position - a.position) * (da / (da - db));
+                    if (da <= 0)
+                    {
+                        cross.lineIn = a.lineOut;
+                        cross.lineOut = line;
+                    }
+                    else
+                    {
+                        cross.lineIn = line;
+                        cross.lineOut = a.lineOut;
+                    }
+                }
+                if (db <= 0) out[written++] = b;
+            }
+            return written;
+        }
+
+        /**
+         * Generates the points of a face manifold by clipping the
+         * face of the incident box that faces the reference face
+         * against the sides of the reference face.
+         */
+        static void buildFace(const CollisionBox &one,
+                              const CollisionBox &two,
+                              unsigned best,
+                              ContactManifold &manifold,
+                              real tolerance)
+        {
+            manifold.faceContact = true;
+            manifold.referenceIsOne = best < 3;
+            manifold.referenceAxis = best % 3;
+
+            const CollisionBox &reference = manifold.referenceIsOne ? one : two;
+            const CollisionBox &incident = manifold.referenceIsOne ? two : one;
+
+            // Use the side of the reference box that faces the
+            // incident box.
+            Vector3 toIncident = incident.getAxis(3) - reference.getAxis(3);
+            manifold.referenceSign =
+                reference.getAxis(manifold.referenceAxis) * toIncident < 0 ? -1.0f : 1.0f;
+
+            real offset;
+            Vector3 faceNormal = referenceFace(reference, manifold, offset);
+            manifold.normal = faceNormal * -1.0f;
+
+            // The incident face is the one most opposed to the
+            // reference face.
+            unsigned incidentAxis = 0;
+            real bestDot = 0;
+            for (unsigned k = 0; k < 3; k++)
+            {
+                real dot = incident.getAxis(k) * faceNormal;
+                if (real_abs(dot) > real_abs(bestDot))
+                {
+                    bestDot = dot;
+                    incidentAxis = k;
+                }
+            }
+            real incidentSign = bestDot > 0 ? -1.0f : 1.0f;
+
+            unsigned u = (incidentAxis + 1) % 3, v = (incidentAxis + 2) % 3;
+            Vector3 centre = incident.getAxis(3) + incident.getAxis(incidentAxis) *
+                (incidentSign * incident.halfSize[incidentAxis]);
+            Vector3 du = incident.getAxis(u) * incident.halfSize[u];
+            Vector3 dv = incident.getAxis(v) * incident.halfSize[v];
+
+            // Corner c starts edge c, which runs to corner c+1.
+            ClipPoint polygon[8], scratch[8];
+            polygon[0].position = centre + du + dv;
+            polygon[1].position = centre - du + dv;
+            polygon[2].position = centre - du - dv;
+            polygon[3].position = centre + du - dv;
+            for (unsigned c = 0; c < 4; c++)
+            {
+                polygon[c].lineIn = (c + 3) % 4;
+                polygon[c].lineOut = c;
+            }
+            unsigned count = 4;
+
+            // Clip against the four sides of the reference face.
+            Vector3 referenceCentre = reference.getAxis(3);
+            for (unsigned side = 0; side < 4 && count > 0; side++)
+            {
+                unsigned axis = (manifold.referenceAxis + 1 + side / 2) % 3;
+                Vector3 sideNormal = reference.getAxis(axis);
+                if (side & 1) sideNormal = sideNormal * -1.0f;
+                real sideOffset = sideNormal * referenceCentre + reference.halfSize[axis];
+                count = clip(polygon, count, sideNormal, sideOffset, 4 + side, scratch);
+                for (unsigned i = 0; i < count; i++) polygon[i] = scratch[i];
+            }
+
+            // The faces go in the top bits of the ids, so the ids
+            // change when the boxes meet on different faces.
+            unsigned faces =
+                (manifold.referenceIsOne ? 0u : 1u) << 16 |
+                (manifold.referenceAxis * 2 + (manifold.referenceSign < 0 ? 1u : 0u)) << 12 |
+                (incidentAxis * 2 + (incidentSign < 0 ? 1u : 0u)) << 8;
+
+            ContactManifold::Point candidates[8];
+            unsigned kept = 0;
+            for (unsigned i = 0; i < count; i++)
+            {
+                real depth = offset - polygon[i].position * faceNormal;
+                if (depth < -tolerance) continue;
+
+                unsigned a = polygon[i].lineIn, b = polygon[i].lineOut;
+                ContactManifold::Point &point = candidates[kept++];
+                point.feature = faces | (a < b ? a : b) << 4 | (a < b ? b : a);
+                point.position = polygon[i].position;
+                point.localPoint = incident.getTransform().transformInverse(point.position);
+                point.penetration = depth;
+                point.age = 0;
+            }
+            keepPoints(manifold, candidates, kept);
+        }
+
+        /**
+         * Reduces the candidate points to at most four and makes them
+         * the points of the manifold. Candidates with the id of an
+         * old point take over its age.
+         */
+        static void keepPoints(ContactManifold &manifold,
+                               ContactManifold::Point *candidates,
+                               unsigned count)
+        {
+            unsigned chosen[ContactManifold::MAX_POINTS];
+            unsigned chosenCount = reduce(candidates, count, manifold.normal, chosen);
+
+            ContactManifold::Point points[ContactManifold::MAX_POINTS];
+            for (unsigned i = 0; i < chosenCount; i++)
+            {
+                points[i] = candidates[chosen[i]];
+                for (unsigned j = 0; j < manifold.pointCount; j++)
+                {
+                    if (manifold.points[j].feature == points[i].feature)
+                    {
+                        points[i].age = manifold.points[j].age + 1;
+                        break;
+                    }
+                }
+            }
+            for (unsigned i = 0; i < chosenCount; i++) manifold.points[i] = points[i];
+            manifold.pointCount = chosenCount;
+        }
+
+        /**
+         * Chooses up to four of the points that cover the largest
+         * area: the deepest point, the point furthest from it, the
+         * point that makes the largest triangle with those two, and
+         * the point furthest outside that triangle. Writes the
+         * indices of the chosen points and returns how many there
+         * are.
+         */
+        static unsigned reduce(const ContactManifold::Point *points,
+                               unsigned count, const Vector3 &normal,
+                               unsigned *chosen)
+        {
+            if (count <= (unsigned)ContactManifold::MAX_POINTS)
+            {
+                for (unsigned i = 0; i < count; i++) chosen[i] = i;
+                return count;
+            }
+
+            unsigned a = 0;
+            for (unsigned i = 1; i < count; i++)
+            {
+                if (points[i].penetration > points[a].penetration) a = i;
+            }
+
+            unsigned b = a == 0 ? 1 : 0;
+            real bestDistance = -1;
+            for (unsigned i = 0; i < count; i++)
+            {
+                if (i == a) continue;
+                real distance = (points[i].position - points[a].position).squareMagnitude();
+                if (distance > bestDistance)
+                {
+                    bestDistance = distance;
+                    b = i;
+                }
+            }
+
+            // Signed areas are measured around the normal, so the
+            // triangle a, b, c is wound the same way whichever side
+            // of ab the third point is on.
+            unsigned c = count;
+            real bestArea = 0;
+            bool flip = false;
+            for (unsigned i = 0; i < count; i++)
+            {
+                if (i == a || i == b) continue;
+                real area = ((points[b].position - points[a].position) %
+                    (points[i].position - points[a].position)) * normal;
+                if (c == count || real_abs(area) > bestArea)
+                {
+                    bestArea = real_abs(area);
+                    flip = area < 0;
+                    c = i;
+                }
+            }
+            if (flip)
+            {
+                unsigned swap = a; a = b; b = swap;
+            }
+
+            // The fourth point is the one that adds most area beyond
+            // one of the edges of the triangle.
+            const unsigned triangle[3] = { a, b, c };
+            unsigned d = count;
+            real bestOutside = 0;
+            for (unsigned i = 0; i < count; i++)
+            {
+                if (i == a || i == b || i == c) continue;
+                for (unsigned e = 0; e < 3; e++)
+                {
+                    const Vector3 &start = points[triangle[e]].position;
+                    const Vector3 &end = points[triangle[(e + 1) % 3]].position;
+                    real outside = -(((end - start) % (points[i].position - start)) * normal);
+                    if (outside > bestOutside)
+                    {
+                        bestOutside = outside;
+                        d = i;
+                    }
+                }
+            }
+
+            chosen[0] = a;
+            chosen[1] = b;
+            chosen[2] = c;
+            if (d == count) return 3;
+            chosen[3] = d;
+            return 4;
+        }
+
+        /**
+         * Writes the points of the manifold into the collision data,
+         * stopping if it runs out of room.
+         */
+        static unsigned writeContacts(const ContactManifold &manifold,
+                                      RigidBody *first, RigidBody *second,
+                                      CollisionData *data)
+        {
+            unsigned written = 0;
+            for (unsigned i = 0; i < manifold.pointCount; i++)
+            {
+                if (!data->hasMoreContacts()) break;
+
+                Contact *contact = data->contacts;
+                contact->contactPoint = manifold.points[i].position;
+                contact->contactNormal = manifold.normal;
+                contact->penetration = manifold.points[i].penetration;
+                contact->setBodyData(first, second,
+                    data->friction, data->restitution);
+                data->addContacts(1);
+                written++;
+            }
+            return written;
+        }
+    };
+
+} // namespace cyclone
+
+#endif // CYCLONE_MANIFOLD_H
@@ -29,7 +29,11 @@
 
 namespace cyclone {
 
-#if 0
+/*
+ * Define CYCLONE_SINGLE_PRECISION when building to use single
+ * precision. Double precision is used otherwise.
+ */
+#if defined(CYCLONE_SINGLE_PRECISION)
     /**
      * Defines we're in single precision mode, for any code
      * that needs to be conditionally compiled.
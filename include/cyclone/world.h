@@ -19,8 +19,14 @@
 #ifndef CYCLONE_WORLD_H
 #define CYCLONE_WORLD_H
 
+#include <vector>
+#include <unordered_map>
+
 #include "body.h"
 #include "contacts.h"
+#include "impulse.h"
+#include "collide_coarse.h"
+#include "ccd.h"
 
 namespace cyclone {
     /**
@@ -30,6 +36,11 @@ namespace cyclone {
      */
     class World
     {
+    public:
+        typedef std::vector<RigidBody*> RigidBodies;
+        typedef std::vector<ContactGenerator*> ContactGenerators;
+
+    protected:
         // ... other World data as before ...
         /**
          * True if the world should calculate the number of iterations
@@ -38,18 +49,16 @@ namespace cyclone {
         bool calculateIterations;
 
         /**
-         * Holds a single rigid body in a linked list of bodies.
+         * Holds the state of the bodies this world owns in contiguous
+         * arrays. Bodies created in this store are integrated in a
+         * single pass over the arrays.
          */
-        struct BodyRegistration
-        {
-            RigidBody *body;
-            BodyRegistration * next;
-        };
+        RigidBodyStore store;
 
         /**
-         * Holds the head of the list of registered bodies.
+         * Holds the registered bodies.
          */
-        BodyRegistration *firstBody;
+        RigidBodies bodies;
 
         /**
          * Holds the resolver for sets of contacts.
@@ -57,18 +66,26 @@ namespace cyclone {
         ContactResolver resolver;
 
         /**
-         * Holds one contact generators in a linked list.
+         * Holds the contact generators.
          */
-        struct ContactGenRegistration
-        {
-            ContactGenerator *gen;
-            ContactGenRegistration *next;
-        };
+        ContactGenerators contactGenerators;
+
+        /**
+         * True if contacts are resolved by the impulse resolver
+         * rather than the contact resolver.
+         */
+        bool impulseResolution;
 
         /**
-         * Holds the head of the list of contact generators.
+         * Holds the warm-started impulse resolver.
          */
-        ContactGenRegistration *firstContactGen;
+        ImpulseContactResolver impulseResolver;
+
+        /**
+         * Holds the continuous collision pass run around integration,
+         * or NULL if there is none.
+         */
+        ContinuousCollision *continuousCollision;
 
         /**
          * Holds an array of contacts, for filling by the contact
@@ -82,6 +99,135 @@ namespace cyclone {
          */
         unsigned maxContacts;
 
+        /**
+         * Holds the duration of each step run by runFixedSteps.
+         */
+        real fixedStep;
+
+        /**
+         * Holds the most steps that a single call to runFixedSteps
+         * will run.
+         */
+        unsigned maxSubsteps;
+
+        /**
+         * Holds the frame time that has not been simulated yet.
+         */
+        real accumulator;
+
+        /**
+         * Holds how far between the previous and current body state
+         * the render should be drawn, in the range [0, 1].
+         */
+        real interpolationAlpha;
+
+        /**
+         * Holds the position and orientation of a body before the
+         * last fixed step was run.
+         */
+        struct BodyState
+        {
+            const RigidBody *body;
+            Vector3 position;
+            Quaternion orientation;
+        };
+
+        /**
+         * Holds the state before the last fixed step of the registered
+         * bodies in this world's store, indexed by their store handle.
+         * Entries without a registered body have a NULL body.
+         */
+        std::vector<BodyState> previousStates;
+
+        /**
+         * Holds the state before the last fixed step of the registered
+         * bodies from other stores, whose handles can't index
+         * previousStates.
+         */
+        std::unordered_map<const RigidBody*, BodyState> foreignStates;
+
+        /**
+         * Records the current state of every registered body into
+         * previousStates and foreignStates.
+         */
+        void saveBodyStates()
+        {
+            previousStates.clear();
+            foreignStates.clear();
+            for (RigidBodies::iterator b = bodies.begin(); b != bodies.end(); b++)
+            {
+                BodyState state;
+                state.body = *b;
+                state.position = (*b)->getPosition();
+                state.orientation = (*b)->getOrientation();
+
+                if ((*b)->getStore() != &store)
+                {
+                    foreignStates[*b] = state;
+                    continue;
+                }
+
+                BodyHandle handle = (*b)->getHandle();
+                if (handle >= previousStates.size())
+                {
+                    BodyState unused;
+                    unused.body = 0;
+                    previousStates.resize(handle + 1, unused);
+                }
+                previousStates[handle] = state;
+            }
+        }
+
+        /**
+         * Returns the state saved for the given body before the last
+         * fixed step, or NULL if it wasn't registered then.
+         */
+        const BodyState* findPreviousState(const RigidBody *body) const
+        {
+            if (body->getStore() != &store)
+            {
+                std::unordered_map<const RigidBody*, BodyState>::const_iterator
+                    found = foreignStates.find(body);
+                return found != foreignStates.end() ? &found->second : 0;
+            }
+
+            BodyHandle handle = body->getHandle();
+            if (handle >= previousStates.size()) return 0;
+            if (previousStates[handle].body != body) return 0;
+            return &previousStates[handle];
+        }
+
+        /**
+         * Holds a body registered with the broadphase, with the half
+         * size of a box that encloses it in any orientation.
+         */
+        struct BroadphaseBody
+        {
+            RigidBody *body;
+            Vector3 halfSize;
+            unsigned proxy;
+        };
+
+        /**
+         * Holds the broadphase used by this world, or NULL.
+         */
+        Broadphase *broadphase;
+
+        /**
+         * Holds the bodies registered with the broadphase.
+         */
+        std::vector<BroadphaseBody> broadphaseBodies;
+
+        /**
+         * Returns the current bounding box of a registered body.
+         */
+        static BoundingBox getBroadphaseBox(const BroadphaseBody &entry)
+        {
+            Vector3 position = entry.body->getPosition();
+            return BoundingBox(position - entry.halfSize,
+                               position + entry.halfSize);
+        }
+
     public:
         /**
          * Creates a new simulator that can handle up to the given
@@ -112,8 +258,375 @@ namespace cyclone {
          */
         void startFrame();
 
+        /**
+         * Returns the store that holds the state of this world's
+         * bodies. Create bodies with RigidBody(&world.getBodyStore())
+         * so that they are integrated with the rest of the store.
+         * Every body in the store is simulated, whether or not it is
+         * registered.
+         */
+        RigidBodyStore& getBodyStore()
+        {
+            return store;
+        }
+
+        /**
+         * Sets the pool that body integration, the derived data
+         * rebuild in startFrame and contact resolution are split
+         * across. With a pool, contacts are resolved island by island
+         * (see ContactResolver::resolveContactIslands). The results
+         * are the same for any number of threads. NULL runs
+         * everything on the calling thread. The world doesn't own the
+         * pool.
+         */
+        void setJobPool(JobPool *pool)
+        {
+            store.setJobPool(pool);
+            resolver.setJobPool(pool);
+        }
+
+        /**
+         * Returns the pool used for body integration, or NULL.
+         */
+        JobPool* getJobPool() const
+        {
+            return store.getJobPool();
+        }
+
+        /**
+         * Sets whether contacts are resolved by the warm-started
+         * ImpulseContactResolver rather than the ContactResolver.
+         * The impulse resolver uses its own iteration count, set
+         * through getImpulseResolver. Its impulse cache is cleared
+         * when it is switched on.
+         */
+        void setImpulseResolution(bool enabled)
+        {
+            if (enabled && !impulseResolution) impulseResolver.getCache().clear();
+            impulseResolution = enabled;
+        }
+
+        /**
+         * Returns true if contacts are resolved by the impulse
+         * resolver.
+         */
+        bool getImpulseResolution() const
+        {
+            return impulseResolution;
+        }
+
+        /**
+         * Returns the impulse resolver, so its settings can be
+         * changed.
+         */
+        ImpulseContactResolver& getImpulseResolver()
+        {
+            return impulseResolver;
+        }
+
+        /**
+         * Sets the continuous collision pass to run around the
+         * integration of each step, or NULL to run none. The pass
+         * sweeps the bodies registered with it. The world doesn't
+         * own the pass.
+         */
+        void setContinuousCollision(ContinuousCollision *pass)
+        {
+            continuousCollision = pass;
+        }
+
+        ContinuousCollision* getContinuousCollision() const
+        {
+            return continuousCollision;
+        }
+
+        /**
+         * Returns the registered bodies. Bodies from other stores
+         * must be registered to be simulated; they are integrated one
+         * at a time.
+         */
+        RigidBodies& getBodies()
+        {
+            return bodies;
+        }
+
+        /**
+         * Returns the registered contact generators.
+         */
+        ContactGenerators& getContactGenerators()
+        {
+            return contactGenerators;
+        }
+
+        /**
+         * Sets the broadphase this world uses to find potential
+         * contacts, for example a DynamicAABBTree or a SweepAndPrune.
+         * Bodies already registered are moved from the old broadphase
+         * to the new one. The world doesn't own the broadphase.
+         */
+        void setBroadphase(Broadphase *newBroadphase)
+        {
+            for (unsigned i = 0; i < broadphaseBodies.size(); i++)
+            {
+                BroadphaseBody &entry = broadphaseBodies[i];
+                if (broadphase) broadphase->remove(entry.proxy);
+                if (newBroadphase)
+                {
+                    entry.proxy = newBroadphase->insert(
+                        entry.body, getBroadphaseBox(entry));
+                }
+            }
+            broadphase = newBroadphase;
+        }
+
+        /**
+         * Returns the broadphase this world uses, or NULL.
+         */
+        Broadphase* getBroadphase() const
+        {
+            return broadphase;
+        }
+
+        /**
+         * Registers the given body with the broadphase. The half size
+         * gives a box around the body's position that encloses its
+         * collision geometry in any orientation. A body can only be
+         * registered with one world's broadphase at a time.
+         */
+        void addBroadphaseBody(RigidBody *body, const Vector3 &halfSize)
+        {
+            BroadphaseBody entry;
+            entry.body = body;
+            entry.halfSize = halfSize;
+            entry.proxy = 0;
+            if (broadphase)
+            {
+                entry.proxy = broadphase->insert(body, getBroadphaseBox(entry));
+            }
+            body->broadphaseEntry = (unsigned)broadphaseBodies.size();
+            broadphaseBodies.push_back(entry);
+        }
+
+        /**
+         * Removes the given body from the broadphase.
+         */
+        void removeBroadphaseBody(RigidBody *body)
+        {
+            unsigned i = body->broadphaseEntry;
+            if (i >= broadphaseBodies.size()) return;
+            if (broadphaseBodies[i].body != body) return;
+
+            if (broadphase) broadphase->remove(broadphaseBodies[i].proxy);
+            broadphaseBodies[i] = broadphaseBodies.back();
+            broadphaseBodies[i].body->broadphaseEntry = i;
+            broadphaseBodies.pop_back();
+            body->broadphaseEntry = RigidBody::NO_BROADPHASE_ENTRY;
+        }
+
+        /**
+         * Updates the broadphase with the current positions of the
+         * registered bodies, then writes the pairs of bodies that may
+         * be in contact to the given array (up to the given limit).
+         * The pairs can be handed to CollisionDetector with the
+         * bodies' collision primitives. The duration of the coming
+         * step lets the broadphase allow for the bodies' motion.
+         * Returns the number of pairs written.
+         */
+        unsigned getPotentialContacts(PotentialContact *contacts,
+                                      unsigned limit, real duration = 0)
+        {
+            if (!broadphase) return 0;
+
+            for (unsigned i = 0; i < broadphaseBodies.size(); i++)
+            {
+                const BroadphaseBody &entry = broadphaseBodies[i];
+                broadphase->update(entry.proxy, getBroadphaseBox(entry),
+                    entry.body->getVelocity() * duration);
+            }
+            return broadphase->getPotentialContacts(contacts, limit);
+        }
+
+        /**
+         * Sets the step used by runFixedSteps, and the most steps it
+         * may run for a single frame.
+         */
+        void setFixedTimestep(real step, unsigned maxSubsteps = 8)
+        {
+            fixedStep = step;
+            World::maxSubsteps = maxSubsteps;
+        }
+
+        /**
+         * Adds the given frame duration to the time accumulator and
+         * then runs startFrame and runPhysics with the fixed step
+         * until the accumulator holds less than one step. Returns
+         * the number of steps that were run.
+         *
+         * If the frame needs more than maxSubsteps steps, the
+         * remaining time is thrown away, so a slow frame can never
+         * cost more than maxSubsteps steps. Since startFrame is
+         * called for each step, forces must be applied by force
+         * generators rather than before this call.
+         */
+        unsigned runFixedSteps(real frameDuration)
+        {
+            if (frameDuration > 0) accumulator += frameDuration;
+
+            // Work out how many steps to run, and drop any backlog
+            // beyond the budget.
+            unsigned steps = (unsigned)(accumulator / fixedStep);
+            if (steps > maxSubsteps)
+            {
+                steps = maxSubsteps;
+                accumulator = fixedStep * steps;
+            }
+
+            for (unsigned i = 0; i < steps; i++)
+            {
+                // Interpolation only needs the state before the last step.
+                if (i == steps - 1) saveBodyStates();
+
+                startFrame();
+                runPhysics(fixedStep);
+                accumulator -= fixedStep;
+            }
+
+            if (accumulator < 0) accumulator = 0;
+            interpolationAlpha = accumulator / fixedStep;
+            if (interpolationAlpha > 1) interpolationAlpha = 1;
+
+            return steps;
+        }
+
+        /**
+         * Returns how far between the previous and current state the
+         * bodies should be drawn after the last call to runFixedSteps.
+         */
+        real getInterpolationAlpha() const
+        {
+            return interpolationAlpha;
+        }
+
+        /**
+         * Fills the given matrix with the transform of the given body,
+         * interpolated between its state before the last fixed step
+         * and its current state. Bodies that were added since then are
+         * given their current transform.
+         */
+        void getInterpolatedTransform(const RigidBody *body,
+                                      Matrix4 *transform) const
+        {
+            Vector3 position = body->getPosition();
+            Quaternion orientation = body->getOrientation();
+
+            const BodyState *prev = findPreviousState(body);
+            if (prev)
+            {
+                real alpha = interpolationAlpha;
+                position = prev->position + (position - prev->position) * alpha;
+
+                // Blend along the shortest arc, then renormalise.
+                real dot = prev->orientation.r*orientation.r +
+                    prev->orientation.i*orientation.i +
+                    prev->orientation.j*orientation.j +
+                    prev->orientation.k*orientation.k;
+                real sign = (dot < 0) ? (real)-1.0 : (real)1.0;
+                orientation = Quaternion(
+                    prev->orientation.r + (sign*orientation.r - prev->orientation.r) * alpha,
+                    prev->orientation.i + (sign*orientation.i - prev->orientation.i) * alpha,
+                    prev->orientation.j + (sign*orientation.j - prev->orientation.j) * alpha,
+                    prev->orientation.k + (sign*orientation.k - prev->orientation.k) * alpha
+                    );
+                orientation.normalise();
+            }
+
+            transform->setOrientationAndPos(orientation, position);
+        }
+
     };
 
+    inline World::World(unsigned maxContacts, unsigned iterations)
+        : resolver(iterations), impulseResolution(false),
+          continuousCollision(0), maxContacts(maxContacts),
+          fixedStep(((real)1.0)/((real)60.0)), maxSubsteps(8),
+          accumulator(0), interpolationAlpha(0), broadphase(0)
+    {
+        contacts = new Contact[maxContacts];
+        calculateIterations = (iterations == 0);
+    }
+
+    inline World::~World()
+    {
+        delete[] contacts;
+    }
+
+    inline void World::startFrame()
+    {
+        store.clearAccumulators();
+        store.calculateDerivedData();
+
+        for (RigidBodies::iterator b = bodies.begin(); b != bodies.end(); b++)
+        {
+            if ((*b)->getStore() == &store) continue;
+            (*b)->clearAccumulators();
+            (*b)->calculateDerivedData();
+        }
+    }
+
+    inline unsigned World::generateContacts()
+    {
+        unsigned limit = maxContacts;
+        Contact *nextContact = contacts;
+
+        for (ContactGenerators::iterator g = contactGenerators.begin();
+            g != contactGenerators.end(); g++)
+        {
+            unsigned used = (*g)->addContact(nextContact, limit);
+            limit -= used;
+            nextContact += used;
+
+            // We've run out of contacts to fill. This means we're missing
+            // contacts.
+            if (limit <= 0) break;
+        }
+
+        // Return the number of contacts used.
+        return maxContacts - limit;
+    }
+
+    inline void World::runPhysics(real duration)
+    {
+        // Integrate the bodies, stopping fast ones at the first
+        // target they hit on the way.
+        if (continuousCollision) continuousCollision->beginStep();
+        store.integrate(duration);
+        for (RigidBodies::iterator b = bodies.begin(); b != bodies.end(); b++)
+        {
+            if ((*b)->getStore() != &store) (*b)->integrate(duration);
+        }
+        if (continuousCollision) continuousCollision->endStep();
+
+        // Generate contacts
+        unsigned usedContacts = generateContacts();
+
+        // And process them
+        if (impulseResolution)
+        {
+            impulseResolver.resolveContacts(contacts, usedContacts, duration);
+            return;
+        }
+
+        if (calculateIterations) resolver.setIterations(usedContacts * 4);
+        if (resolver.getJobPool())
+        {
+            resolver.resolveContactIslands(contacts, usedContacts, duration);
+        }
+        else
+        {
+            resolver.resolveContacts(contacts, usedContacts, duration);
+        }
+    }
+
 } // namespace cyclone
 
 #endif // CYCLONE_PWORLD_H
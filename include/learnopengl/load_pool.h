@@ -0,0 +1,104 @@
+#ifndef LOAD_POOL_H
+#define LOAD_POOL_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <chrono>
+using namespace std;
+
+// a small pool of worker threads for asset decoding (model import, image decoding). Workers never
+// touch OpenGL: they hand their results back through futures, and the thread that owns the GL
+// context creates the GL objects.
+class LoadPool
+{
+public:
+    // threadCount 0 uses one worker per hardware thread, leaving one for the thread driving GL.
+    explicit LoadPool(unsigned int threadCount = 0) : stopping(false)
+    {
+        if(threadCount == 0)
+        {
+            unsigned int hardware = thread::hardware_concurrency();
+            threadCount = hardware > 1 ? hardware - 1 : 1;
+        }
+        for(unsigned int i = 0; i < threadCount; i++)
+            workers.push_back(thread(&LoadPool::work, this));
+    }
+
+    // finishes the queued tasks, then joins the workers
+    ~LoadPool()
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(unsigned int i = 0; i < workers.size(); i++)
+            workers[i].join();
+    }
+
+    // queues task on a worker. The future holds its result (or the exception it threw).
+    template<typename F>
+    future<typename result_of<F()>::type> submit(F task)
+    {
+        typedef typename result_of<F()>::type Result;
+        shared_ptr<packaged_task<Result()> > job = make_shared<packaged_task<Result()> >(task);
+        future<Result> result = job->get_future();
+        {
+            lock_guard<mutex> guard(lock);
+            tasks.push([job]() { (*job)(); });
+        }
+        wake.notify_one();
+        return result;
+    }
+
+    unsigned int size() const { return (unsigned int)workers.size(); }
+
+    // the pool models load on unless they are given another one
+    static LoadPool &shared()
+    {
+        static LoadPool pool;
+        return pool;
+    }
+
+private:
+    vector<thread> workers;
+    queue<function<void()> > tasks;
+    mutex lock;
+    condition_variable wake;
+    bool stopping;
+
+    void work()
+    {
+        for(;;)
+        {
+            function<void()> task;
+            {
+                unique_lock<mutex> guard(lock);
+                wake.wait(guard, [this]() { return stopping || !tasks.empty(); });
+                if(tasks.empty())
+                    return;
+                task = move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+    LoadPool(const LoadPool &);
+    LoadPool &operator=(const LoadPool &);
+};
+
+// true once f has its result, without waiting for it
+template<typename T>
+bool IsReady(future<T> const &f)
+{
+    return f.wait_for(chrono::seconds(0)) == future_status::ready;
+}
+#endif
@@ -5,6 +5,8 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/type_precision.hpp>
 
 #include <learnopengl/shader.h>
 
@@ -13,6 +15,7 @@
 #include <sstream>
 #include <iostream>
 #include <vector>
+#include <cstring>
 using namespace std;
 
 struct Vertex {
@@ -34,6 +37,96 @@ struct Texture {
     string path;
 };
 
+// how a Mesh lays out its vertex buffer. The attribute locations stay the same in every format, but the
+// packed formats drop the bitangent (location 4): the tangent at location 3 is a vec4 whose w is the
+// handedness, and shaders rebuild the bitangent as cross(normal, tangent.xyz) * sign(tangent.w). Quantized
+// positions come in with w = 0, float positions with w = 1, so shaders can tell them apart without a uniform.
+enum VertexFormat {
+    VERTEX_FORMAT_FULL,         // struct Vertex as it is, 56 bytes
+    VERTEX_FORMAT_PACKED,       // struct PackedVertex, 24 bytes
+    VERTEX_FORMAT_QUANTIZED     // struct QuantizedVertex, 20 bytes
+};
+
+// float position, 10-10-10-2 normal and tangent (the tangent's 2 bits hold the handedness), half float texCoords
+struct PackedVertex {
+    glm::vec3 Position;
+    glm::uint32 Normal;
+    glm::uint32 Tangent;
+    glm::uint32 TexCoords;
+};
+
+// PackedVertex with the position stored as 16 bit fractions of the mesh bounds. The fourth component pads the
+// position to 8 bytes and is always 0, which marks the position as quantized; the shader gets the bounds
+// through the positionOffset and positionScale uniforms.
+struct QuantizedVertex {
+    glm::u16vec4 Position;
+    glm::uint32 Normal;
+    glm::uint32 Tangent;
+    glm::uint32 TexCoords;
+};
+
+// bytes per vertex in format
+inline size_t VertexStride(VertexFormat format)
+{
+    if(format == VERTEX_FORMAT_PACKED)
+        return sizeof(PackedVertex);
+    if(format == VERTEX_FORMAT_QUANTIZED)
+        return sizeof(QuantizedVertex);
+    return sizeof(Vertex);
+}
+
+// the offset and scale that map the 0..1 range of quantized positions onto the bounds of the given positions
+inline void QuantizationBounds(const glm::vec3 &minimum, const glm::vec3 &maximum, glm::vec3 &offset, glm::vec3 &scale)
+{
+    offset = minimum;
+    scale = maximum - minimum;
+    // a flat mesh still needs a non-zero scale, or every position would be dequantized onto the offset
+    for(int i = 0; i < 3; i++)
+    {
+        if(scale[i] <= 0.0f)
+            scale[i] = 1.0f;
+    }
+}
+
+// converts count vertices to format and writes them to destination. offset and scale are only used by
+// VERTEX_FORMAT_QUANTIZED, see QuantizationBounds().
+inline void PackVertices(VertexFormat format, const Vertex *source, size_t count, void *destination, const glm::vec3 &offset, const glm::vec3 &scale)
+{
+    if(format == VERTEX_FORMAT_FULL)
+    {
+        memcpy(destination, source, count * sizeof(Vertex));
+        return;
+    }
+    unsigned char *out = (unsigned char *)destination;
+    size_t stride = VertexStride(format);
+    for(size_t i = 0; i < count; i++, out += stride)
+    {
+        const Vertex &vertex = source[i];
+        // the handedness of the tangent frame is all that's left of the bitangent
+        float handedness = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+        glm::uint32 normal = glm::packSnorm3x10_1x2(glm::vec4(vertex.Normal, 0.0f));
+        glm::uint32 tangent = glm::packSnorm3x10_1x2(glm::vec4(vertex.Tangent, handedness));
+        glm::uint32 texCoords = glm::packHalf2x16(vertex.TexCoords);
+        if(format == VERTEX_FORMAT_PACKED)
+        {
+            PackedVertex &packed = *(PackedVertex *)out;
+            packed.Position = vertex.Position;
+            packed.Normal = normal;
+            packed.Tangent = tangent;
+            packed.TexCoords = texCoords;
+        }
+        else
+        {
+            QuantizedVertex &quantized = *(QuantizedVertex *)out;
+            glm::vec3 fraction = glm::clamp((vertex.Position - offset) / scale, 0.0f, 1.0f);
+            quantized.Position = glm::u16vec4(glm::round(fraction * 65535.0f), 0.0f);
+            quantized.Normal = normal;
+            quantized.Tangent = tangent;
+            quantized.TexCoords = texCoords;
+        }
+    }
+}
+
 class Mesh {
 public:
     /*  Mesh Data  */
@@ -41,17 +134,103 @@ public:
     vector<unsigned int> indices;
     vector<Texture> textures;
     unsigned int VAO;
+    unsigned int vertexCount;
+    unsigned int indexCount;
+    VertexFormat format;
+    // VERTEX_FORMAT_QUANTIZED: position = positionOffset + stored position * positionScale
+    glm::vec3 positionOffset;
+    glm::vec3 positionScale;
+    // while a mesh made with the streaming constructor is being filled, its buffers are mapped here.
+    // The vertices are in the mesh's format; QuantizationBounds() has to be set before they are written.
+    void *mappedVertices;
+    unsigned int *mappedIndices;
 
     /*  Functions  */
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // constructor. Pass the vectors with std::move to hand their storage over instead of copying it.
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, VertexFormat format = VERTEX_FORMAT_FULL)
+        : format(format), positionOffset(0.0f), positionScale(1.0f), mappedVertices(0), mappedIndices(0)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->textures = std::move(textures);
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size());
+    }
+
+    // constructor for data that is already laid out in memory (e.g. a mapped mesh cache): the data
+    // goes straight into the buffers and no CPU copy is kept, so vertices and indices stay empty; read the
+    // sizes from vertexCount and indexCount.
+    Mesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount, vector<Texture> textures, VertexFormat format = VERTEX_FORMAT_FULL)
+        : format(format), positionOffset(0.0f), positionScale(1.0f), mappedVertices(0), mappedIndices(0)
+    {
+        this->textures = std::move(textures);
+
+        setupMesh(vertexData, vertexCount, indexData, indexCount);
+    }
+
+    // streaming constructor: allocates the buffers for vertexCount vertices and indexCount indices and
+    // maps them at mappedVertices and mappedIndices, so the data can be written in place without a CPU
+    // copy. Any thread may fill them; unmapBuffers() has to be called on the context thread before the
+    // mesh is drawn. No CPU copy is kept, so vertices and indices stay empty; read the sizes from
+    // vertexCount and indexCount.
+    Mesh(size_t vertexCount, size_t indexCount, vector<Texture> textures, VertexFormat format = VERTEX_FORMAT_FULL)
+        : format(format), positionOffset(0.0f), positionScale(1.0f), mappedVertices(0), mappedIndices(0)
+    {
+        this->textures = std::move(textures);
+
+        setupMesh(0, vertexCount, 0, indexCount);
+        mapBuffers();
+    }
+
+    // maps the whole vertex and index buffers for writing; their previous contents are discarded
+    void mapBuffers()
+    {
+        // GL_COPY_WRITE_BUFFER leaves the element buffer binding of the VAO alone
+        GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+        if(vertexCount > 0)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+            mappedVertices = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, vertexCount * VertexStride(format), access);
+        }
+        if(indexCount > 0)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+            mappedIndices = (unsigned int *)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, indexCount * sizeof(unsigned int), access);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    // ends the mapping started by mapBuffers(). Returns false if the driver lost the buffer contents
+    // while they were mapped; the buffers then have to be mapped and filled again.
+    bool unmapBuffers()
+    {
+        bool intact = true;
+        if(mappedVertices)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+            intact = glUnmapBuffer(GL_COPY_WRITE_BUFFER) == GL_TRUE;
+        }
+        if(mappedIndices)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+            intact = glUnmapBuffer(GL_COPY_WRITE_BUFFER) == GL_TRUE && intact;
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        mappedVertices = 0;
+        mappedIndices = 0;
+        return intact;
+    }
+
+    // replaces the contents of the buffers with vertexCount vertices and indexCount indices
+    void uploadData(const Vertex *vertexData, const unsigned int *indexData)
+    {
+        vector<unsigned char> packed = packVertices(vertexData, vertexCount);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, 0, vertexCount * VertexStride(format), format == VERTEX_FORMAT_FULL ? (const void *)vertexData : packed.data());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, 0, indexCount * sizeof(unsigned int), indexData);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
     }
 
     // render the mesh
@@ -83,9 +262,20 @@ public:
             glBindTexture(GL_TEXTURE_2D, textures[i].id);
         }
         
+        // quantized positions are expanded to the mesh bounds in the vertex shader. Other meshes don't read
+        // the bounds, so they skip the lookups.
+        if(format == VERTEX_FORMAT_QUANTIZED)
+        {
+            glUniform3fv(glGetUniformLocation(shader.ID, "positionOffset"), 1, &positionOffset[0]);
+            glUniform3fv(glGetUniformLocation(shader.ID, "positionScale"), 1, &positionScale[0]);
+        }
+        // the disabled bitangent of packed meshes has to read as zero
+        if(format != VERTEX_FORMAT_FULL)
+            glVertexAttrib3f(4, 0.0f, 0.0f, 0.0f);
+
         // draw mesh
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
         glBindVertexArray(0);
 
         // always good practice to set everything back to defaults once configured.
@@ -98,8 +288,11 @@ private:
 
     /*  Functions    */
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount)
     {
+        this->vertexCount = (unsigned int)vertexCount;
+        this->indexCount = (unsigned int)indexCount;
+
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
@@ -110,30 +303,81 @@ private:
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
+        // again translates to 3/2 floats which translates to a byte array. The packed formats are converted first.
+        vector<unsigned char> packed = vertexData ? packVertices(vertexData, vertexCount) : vector<unsigned char>();
+        const void *bufferData = format == VERTEX_FORMAT_FULL || !vertexData ? (const void *)vertexData : packed.data();
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * VertexStride(format), bufferData, GL_STATIC_DRAW);  
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indexData, GL_STATIC_DRAW);
 
         // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);	
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);	
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);	
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        if(format == VERTEX_FORMAT_FULL)
+        {
+            // vertex Positions
+            glEnableVertexAttribArray(0);	
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+            // vertex normals
+            glEnableVertexAttribArray(1);	
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+            // vertex texture coords
+            glEnableVertexAttribArray(2);	
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+            // vertex tangent
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+            // vertex bitangent
+            glEnableVertexAttribArray(4);
+            glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        }
+        else
+        {
+            // PackedVertex and QuantizedVertex only differ in the position, everything after it is laid out the same
+            GLsizei stride = (GLsizei)VertexStride(format);
+            size_t attributes = format == VERTEX_FORMAT_PACKED ? offsetof(PackedVertex, Normal) : offsetof(QuantizedVertex, Normal);
+            // vertex Positions: floats, or 16 bit fractions of the mesh bounds
+            glEnableVertexAttribArray(0);
+            if(format == VERTEX_FORMAT_PACKED)
+                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+            else
+                glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)0);
+            // vertex normals
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)attributes);
+            // vertex tangent, with the handedness in w
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)(attributes + 4));
+            // vertex texture coords
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)(attributes + 8));
+            // no bitangent, it is rebuilt from the normal and tangent. Draw sets the value the disabled
+            // attribute reads to zero, which tells the shader to do so.
+            glDisableVertexAttribArray(4);
+        }
 
         glBindVertexArray(0);
     }
+
+    // converts vertices to the mesh's format. For VERTEX_FORMAT_QUANTIZED this also sets the bounds the positions
+    // are stored in. VERTEX_FORMAT_FULL needs no conversion and returns nothing.
+    vector<unsigned char> packVertices(const Vertex *vertexData, size_t count)
+    {
+        vector<unsigned char> packed;
+        if(format == VERTEX_FORMAT_FULL)
+            return packed;
+        if(format == VERTEX_FORMAT_QUANTIZED && count > 0)
+        {
+            glm::vec3 minimum = vertexData[0].Position, maximum = vertexData[0].Position;
+            for(size_t i = 1; i < count; i++)
+            {
+                minimum = glm::min(minimum, vertexData[i].Position);
+                maximum = glm::max(maximum, vertexData[i].Position);
+            }
+            QuantizationBounds(minimum, maximum, positionOffset, positionScale);
+        }
+        packed.resize(count * VertexStride(format));
+        PackVertices(format, vertexData, count, packed.data(), positionOffset, positionScale);
+        return packed;
+    }
 };
 #endif
@@ -0,0 +1,432 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/mesh.h>
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+// A mesh cache file holds everything Model needs from one source model, already laid out the way
+// it goes into the vertex and element buffers:
+//
+//   MeshCacheHeader | MeshCacheEntry[meshCount] | MeshCacheTexture[textureCount] | string data
+//   | per mesh: Vertex[vertexCount] and unsigned int[indexCount], each starting on a 16 byte boundary
+//
+// All offsets are in bytes from the start of the file. The file is written and read on the same
+// machine, so it is stored in native byte order.
+const uint32_t MESH_CACHE_MAGIC = 0x434D474C; // "LGMC"
+// bump this whenever the layout above or struct Vertex changes; older caches are then rebuilt.
+const uint32_t MESH_CACHE_VERSION = 1;
+
+struct MeshCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexSize;
+    uint32_t importFlags;
+    // size and modification time of the source when the cache was written; if they still match we
+    // skip hashing the source.
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t sourceHash;
+    uint64_t fileSize;
+    uint32_t meshCount;
+    uint32_t textureCount;
+};
+
+struct MeshCacheEntry {
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t firstTexture;
+    uint32_t textureCount;
+};
+
+struct MeshCacheTexture {
+    uint64_t typeOffset;
+    uint64_t pathOffset;
+    uint32_t typeLength;
+    uint32_t pathLength;
+};
+
+// read-only view of a whole file. Uses the OS mapping so a warm load only touches the pages
+// that are actually uploaded.
+class MappedFile
+{
+public:
+    MappedFile() : bytes(0), length(0)
+#ifdef _WIN32
+        , file(INVALID_HANDLE_VALUE), mapping(0)
+#endif
+    {
+    }
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    bool open(string const &path)
+    {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+        if(file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        if(!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+        {
+            close();
+            return false;
+        }
+        mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+        if(!mapping)
+        {
+            close();
+            return false;
+        }
+        bytes = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        length = (size_t)fileSize.QuadPart;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+            return false;
+        struct stat info;
+        if(fstat(fd, &info) != 0 || info.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        void *view = mmap(0, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if(view == MAP_FAILED)
+            return false;
+        bytes = (const unsigned char *)view;
+        length = (size_t)info.st_size;
+#endif
+        if(!bytes)
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if(bytes)
+            UnmapViewOfFile(bytes);
+        if(mapping)
+            CloseHandle(mapping);
+        if(file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        mapping = 0;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if(bytes)
+            munmap((void *)bytes, length);
+#endif
+        bytes = 0;
+        length = 0;
+    }
+
+    const unsigned char *data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char *bytes;
+    size_t length;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+
+    // a mapping has a single owner
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+};
+
+// the binary cache that sits next to a source model (<source>.meshcache). Model opens it before
+// running Assimp and only imports the source when open() says the cache is missing or stale.
+class MeshCache
+{
+public:
+    MeshCache() : header(0) {}
+
+    static string cachePath(string const &sourcePath)
+    {
+        return sourcePath + ".meshcache";
+    }
+
+    // maps the cache of sourcePath and checks it was built from the current source with the same
+    // import flags and vertex layout.
+    bool open(string const &sourcePath, unsigned int importFlags)
+    {
+        header = 0;
+        if(!file.open(cachePath(sourcePath)) || file.size() < sizeof(MeshCacheHeader))
+            return false;
+        const MeshCacheHeader *h = (const MeshCacheHeader *)file.data();
+        if(h->magic != MESH_CACHE_MAGIC || h->version != MESH_CACHE_VERSION || h->vertexSize != sizeof(Vertex)
+            || h->importFlags != importFlags || h->fileSize != file.size())
+            return invalidate();
+
+        // the source stamp is only a shortcut: a copied or touched model still hits the cache as
+        // long as its contents hash the same.
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        if(!statFile(sourcePath, sourceSize, sourceTime) || sourceSize != h->sourceSize)
+            return invalidate();
+        bool restamp = sourceTime != h->sourceTime;
+        if(restamp && hashFile(sourcePath) != h->sourceHash)
+            return invalidate();
+
+        if(!checkTables(h))
+            return invalidate();
+        header = h;
+        // the contents still match, so store the new time and let the next launch skip the hash
+        if(restamp)
+            writeSourceTime(cachePath(sourcePath), sourceTime);
+        return true;
+    }
+
+    void close()
+    {
+        header = 0;
+        file.close();
+    }
+
+    unsigned int meshCount() const { return header->meshCount; }
+
+    const Vertex *vertices(unsigned int mesh) const { return (const Vertex *)(file.data() + entry(mesh).vertexOffset); }
+    unsigned int vertexCount(unsigned int mesh) const { return entry(mesh).vertexCount; }
+    const unsigned int *indices(unsigned int mesh) const { return (const unsigned int *)(file.data() + entry(mesh).indexOffset); }
+    unsigned int indexCount(unsigned int mesh) const { return entry(mesh).indexCount; }
+
+    unsigned int textureCount(unsigned int mesh) const { return entry(mesh).textureCount; }
+    string textureType(unsigned int mesh, unsigned int i) const
+    {
+        const MeshCacheTexture &t = texture(entry(mesh).firstTexture + i);
+        return string((const char *)file.data() + t.typeOffset, t.typeLength);
+    }
+    string texturePath(unsigned int mesh, unsigned int i) const
+    {
+        const MeshCacheTexture &t = texture(entry(mesh).firstTexture + i);
+        return string((const char *)file.data() + t.pathOffset, t.pathLength);
+    }
+
+    // writes the cache for meshes imported from sourcePath. The file is written under a temporary
+    // name first so an interrupted write never leaves a cache that looks valid.
+    static bool write(string const &sourcePath, unsigned int importFlags, vector<Mesh> const &meshes)
+    {
+        MeshCacheHeader h;
+        memset(&h, 0, sizeof(h));
+        h.magic = MESH_CACHE_MAGIC;
+        h.version = MESH_CACHE_VERSION;
+        h.vertexSize = sizeof(Vertex);
+        h.importFlags = importFlags;
+        if(!statFile(sourcePath, h.sourceSize, h.sourceTime))
+            return false;
+        h.sourceHash = hashFile(sourcePath);
+        h.meshCount = (uint32_t)meshes.size();
+
+        // lay out the tables and string data first, then the buffers
+        vector<MeshCacheEntry> entries(meshes.size());
+        vector<MeshCacheTexture> textures;
+        string strings;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            entries[i].firstTexture = (uint32_t)textures.size();
+            entries[i].textureCount = (uint32_t)meshes[i].textures.size();
+            for(unsigned int j = 0; j < meshes[i].textures.size(); j++)
+            {
+                MeshCacheTexture t;
+                t.typeOffset = strings.size();
+                t.typeLength = (uint32_t)meshes[i].textures[j].type.size();
+                strings += meshes[i].textures[j].type;
+                t.pathOffset = strings.size();
+                t.pathLength = (uint32_t)meshes[i].textures[j].path.size();
+                strings += meshes[i].textures[j].path;
+                textures.push_back(t);
+            }
+        }
+        h.textureCount = (uint32_t)textures.size();
+
+        uint64_t stringsOffset = sizeof(MeshCacheHeader) + entries.size() * sizeof(MeshCacheEntry) + textures.size() * sizeof(MeshCacheTexture);
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            textures[i].typeOffset += stringsOffset;
+            textures[i].pathOffset += stringsOffset;
+        }
+        uint64_t offset = align(stringsOffset + strings.size());
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            entries[i].vertexOffset = offset;
+            entries[i].vertexCount = (uint32_t)meshes[i].vertices.size();
+            offset = align(offset + meshes[i].vertices.size() * sizeof(Vertex));
+            entries[i].indexOffset = offset;
+            entries[i].indexCount = (uint32_t)meshes[i].indices.size();
+            offset = align(offset + meshes[i].indices.size() * sizeof(unsigned int));
+        }
+        h.fileSize = offset;
+
+        string path = cachePath(sourcePath);
+        string temporary = path + ".tmp";
+        FILE *out = fopen(temporary.c_str(), "wb");
+        if(!out)
+            return false;
+        bool ok = fwrite(&h, sizeof(h), 1, out) == 1;
+        if(!entries.empty())
+            ok = ok && fwrite(&entries[0], sizeof(MeshCacheEntry), entries.size(), out) == entries.size();
+        if(!textures.empty())
+            ok = ok && fwrite(&textures[0], sizeof(MeshCacheTexture), textures.size(), out) == textures.size();
+        ok = ok && fwrite(strings.data(), 1, strings.size(), out) == strings.size();
+        ok = ok && pad(out, stringsOffset + strings.size());
+        for(unsigned int i = 0; ok && i < meshes.size(); i++)
+        {
+            const vector<Vertex> &v = meshes[i].vertices;
+            const vector<unsigned int> &n = meshes[i].indices;
+            ok = fwrite(v.data(), sizeof(Vertex), v.size(), out) == v.size()
+                && pad(out, entries[i].vertexOffset + v.size() * sizeof(Vertex))
+                && fwrite(n.data(), sizeof(unsigned int), n.size(), out) == n.size()
+                && pad(out, entries[i].indexOffset + n.size() * sizeof(unsigned int));
+        }
+        ok = (fclose(out) == 0) && ok;
+
+        if(ok)
+        {
+            remove(path.c_str());
+            ok = rename(temporary.c_str(), path.c_str()) == 0;
+        }
+        if(!ok)
+        {
+            remove(temporary.c_str());
+            cout << "ERROR::MESH_CACHE::WRITE_FAILED: " << path << endl;
+        }
+        return ok;
+    }
+
+    static bool statFile(string const &path, uint64_t &size, int64_t &time)
+    {
+        struct stat info;
+        if(stat(path.c_str(), &info) != 0)
+            return false;
+        size = (uint64_t)info.st_size;
+        time = (int64_t)info.st_mtime;
+        return true;
+    }
+
+    // 64-bit FNV-1a over the file contents
+    static uint64_t hashFile(string const &path)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        FILE *in = fopen(path.c_str(), "rb");
+        if(!in)
+            return 0;
+        unsigned char buffer[65536];
+        size_t count;
+        while((count = fread(buffer, 1, sizeof(buffer), in)) > 0)
+        {
+            for(size_t i = 0; i < count; i++)
+            {
+                hash ^= buffer[i];
+                hash *= 1099511628211ULL;
+            }
+        }
+        fclose(in);
+        return hash;
+    }
+
+private:
+    MappedFile file;
+    const MeshCacheHeader *header;
+
+    const MeshCacheEntry &entry(unsigned int mesh) const
+    {
+        return ((const MeshCacheEntry *)(file.data() + sizeof(MeshCacheHeader)))[mesh];
+    }
+
+    const MeshCacheTexture &texture(unsigned int i) const
+    {
+        return ((const MeshCacheTexture *)(file.data() + sizeof(MeshCacheHeader) + header->meshCount * sizeof(MeshCacheEntry)))[i];
+    }
+
+    // overwrites just the sourceTime field of a cache header. A failed write only costs another
+    // hash on the next launch, so it is not reported.
+    static void writeSourceTime(string const &path, int64_t sourceTime)
+    {
+        FILE *out = fopen(path.c_str(), "r+b");
+        if(!out)
+            return;
+        if(fseek(out, (long)offsetof(MeshCacheHeader, sourceTime), SEEK_SET) == 0)
+            fwrite(&sourceTime, sizeof(sourceTime), 1, out);
+        fclose(out);
+    }
+
+    bool invalidate()
+    {
+        file.close();
+        return false;
+    }
+
+    // make sure every table entry points inside the file, so a damaged cache is rebuilt instead
+    // of being read out of bounds.
+    bool checkTables(const MeshCacheHeader *h) const
+    {
+        uint64_t size = file.size();
+        uint64_t tables = sizeof(MeshCacheHeader) + (uint64_t)h->meshCount * sizeof(MeshCacheEntry) + (uint64_t)h->textureCount * sizeof(MeshCacheTexture);
+        if(tables > size)
+            return false;
+        const MeshCacheEntry *entries = (const MeshCacheEntry *)(file.data() + sizeof(MeshCacheHeader));
+        const MeshCacheTexture *textures = (const MeshCacheTexture *)(entries + h->meshCount);
+        for(unsigned int i = 0; i < h->meshCount; i++)
+        {
+            const MeshCacheEntry &e = entries[i];
+            if(e.vertexOffset % 16 || e.indexOffset % 16
+                || e.vertexOffset + (uint64_t)e.vertexCount * sizeof(Vertex) > size
+                || e.indexOffset + (uint64_t)e.indexCount * sizeof(unsigned int) > size
+                || (uint64_t)e.firstTexture + e.textureCount > h->textureCount)
+                return false;
+        }
+        for(unsigned int i = 0; i < h->textureCount; i++)
+        {
+            if(textures[i].typeOffset + textures[i].typeLength > size || textures[i].pathOffset + textures[i].pathLength > size)
+                return false;
+        }
+        return true;
+    }
+
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + 15) & ~(uint64_t)15;
+    }
+
+    // writes zeros up to the next 16 byte boundary after position
+    static bool pad(FILE *out, uint64_t position)
+    {
+        static const char zeros[16] = { 0 };
+        size_t count = (size_t)(align(position) - position);
+        return count == 0 || fwrite(zeros, 1, count, out) == count;
+    }
+};
+#endif
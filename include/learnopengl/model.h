@@ -11,6 +11,9 @@
 #include <assimp/postprocess.h>
 
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/load_pool.h>
+#include <learnopengl/texture_cache.h>
 #include <learnopengl/shader.h>
 
 #include <string>
@@ -18,53 +21,225 @@
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <unordered_map>
 #include <vector>
+#include <memory>
+#include <chrono>
+#include <algorithm>
 using namespace std;
 
+// post processing every model is imported with. Part of the mesh cache key, so changing it rebuilds the caches.
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+// the vertices and indices of one mesh, extracted from the ASSIMP scene on a worker thread
+struct MeshData {
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    // bounds of the quantized positions of a streamed mesh
+    glm::vec3 positionOffset;
+    glm::vec3 positionScale;
+};
+
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+// state of a model that is still loading. ASSIMP import, mesh extraction and image decoding run on
+// the pool; everything that touches GL waits for Model::finishLoad() on the context thread.
+struct ModelLoad {
+    string path;
+    LoadPool *pool;
+    chrono::steady_clock::time_point start;
+    // cold path: the importer owns the scene until every mesh has been extracted
+    shared_ptr<Assimp::Importer> importer;
+    future<const aiScene *> scene;
+    vector<const aiMesh *> sourceMeshes;
+    vector<future<MeshData> > meshData;
+    // with Model::streamMeshes: meshes whose mapped buffers the workers write into
+    vector<Mesh> streamed;
+    // warm path: the mapped cache the buffers are uploaded from
+    shared_ptr<MeshCache> cache;
+    // type and path of the textures of each mesh; the ids are filled in once the images are uploaded
+    vector<vector<Texture> > meshTextures;
+    // images being decoded, by path, with the type they were first requested as
+    map<string, pair<string, future<ImageData> > > images;
+};
+
 class Model 
 {
 public:
     /*  Model Data */
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
-    vector<Mesh> meshes;
+    vector<Texture> textures_loaded;	// the textures this model uses, each taken once from the shared TextureCache
+    vector<Mesh> meshes;    // every mesh keeps its vertices and indices, except with streamMeshes; draw counts are in Mesh::vertexCount and indexCount either way
     string directory;
     bool gammaCorrection;
+    bool useCache;          // read and write <path>.meshcache instead of importing with ASSIMP every time
+    bool streamMeshes;      // on an ASSIMP import, let the workers write straight into mapped GL buffers; no CPU copy is kept (Mesh::vertices and indices stay empty) and no cache written
+    VertexFormat vertexFormat;  // layout of the vertex buffers; the packed formats need the shaders that rebuild the bitangent
+    bool loadedFromCache;   // whether the last load came from the mesh cache
+    double loadSeconds;     // time from the start of the load until the model is complete, to compare cold (ASSIMP) and warm (cache) startup
 
     /*  Functions   */
-    // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // constructor, expects a filepath to a 3D model. Decodes on the shared pool and blocks until the model is complete.
+    Model(string const &path, bool gamma = false, bool cache = true) : gammaCorrection(gamma), useCache(cache), streamMeshes(false), vertexFormat(VERTEX_FORMAT_FULL), loadedFromCache(false), loadSeconds(0.0)
     {
         loadModel(path);
     }
 
+    // empty model, to be loaded in the background with startLoad() and finishLoad()
+    Model() : gammaCorrection(false), useCache(true), streamMeshes(false), vertexFormat(VERTEX_FORMAT_FULL), loadedFromCache(false), loadSeconds(0.0)
+    {
+    }
+
     // draws the model, and thus all its meshes
     void Draw(Shader shader)
     {
         for(unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
+
+    // starts loading a model with supported ASSIMP extensions. Importing and decoding run on the pool;
+    // call finishLoad() from the thread that owns the GL context to create the GL objects.
+    void startLoad(string const &path, LoadPool &pool = LoadPool::shared())
+    {
+        load = make_shared<ModelLoad>();
+        load->path = path;
+        load->pool = &pool;
+        load->start = chrono::steady_clock::now();
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        // a valid cache holds exactly what ASSIMP would give us, so skip the import
+        load->cache = make_shared<MeshCache>();
+        loadedFromCache = useCache && load->cache->open(path, MODEL_IMPORT_FLAGS);
+        if(loadedFromCache)
+        {
+            const MeshCache &cache = *load->cache;
+            load->meshTextures.resize(cache.meshCount());
+            for(unsigned int i = 0; i < cache.meshCount(); i++)
+            {
+                for(unsigned int j = 0; j < cache.textureCount(i); j++)
+                    requestTexture(cache.texturePath(i, j), cache.textureType(i, j), load->meshTextures[i]);
+            }
+        }
+        else
+        {
+            load->cache.reset();
+            // read file via ASSIMP
+            load->importer = make_shared<Assimp::Importer>();
+            shared_ptr<Assimp::Importer> importer = load->importer;
+            load->scene = pool.submit([importer, path]() { return importer->ReadFile(path, MODEL_IMPORT_FLAGS); });
+        }
+    }
+
+    // creates the GL objects for whatever the pool has finished decoding. Only blocks when wait is set.
+    // Returns true once the model is complete (or failed to load).
+    bool finishLoad(bool wait = false)
+    {
+        if(!load)
+            return true;
+
+        // the import finished: hand every mesh to the pool and start decoding its textures
+        if(load->scene.valid() && (wait || IsReady(load->scene)))
+        {
+            const aiScene* scene = load->scene.get();
+            // check for errors
+            if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+            {
+                cout << "ERROR::ASSIMP:: " << load->importer->GetErrorString() << endl;
+                load.reset();
+                return true;
+            }
+            // process ASSIMP's root node recursively
+            processNode(scene->mRootNode, scene);
+        }
+
+        // upload the images that are decoded
+        for(map<string, pair<string, future<ImageData> > >::iterator it = load->images.begin(); it != load->images.end(); )
+        {
+            if(!wait && !IsReady(it->second.second))
+            {
+                ++it;
+                continue;
+            }
+            ImageData image = it->second.second.get();
+            string key = textureKey(it->first);
+            addTexture(it->first, it->second.first, TextureCache::shared().insert(key, image, it->first.c_str(), false), key);
+            load->images.erase(it++);
+        }
+
+        // meshes are created once all of them are extracted and all of their textures exist
+        if(load->scene.valid() || !load->images.empty())
+            return false;
+        for(unsigned int i = 0; i < load->meshData.size(); i++)
+        {
+            if(!wait && !IsReady(load->meshData[i]))
+                return false;
+        }
+
+        unsigned int meshCount = (unsigned int)load->meshTextures.size();
+        meshes.reserve(meshes.size() + meshCount);
+        for(unsigned int i = 0; i < meshCount; i++)
+        {
+            vector<Texture> &textures = load->meshTextures[i];
+            for(unsigned int j = 0; j < textures.size(); j++)
+                textures[j].id = findTexture(textures[j].path)->id;
+            if(load->cache)
+            {
+                // copy the data out of the mapped file, so meshes[i].vertices and indices hold the same as
+                // after an ASSIMP import; code that reads them must not depend on where the model came from
+                const MeshCache &cache = *load->cache;
+                const Vertex *vertices = cache.vertices(i);
+                const unsigned int *indices = cache.indices(i);
+                meshes.push_back(Mesh(vector<Vertex>(vertices, vertices + cache.vertexCount(i)),
+                                      vector<unsigned int>(indices, indices + cache.indexCount(i)), textures, vertexFormat));
+            }
+            else if(!load->streamed.empty())
+            {
+                MeshData bounds = load->meshData[i].get();
+                Mesh &mesh = load->streamed[i];
+                mesh.positionOffset = bounds.positionOffset;
+                mesh.positionScale = bounds.positionScale;
+                bool filled = mesh.mappedVertices && mesh.mappedIndices;
+                if(!mesh.unmapBuffers() || !filled)
+                {
+                    // the buffers couldn't be mapped or the driver dropped their contents; upload them from this thread
+                    MeshData data = processMesh(load->sourceMeshes[i]);
+                    mesh.uploadData(data.vertices.data(), data.indices.data());
+                }
+                mesh.textures = textures;
+                meshes.push_back(mesh);
+            }
+            else
+            {
+                // hand the extracted vectors to the mesh instead of copying them
+                MeshData data = load->meshData[i].get();
+                meshes.push_back(Mesh(std::move(data.vertices), std::move(data.indices), textures, vertexFormat));
+            }
+        }
+        if(!load->cache && load->streamed.empty() && useCache)
+            MeshCache::write(load->path, MODEL_IMPORT_FLAGS, meshes);
+
+        loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - load->start).count();
+        load.reset();
+        return true;
+    }
+
+    // whether a load started with startLoad() still needs finishLoad() calls
+    bool isLoading() const
+    {
+        return load != 0;
+    }
     
 private:
+    shared_ptr<ModelLoad> load;
+    unordered_map<string, unsigned int> textureIndex;   // path -> index in textures_loaded
+    shared_ptr<TextureReferences> textureReferences;    // released when the last copy of this model goes away
+
     /*  Functions   */
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    // loads a model and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
-        // read file via ASSIMP
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-        // check for errors
-        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
-        {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
-        }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
-
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        startLoad(path);
+        finishLoad(true);
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -76,7 +251,23 @@ private:
             // the node object only contains indices to index the actual objects in the scene. 
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            // the mesh data is extracted on the pool; the importer is kept alive until every mesh is done
+            shared_ptr<Assimp::Importer> importer = load->importer;
+            if(streamMeshes)
+            {
+                // the buffers are sized and mapped here, the workers write the vertices and indices into them
+                load->streamed.push_back(Mesh(mesh->mNumVertices, countIndices(mesh), vector<Texture>(), vertexFormat));
+                void *vertices = load->streamed.back().mappedVertices;
+                unsigned int *indices = load->streamed.back().mappedIndices;
+                VertexFormat format = vertexFormat;
+                load->meshData.push_back(load->pool->submit([importer, mesh, format, vertices, indices]() {
+                    return streamMesh(mesh, format, vertices, indices);
+                }));
+            }
+            else
+                load->meshData.push_back(load->pool->submit([importer, mesh]() { return processMesh(mesh); }));
+            load->sourceMeshes.push_back(mesh);
+            load->meshTextures.push_back(processMaterial(scene->mMaterials[mesh->mMaterialIndex]));
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
@@ -86,17 +277,81 @@ private:
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    // extracts the vertices and indices of a mesh into vectors of exactly the right size.
+    static MeshData processMesh(const aiMesh *mesh)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        MeshData data;
+        data.vertices.resize(mesh->mNumVertices);
+        data.indices.resize(countIndices(mesh));
+        processMesh(mesh, data.vertices.data(), data.indices.data());
+        return data;
+    }
+
+    // the number of indices of all faces of a mesh
+    static unsigned int countIndices(const aiMesh *mesh)
+    {
+        unsigned int count = 0;
+        for(unsigned int i = 0; i < mesh->mNumFaces; i++)
+            count += mesh->mFaces[i].mNumIndices;
+        return count;
+    }
+
+    // writes the vertices and indices of a mesh to memory sized for mNumVertices vertices and countIndices()
+    // indices. Runs on a worker thread, so it only reads the scene.
+    static void processMesh(const aiMesh *mesh, Vertex *vertices, unsigned int *indices)
+    {
+        processVertices(mesh, 0, mesh->mNumVertices, vertices);
+        processIndices(mesh, indices);
+    }
+
+    // writes a mesh to mapped buffers in the given format. The packed formats are converted in small batches,
+    // so no full size copy of the mesh is made. Returns the bounds of the quantized positions.
+    static MeshData streamMesh(const aiMesh *mesh, VertexFormat format, void *vertices, unsigned int *indices)
+    {
+        MeshData bounds;
+        bounds.positionOffset = glm::vec3(0.0f);
+        bounds.positionScale = glm::vec3(1.0f);
+        if(!vertices || !indices)
+            return bounds;
+        if(format == VERTEX_FORMAT_FULL)
+        {
+            processMesh(mesh, (Vertex *)vertices, indices);
+            return bounds;
+        }
 
+        if(format == VERTEX_FORMAT_QUANTIZED && mesh->mNumVertices > 0)
+        {
+            glm::vec3 minimum(mesh->mVertices[0].x, mesh->mVertices[0].y, mesh->mVertices[0].z), maximum = minimum;
+            for(unsigned int i = 1; i < mesh->mNumVertices; i++)
+            {
+                glm::vec3 position(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+                minimum = glm::min(minimum, position);
+                maximum = glm::max(maximum, position);
+            }
+            QuantizationBounds(minimum, maximum, bounds.positionOffset, bounds.positionScale);
+        }
+
+        const unsigned int batchSize = 256;
+        Vertex batch[batchSize];
+        unsigned char *out = (unsigned char *)vertices;
+        for(unsigned int first = 0; first < mesh->mNumVertices; first += batchSize)
+        {
+            unsigned int count = std::min(batchSize, mesh->mNumVertices - first);
+            processVertices(mesh, first, count, batch);
+            PackVertices(format, batch, count, out + first * VertexStride(format), bounds.positionOffset, bounds.positionScale);
+        }
+        processIndices(mesh, indices);
+        return bounds;
+    }
+
+    // writes count vertices of a mesh, starting at first, to vertices
+    static void processVertices(const aiMesh *mesh, unsigned int first, unsigned int count, Vertex *vertices)
+    {
         // Walk through each of the mesh's vertices
-        for(unsigned int i = 0; i < mesh->mNumVertices; i++)
+        for(unsigned int i = first; i < first + count; i++)
         {
-            Vertex vertex;
+            Vertex &vertex = vertices[i - first];
             glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
             // positions
             vector.x = mesh->mVertices[i].x;
@@ -130,18 +385,26 @@ private:
             vector.y = mesh->mBitangents[i].y;
             vector.z = mesh->mBitangents[i].z;
             vertex.Bitangent = vector;
-            vertices.push_back(vertex);
         }
+    }
+
+    // writes the indices of all faces of a mesh to indices
+    static void processIndices(const aiMesh *mesh, unsigned int *indices)
+    {
         // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
         for(unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
-            aiFace face = mesh->mFaces[i];
-            // retrieve all indices of the face and store them in the indices vector
+            const aiFace &face = mesh->mFaces[i];
+            // retrieve all indices of the face and store them in the indices array
             for(unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);
+                *indices++ = face.mIndices[j];
         }
-        // process materials
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];    
+    }
+
+    // lists the textures of a mesh's material and starts decoding the ones that aren't loaded yet.
+    vector<Texture> processMaterial(aiMaterial *material)
+    {
+        vector<Texture> textures;
         // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
         // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
         // Same applies to other texture as the following list summarizes:
@@ -150,94 +413,86 @@ private:
         // normal: texture_normalN
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", textures);
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", textures);
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", textures);
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-        
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", textures);
+        return textures;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // checks all material textures of a given type and requests the textures that aren't loaded yet.
+    void loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName, vector<Texture> &textures)
     {
-        vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            requestTexture(str.C_Str(), typeName, textures);
         }
-        return textures;
     }
-};
-
-
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
-{
-    string filename = string(path);
-    filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    // adds the texture at path (relative to the model's directory) to textures, and queues it for decoding if it isn't loaded or queued yet.
+    void requestTexture(string const &path, string const &typeName, vector<Texture> &textures)
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
+        Texture texture;
+        texture.id = 0;
+        texture.type = typeName;
+        texture.path = path;
+        textures.push_back(texture);
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        // check if this model already has the texture or is decoding it
+        if(load->images.count(path) || findTexture(path))
+            return;
+        // check if any model loaded the texture before and if so, skip loading a new texture
+        string key = textureKey(path);
+        unsigned int id = TextureCache::shared().acquire(key);
+        if(id != 0)
+        {
+            addTexture(path, typeName, id, key);
+            return;
+        }
+        string directory = this->directory;
+        load->images[path] = make_pair(typeName, load->pool->submit([path, directory]() { return DecodeImage(path.c_str(), directory); }));
+    }
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // the loaded texture with the given path, or null if there is none
+    const Texture *findTexture(string const &path) const
+    {
+        unordered_map<string, unsigned int>::const_iterator it = textureIndex.find(path);
+        return it != textureIndex.end() ? &textures_loaded[it->second] : 0;
+    }
 
-        stbi_image_free(data);
+    // records a texture taken from the cache under key. A texture that failed to load (id 0) holds
+    // no reference.
+    void addTexture(string const &path, string const &typeName, unsigned int id, string const &key)
+    {
+        Texture texture;
+        texture.id = id;
+        texture.type = typeName;
+        texture.path = path;
+        textureIndex[path] = (unsigned int)textures_loaded.size();
+        textures_loaded.push_back(texture);
+        if(id == 0)
+            return;
+        if(!textureReferences)
+            textureReferences = make_shared<TextureReferences>();
+        textureReferences->keys.push_back(key);
     }
-    else
+
+    // the cache key of a texture path relative to the model's directory. Model textures are uploaded linear.
+    string textureKey(string const &path) const
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        return TextureCache::makeKey(directory + '/' + path, false);
     }
+};
 
-    return textureID;
+
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+{
+    ImageData image = DecodeImage(path, directory);
+    return TextureFromImage(image, path, gamma);
 }
 #endif
@@ -0,0 +1,343 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <iostream>
+using namespace std;
+
+// pixels decoded by stb_image, waiting to be uploaded on the thread that owns the GL context
+struct ImageData {
+    unsigned char *data;
+    int width;
+    int height;
+    int nrComponents;
+};
+
+ImageData DecodeImage(const char *path, const string &directory);
+unsigned int TextureFromImage(ImageData &image, const char *path, bool gamma = false);
+
+// counters reported by TextureCache::stats()
+struct TextureCacheStats {
+    unsigned long long hits;        // lookups answered by a texture that was already uploaded
+    unsigned long long misses;      // lookups that had to decode and upload the image
+    unsigned long long evictions;   // unreferenced textures deleted to stay within the budget
+    size_t textures;                // textures currently on the GPU
+    size_t referenced;              // of those, the ones still used by a model
+    size_t bytes;                   // estimated GPU memory of all cached textures, mipmaps included
+    size_t budget;
+};
+
+// process-wide cache of uploaded textures, keyed by canonical path and the flags the texture was
+// uploaded with. Every user takes a reference with acquire() or insert() and gives it back with
+// release(). Textures nobody references stay cached, so a model that is loaded again gets them
+// for free, until the cache grows past its memory budget; then the least recently released ones
+// are deleted first. Like everything that touches GL, the cache may only be used from the
+// thread that owns the context, and the application has to clear() it before it destroys the
+// context.
+class TextureCache
+{
+public:
+    explicit TextureCache(size_t budgetBytes = 256 * 1024 * 1024) : budget(budgetBytes), bytes(0), hits(0), misses(0), evictions(0), cleared(false), generation(0)
+    {
+    }
+
+    // the cache Model uses. It is never destroyed: models released during exit still find it, and
+    // no texture is deleted after the context is gone. Call clear() before destroying the context.
+    static TextureCache &shared()
+    {
+        static TextureCache *cache = new TextureCache();
+        return *cache;
+    }
+
+    // turns path into one spelling per file: forward slashes, no "." segments and no "dir/.."
+    // pairs, so "Model/rock/../planet/a.png" and "Model/planet/a.png" share a texture.
+    static string canonicalPath(string const &path)
+    {
+        string normalized = path;
+        for(unsigned int i = 0; i < normalized.size(); i++)
+        {
+            if(normalized[i] == '\\')
+                normalized[i] = '/';
+        }
+        bool absolute = !normalized.empty() && normalized[0] == '/';
+
+        vector<string> segments;
+        size_t begin = 0;
+        while(begin <= normalized.size())
+        {
+            size_t end = normalized.find('/', begin);
+            if(end == string::npos)
+                end = normalized.size();
+            string segment = normalized.substr(begin, end - begin);
+            if(segment == ".." && !segments.empty() && segments.back() != "..")
+                segments.pop_back();
+            else if(!segment.empty() && segment != ".")
+                segments.push_back(segment);
+            begin = end + 1;
+        }
+
+        string canonical = absolute ? "/" : "";
+        for(unsigned int i = 0; i < segments.size(); i++)
+        {
+            if(i > 0)
+                canonical += '/';
+            canonical += segments[i];
+        }
+        return canonical;
+    }
+
+    // the cache key of the image at path uploaded with the given flags
+    static string makeKey(string const &path, bool gamma)
+    {
+        return canonicalPath(path) + (gamma ? "|srgb" : "|linear");
+    }
+
+    // returns the texture cached under key and takes a reference to it, or 0 if it has to be loaded.
+    unsigned int acquire(string const &key)
+    {
+        unordered_map<string, Entry>::iterator it = entries.find(key);
+        if(it == entries.end())
+        {
+            misses++;
+            return 0;
+        }
+        hits++;
+        addReference(it->second);
+        return it->second.id;
+    }
+
+    // uploads a decoded image under key and takes a reference to it. If the key got cached in the
+    // meantime (two models decoded the same image at once) the image is dropped and the cached
+    // texture used instead. An image that failed to decode is not cached, so the file is read
+    // again the next time it is needed; insert() then returns 0 and takes no reference.
+    unsigned int insert(string const &key, ImageData &image, const char *path, bool gamma)
+    {
+        unordered_map<string, Entry>::iterator it = entries.find(key);
+        if(it != entries.end())
+        {
+            stbi_image_free(image.data);
+            image.data = 0;
+            addReference(it->second);
+            return it->second.id;
+        }
+
+        if(!image.data)
+        {
+            cout << "Texture failed to load at path: " << path << endl;
+            return 0;
+        }
+
+        // uploading means a context is current again
+        cleared = false;
+        Entry entry;
+        // a full mip chain adds a third on top of the base level
+        entry.bytes = (size_t)image.width * image.height * image.nrComponents * 4 / 3;
+        entry.id = TextureFromImage(image, path, gamma);
+        entry.references = 1;
+        entry.cached = false;
+        entries[key] = entry;
+        bytes += entry.bytes;
+        trim();
+        return entry.id;
+    }
+
+    // gives back a reference taken with acquire() or insert(). Does nothing after clear(), so models
+    // destroyed after the context is gone don't call GL.
+    void release(string const &key)
+    {
+        if(cleared)
+            return;
+        unordered_map<string, Entry>::iterator it = entries.find(key);
+        if(it == entries.end() || it->second.references == 0)
+            return;
+        if(--it->second.references == 0)
+        {
+            it->second.unused = unused.insert(unused.end(), key);
+            it->second.cached = true;
+            trim();
+        }
+    }
+
+    void setBudget(size_t budgetBytes)
+    {
+        budget = budgetBytes;
+        trim();
+    }
+
+    size_t getBudget() const
+    {
+        return budget;
+    }
+
+    TextureCacheStats stats() const
+    {
+        TextureCacheStats result;
+        result.hits = hits;
+        result.misses = misses;
+        result.evictions = evictions;
+        result.textures = entries.size();
+        result.referenced = entries.size() - unused.size();
+        result.bytes = bytes;
+        result.budget = budget;
+        return result;
+    }
+
+    // deletes unreferenced textures, least recently released first, until the cache fits its budget.
+    // Referenced textures are never deleted, so the cache can stay over budget while they are in use.
+    // Does nothing after clear().
+    void trim()
+    {
+        if(cleared)
+            return;
+        while(bytes > budget && !unused.empty())
+        {
+            unordered_map<string, Entry>::iterator it = entries.find(unused.front());
+            unused.pop_front();
+            glDeleteTextures(1, &it->second.id);
+            bytes -= it->second.bytes;
+            entries.erase(it);
+            evictions++;
+        }
+    }
+
+    // deletes every cached texture, referenced or not. Must run while the context is still current;
+    // from then on release() and trim() do nothing until the next insert(), so references released
+    // afterwards are ignored and no GL call is made without a context.
+    void clear()
+    {
+        if(cleared)
+            return;
+        for(unordered_map<string, Entry>::iterator it = entries.begin(); it != entries.end(); ++it)
+            glDeleteTextures(1, &it->second.id);
+        entries.clear();
+        unused.clear();
+        bytes = 0;
+        cleared = true;
+        generation++;
+    }
+
+    // goes up with every clear(). A reference taken before a clear() must not be released after it,
+    // even once the same key has been inserted again.
+    unsigned int getGeneration() const
+    {
+        return generation;
+    }
+
+private:
+    struct Entry {
+        unsigned int id;
+        size_t bytes;
+        unsigned int references;
+        bool cached;                    // unreferenced, waiting in the unused list
+        list<string>::iterator unused;
+    };
+
+    unordered_map<string, Entry> entries;
+    list<string> unused;                // unreferenced keys, least recently released first
+    size_t budget;
+    size_t bytes;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long evictions;
+    bool cleared;                       // clear() ran and nothing was inserted since: the context may be gone
+    unsigned int generation;
+
+    void addReference(Entry &entry)
+    {
+        if(entry.references++ == 0 && entry.cached)
+        {
+            unused.erase(entry.unused);
+            entry.cached = false;
+        }
+    }
+
+    TextureCache(const TextureCache &);
+    TextureCache &operator=(const TextureCache &);
+};
+
+// the texture cache references held by a model. Shared by the copies of the model and released
+// with the last one, unless the cache was cleared in between.
+struct TextureReferences {
+    vector<string> keys;
+    unsigned int generation;
+
+    TextureReferences() : generation(TextureCache::shared().getGeneration())
+    {
+    }
+
+    ~TextureReferences()
+    {
+        if(generation != TextureCache::shared().getGeneration())
+            return;
+        for(unsigned int i = 0; i < keys.size(); i++)
+            TextureCache::shared().release(keys[i]);
+    }
+};
+
+
+// reads and decodes an image. Safe to call from a worker thread: it doesn't touch GL.
+ImageData DecodeImage(const char *path, const string &directory)
+{
+    string filename = string(path);
+    filename = directory + '/' + filename;
+
+    ImageData image;
+    image.data = stbi_load(filename.c_str(), &image.width, &image.height, &image.nrComponents, 0);
+    return image;
+}
+
+// creates a texture from decoded pixels and frees them. With gamma set, color images are stored as
+// sRGB so sampling returns linear values. Must run on the thread that owns the GL context.
+unsigned int TextureFromImage(ImageData &image, const char *path, bool gamma)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    unsigned char *data = image.data;
+    int width = image.width, height = image.height, nrComponents = image.nrComponents;
+    if (data)
+    {
+        GLenum internalFormat;
+        GLenum format;
+        if (nrComponents == 1)
+            internalFormat = format = GL_RED;
+        else if (nrComponents == 2)
+            internalFormat = format = GL_RG;
+        else if (nrComponents == 3)
+        {
+            internalFormat = gamma ? GL_SRGB : GL_RGB;
+            format = GL_RGB;
+        }
+        else
+        {
+            internalFormat = gamma ? GL_SRGB_ALPHA : GL_RGBA;
+            format = GL_RGBA;
+        }
+
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        stbi_image_free(data);
+    }
+    else
+    {
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+        stbi_image_free(data);
+    }
+    image.data = 0;
+
+    return textureID;
+}
+#endif
@@ -0,0 +1,247 @@
+/*
+ * Checks the batched box-box tests against the scalar
+ * CollisionDetector::boxAndBox.
+ *
+ * Build: g++ -std=c++11 -DCYCLONE_SINGLE_PRECISION -Iinclude
+ * tests/cyclone_batch_test.cpp together with the cyclone library
+ * sources, which provide CollisionDetector::boxAndBox and
+ * Contact::setBodyData. Build it again with -DCYCLONE_NO_SIMD to
+ * check the one lane fallback.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "cyclone/collide_batch.h"
+
+using namespace cyclone;
+
+namespace {
+    /** A box placed directly by its transform. */
+    struct TestBox : public CollisionBox
+    {
+        TestBox() {}
+
+        TestBox(const Quaternion &orientation, const Vector3 &position,
+                const Vector3 &half, unsigned id)
+        {
+            set(orientation, position, half, id);
+        }
+
+        void set(const Quaternion &orientation, const Vector3 &position,
+                 const Vector3 &half, unsigned id)
+        {
+            Quaternion q = orientation;
+            q.normalise();
+            transform.setOrientationAndPos(q, position);
+            halfSize = half;
+
+            // The detectors only copy the body pointer into the
+            // contact, so each box gets a distinct fake one.
+            body = reinterpret_cast<RigidBody*>((size_t)(id + 1) * 16);
+        }
+    };
+
+    /** Returns the rotation by the given angle about a unit axis. */
+    Quaternion rotation(const Vector3 &axis, real angle)
+    {
+        real s = real_sin(angle * (real)0.5);
+        return Quaternion(real_cos(angle * (real)0.5), axis.x * s, axis.y * s, axis.z * s);
+    }
+
+    real random(real min, real max)
+    {
+        return min + (max - min) * ((real)rand() / (real)RAND_MAX);
+    }
+
+    const real PI_4 = (real)0.785398163;
+
+    /** Holds the contacts written by one of the detectors. */
+    struct Contacts
+    {
+        std::vector<Contact> array;
+        CollisionData data;
+
+        Contacts(unsigned size) : array(size)
+        {
+            data.contactArray = &array[0];
+            data.reset(size);
+            data.friction = (real)0.5;
+            data.restitution = (real)0.25;
+        }
+    };
+
+    /**
+     * Runs both detectors on the pairs and checks they agree. When
+     * exact is set the contacts must match in every field; otherwise
+     * only the overlap and the penetration are compared, since near
+     * ties between axes can fall either way in either detector.
+     */
+    void compare(const BoxPair *pairs, unsigned count, bool exact)
+    {
+        std::vector<char> overlaps(count);
+        bool results[64];
+        assert(count <= 64);
+        unsigned overlapping = BatchCollisionDetector::boxAndBoxIntersections(
+            pairs, count, results);
+
+        Contacts batch(count + 1), scalar(count + 1);
+        unsigned written = BatchCollisionDetector::boxAndBox(pairs, count, &batch.data);
+
+        unsigned expected = 0;
+        for (unsigned i = 0; i < count; i++)
+        {
+            overlaps[i] = (char)CollisionDetector::boxAndBox(
+                *pairs[i].one, *pairs[i].two, &scalar.data);
+            assert((bool)overlaps[i] == results[i]);
+            if (overlaps[i]) expected++;
+        }
+        assert(overlapping == expected);
+        assert(written == expected);
+        assert(batch.data.contactCount == scalar.data.contactCount);
+
+        for (unsigned c = 0; c < written; c++)
+        {
+            const Contact &got = batch.array[c];
+            const Contact &want = scalar.array[c];
+            assert(real_abs(got.penetration - want.penetration) < (real)1e-4);
+            assert(got.friction == want.friction);
+            assert(got.restitution == want.restitution);
+            if (!exact) continue;
+
+            assert(got.body[0] == want.body[0] && got.body[1] == want.body[1]);
+            assert(got.contactNormal * want.contactNormal > (real)0.9999);
+            assert((got.contactPoint - want.contactPoint).magnitude() < (real)1e-3);
+        }
+    }
+
+    /**
+     * Builds pairs whose axis of least penetration is known: a
+     * small box sitting into the top face of a big one, two boxes
+     * crossed edge on edge, the same two pulled just apart so only
+     * an edge axis separates them, and two boxes far apart.
+     */
+    std::vector<TestBox> makeKnownBoxes()
+    {
+        const Vector3 unit(1, 1, 1);
+        const Vector3 small((real)0.5, (real)0.5, (real)0.5);
+        const real diagonal = real_sqrt(2);
+        const Quaternion still(1, 0, 0, 0);
+        const Quaternion aboutX = rotation(Vector3(1, 0, 0), PI_4);
+        const Quaternion aboutY = rotation(Vector3(0, 1, 0), (real)0.5);
+        const Quaternion aboutZ = rotation(Vector3(0, 0, 1), PI_4);
+
+        std::vector<TestBox> boxes(8);
+
+        // Face: one vertex of the tilted small box dips 0.1 into the
+        // big box's top face.
+        Vector3 tiltAxis(1, (real)0.3, (real)0.5);
+        tiltAxis.normalise();
+        const Quaternion tilt = rotation(tiltAxis, (real)0.7);
+        boxes[0].set(still, Vector3(0, 0, 0), unit, 0);
+        boxes[1].set(tilt, Vector3(0, 0, 0), small, 1);
+        real reach = 0;
+        for (unsigned i = 0; i < 3; i++) reach += small[i] * real_abs(boxes[1].getAxis(i).y);
+        boxes[1].set(tilt, Vector3((real)0.2, 1 + reach - (real)0.1, (real)-0.1), small, 1);
+
+        // Edge: the top edge of the first box (along z) crosses the
+        // bottom edge of the second (along x).
+        real height = diagonal + diagonal * small.y - (real)0.05;
+        boxes[2].set(aboutZ, Vector3(0, 0, 0), unit, 2);
+        boxes[3].set(aboutX, Vector3((real)0.1, height, (real)0.2), small, 3);
+
+        // No contact on an edge axis: every face axis overlaps.
+        boxes[4].set(aboutZ, Vector3(0, 0, 0), unit, 4);
+        boxes[5].set(aboutX, Vector3((real)0.1, height + (real)0.1, (real)0.2), small, 5);
+
+        // No contact, far apart.
+        boxes[6].set(still, Vector3(0, 0, 0), unit, 6);
+        boxes[7].set(aboutY, Vector3(5, 0, 0), unit, 7);
+        return boxes;
+    }
+
+    /**
+     * Checks the known pairs one at a time, then in batches of every
+     * size up to two full groups of four and one more, so the last
+     * group of most batches is partly filled.
+     */
+    void testKnownPairs()
+    {
+        std::vector<TestBox> boxes = makeKnownBoxes();
+        const unsigned known = (unsigned)boxes.size() / 2;
+
+        std::vector<BoxPair> pairs;
+        for (unsigned k = 0; k < 9; k++)
+        {
+            BoxPair pair = { &boxes[(k % known) * 2], &boxes[(k % known) * 2 + 1] };
+            pairs.push_back(pair);
+        }
+
+        // Each known pair has the contact it was built for.
+        Contacts face(1), edge(1);
+        assert(CollisionDetector::boxAndBox(boxes[0], boxes[1], &face.data) == 1);
+        assert(face.array[0].contactNormal * Vector3(0, -1, 0) > (real)0.9999);
+        assert(real_abs(face.array[0].penetration - (real)0.1) < (real)1e-4);
+        assert(CollisionDetector::boxAndBox(boxes[2], boxes[3], &edge.data) == 1);
+        assert(real_abs(edge.array[0].contactNormal.y) > (real)0.9999);
+        assert(real_abs(edge.array[0].penetration - (real)0.05) < (real)1e-4);
+
+        for (unsigned count = 1; count <= pairs.size(); count++)
+        {
+            compare(&pairs[0], count, true);
+        }
+
+        // A group that starts with a pair that doesn't touch.
+        compare(&pairs[2], 3, true);
+    }
+
+    /**
+     * Checks random pairs of rotated boxes that are close enough to
+     * touch about half the time.
+     */
+    void testRandomPairs()
+    {
+        const unsigned count = 60;
+        std::vector<TestBox> boxes(count * 2);
+        std::vector<BoxPair> pairs(count);
+        unsigned touching = 0;
+
+        for (unsigned round = 0; round < 50; round++)
+        {
+            for (unsigned i = 0; i < count * 2; i++)
+            {
+                Quaternion q(random(-1, 1), random(-1, 1), random(-1, 1), random(-1, 1));
+                Vector3 centre = (i % 2 == 0) ? Vector3(0, 0, 0) :
+                    Vector3(random(-1, 1), random(-1, 1), random(-1, 1));
+                Vector3 half(random((real)0.2, (real)0.7),
+                             random((real)0.2, (real)0.7),
+                             random((real)0.2, (real)0.7));
+                boxes[i].set(q, centre, half, i);
+            }
+            for (unsigned i = 0; i < count; i++)
+            {
+                pairs[i].one = &boxes[i * 2];
+                pairs[i].two = &boxes[i * 2 + 1];
+            }
+
+            compare(&pairs[0], count - round % RealLanes::WIDTH, false);
+
+            bool results[count];
+            touching += BatchCollisionDetector::boxAndBoxIntersections(
+                &pairs[0], count, results);
+        }
+
+        // Both outcomes must have been tested.
+        assert(touching > 50 * count / 5 && touching < 50 * count * 4 / 5);
+    }
+}
+
+int main()
+{
+    srand(18);
+    testKnownPairs();
+    testRandomPairs();
+    printf("cyclone_batch_test passed (%u lanes)\n", (unsigned)RealLanes::WIDTH);
+    return 0;
+}
@@ -0,0 +1,168 @@
+/*
+ * Checks the broadphases against a brute force search.
+ *
+ * Build: g++ -std=c++11 -Iinclude tests/cyclone_broadphase_test.cpp
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <set>
+#include <utility>
+
+#include "cyclone/collide_coarse.h"
+
+using namespace cyclone;
+
+namespace {
+    const unsigned BODY_COUNT = 64;
+
+    // The broadphases only compare body pointers, so the test gives
+    // each slot a distinct address instead of creating real bodies.
+    char bodyIds[BODY_COUNT];
+
+    RigidBody* bodyFor(unsigned slot)
+    {
+        return reinterpret_cast<RigidBody*>(&bodyIds[slot]);
+    }
+
+    real random(real min, real max)
+    {
+        return min + (max - min) * ((real)rand() / (real)RAND_MAX);
+    }
+
+    BoundingBox randomBox()
+    {
+        Vector3 centre(random(-10, 10), random(-10, 10), random(-10, 10));
+        Vector3 half(random(0.5f, 2), random(0.5f, 2), random(0.5f, 2));
+        return BoundingBox(centre - half, centre + half);
+    }
+
+    typedef std::set<std::pair<RigidBody*, RigidBody*> > PairSet;
+
+    std::pair<RigidBody*, RigidBody*> orderedPair(RigidBody *a, RigidBody *b)
+    {
+        return a < b ? std::make_pair(a, b) : std::make_pair(b, a);
+    }
+
+    PairSet query(Broadphase &broadphase)
+    {
+        PotentialContact contacts[BODY_COUNT * BODY_COUNT];
+        unsigned count = broadphase.getPotentialContacts(
+            contacts, BODY_COUNT * BODY_COUNT);
+
+        PairSet result;
+        for (unsigned i = 0; i < count; i++)
+        {
+            assert(contacts[i].body[0] && contacts[i].body[1]);
+            result.insert(orderedPair(contacts[i].body[0], contacts[i].body[1]));
+        }
+        assert(result.size() == count);
+        return result;
+    }
+
+    PairSet bruteForce(const bool *live, const BoundingBox *boxes)
+    {
+        PairSet result;
+        for (unsigned a = 0; a < BODY_COUNT; a++)
+        {
+            for (unsigned b = a + 1; b < BODY_COUNT && live[a]; b++)
+            {
+                if (live[b] && boxes[a].overlaps(&boxes[b]))
+                {
+                    result.insert(orderedPair(bodyFor(a), bodyFor(b)));
+                }
+            }
+        }
+        return result;
+    }
+
+    /**
+     * Removes two overlapping proxies in the same frame and reuses
+     * them for bodies far apart. Their old pair must not come back.
+     */
+    void testRemoveOverlappingPair()
+    {
+        SweepAndPrune sap;
+        BoundingBox box(Vector3(0, 0, 0), Vector3(1, 1, 1));
+        unsigned a = sap.insert(bodyFor(0), box);
+        unsigned b = sap.insert(bodyFor(1), box);
+        assert(query(sap).size() == 1);
+
+        sap.remove(a);
+        sap.remove(b);
+        assert(query(sap).empty());
+
+        sap.insert(bodyFor(2), BoundingBox(Vector3(5, 5, 5), Vector3(6, 6, 6)));
+        sap.insert(bodyFor(3), BoundingBox(Vector3(-6, -6, -6), Vector3(-5, -5, -5)));
+        assert(query(sap).empty());
+    }
+
+    /**
+     * Adds, moves and removes bodies at random and checks every frame
+     * against a brute force search.
+     */
+    void testChurn(Broadphase &broadphase)
+    {
+        bool live[BODY_COUNT] = { false };
+        BoundingBox boxes[BODY_COUNT];
+        unsigned proxies[BODY_COUNT];
+
+        for (unsigned frame = 0; frame < 200; frame++)
+        {
+            for (unsigned slot = 0; slot < BODY_COUNT; slot++)
+            {
+                real roll = random(0, 1);
+                if (!live[slot])
+                {
+                    if (roll < 0.3f)
+                    {
+                        boxes[slot] = randomBox();
+                        proxies[slot] = broadphase.insert(bodyFor(slot), boxes[slot]);
+                        live[slot] = true;
+                    }
+                }
+                else if (roll < 0.1f)
+                {
+                    broadphase.remove(proxies[slot]);
+                    live[slot] = false;
+                }
+                else if (roll < 0.6f)
+                {
+                    Vector3 move(random(-1, 1), random(-1, 1), random(-1, 1));
+                    boxes[slot] = BoundingBox(boxes[slot].min + move,
+                                              boxes[slot].max + move);
+                    broadphase.update(proxies[slot], boxes[slot], move);
+                }
+            }
+
+            PairSet expected = bruteForce(live, boxes);
+            PairSet found = query(broadphase);
+
+            // The tree may report extra pairs through its fat boxes,
+            // but neither broadphase may miss one.
+            for (PairSet::iterator p = expected.begin(); p != expected.end(); ++p)
+            {
+                assert(found.count(*p));
+            }
+            if (dynamic_cast<SweepAndPrune*>(&broadphase))
+            {
+                assert(found == expected);
+            }
+        }
+    }
+}
+
+int main()
+{
+    srand(12);
+    testRemoveOverlappingPair();
+
+    SweepAndPrune sap;
+    testChurn(sap);
+
+    DynamicAABBTree tree;
+    testChurn(tree);
+
+    printf("cyclone_broadphase_test passed\n");
+    return 0;
+}
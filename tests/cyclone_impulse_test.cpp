@@ -0,0 +1,145 @@
+/*
+ * Checks the sequential impulse resolver.
+ *
+ * Build: g++ -std=c++11 -Iinclude tests/cyclone_impulse_test.cpp
+ * together with the cyclone library sources, which provide
+ * Contact::setBodyData.
+ */
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+
+#include "cyclone/impulse.h"
+
+using namespace cyclone;
+
+namespace {
+    const real DURATION = (real)1.0 / (real)60.0;
+    const real GRAVITY = (real)-9.81;
+
+    /** Sets the body up as an unrotated box with the given mass. */
+    void makeBox(RigidBody &body, const Vector3 &position,
+                 const Vector3 &half, real mass)
+    {
+        body.setMass(mass);
+        Matrix3 tensor;
+        tensor.setBlockInertiaTensor(half, mass);
+        body.setInertiaTensor(tensor);
+        body.setPosition(position);
+        body.setOrientation(Quaternion(1, 0, 0, 0));
+        body.setVelocity(Vector3(0, 0, 0));
+        body.setRotation(Vector3(0, 0, 0));
+        body.setAwake();
+        body.calculateDerivedData();
+    }
+
+    /** Fills a contact with the ground under each bottom corner. */
+    void makeGroundContacts(RigidBody &box, const Vector3 &half, Contact *contacts)
+    {
+        unsigned count = 0;
+        for (int x = -1; x <= 1; x += 2)
+        {
+            for (int z = -1; z <= 1; z += 2)
+            {
+                Contact &contact = contacts[count++];
+                contact.setBodyData(&box, 0, (real)0.5, 0);
+                contact.contactPoint = box.getPosition() +
+                    Vector3(x * half.x, -half.y, z * half.z);
+                contact.contactNormal = Vector3(0, 1, 0);
+                contact.penetration = (real)0.005;
+            }
+        }
+    }
+
+    /**
+     * Runs one frame of a box resting on the ground: gravity, then
+     * the contacts. The box isn't moved, so the contacts stay the
+     * same from frame to frame. Returns the iterations used.
+     */
+    unsigned restingFrame(ImpulseContactResolver &resolver, RigidBody &box,
+                          const Contact *contacts)
+    {
+        box.setVelocity(box.getVelocity() + Vector3(0, GRAVITY * DURATION, 0));
+        resolver.resolveContacts(contacts, 4, DURATION);
+        return resolver.velocityIterationsUsed;
+    }
+
+    /**
+     * A box resting on the ground converges in fewer iterations on
+     * the second frame, when it starts from the first frame's
+     * impulses, than on the first.
+     */
+    void testWarmStartConverges()
+    {
+        const Vector3 half(1, (real)0.5, (real)0.75);
+        RigidBody box;
+        makeBox(box, Vector3(0, half.y, 0), half, 2);
+        Contact contacts[4];
+        makeGroundContacts(box, half, contacts);
+
+        ImpulseContactResolver resolver(100, (real)1e-4);
+        unsigned cold = restingFrame(resolver, box, contacts);
+        assert(resolver.warmStartedContacts == 0);
+
+        unsigned warm = restingFrame(resolver, box, contacts);
+        assert(resolver.warmStartedContacts == 4);
+        printf("resting box: %u iterations cold, %u warm\n", cold, warm);
+        assert(warm < cold);
+        assert(warm <= 2);
+
+        // The cached impulses hold the box up on their own.
+        assert(real_abs(box.getVelocity().y) < (real)1e-3);
+
+        // Without warm starting the second frame is as slow as the first.
+        resolver.setWarmStarting(false);
+        unsigned again = restingFrame(resolver, box, contacts);
+        assert(again > warm);
+    }
+
+    /**
+     * A contact between two bodies of infinite mass, or between one
+     * and the scenery, is skipped rather than solved with an
+     * infinite effective mass.
+     */
+    void testImmovableContactSkipped()
+    {
+        const Vector3 half(1, 1, 1);
+        RigidBody one, two;
+        makeBox(one, Vector3(0, 0, 0), half, 1);
+        makeBox(two, Vector3(0, (real)1.9, 0), half, 1);
+        one.setInverseMass(0);
+        one.setInverseInertiaTensor(Matrix3(0, 0, 0, 0, 0, 0, 0, 0, 0));
+        two.setInverseMass(0);
+        two.setInverseInertiaTensor(Matrix3(0, 0, 0, 0, 0, 0, 0, 0, 0));
+        one.calculateDerivedData();
+        two.calculateDerivedData();
+        two.setVelocity(Vector3(0, -1, 0));
+
+        Contact contacts[2];
+        contacts[0].setBodyData(&two, &one, (real)0.5, 0);
+        contacts[0].contactPoint = Vector3(0, (real)0.95, 0);
+        contacts[0].contactNormal = Vector3(0, 1, 0);
+        contacts[0].penetration = (real)0.1;
+        contacts[1].setBodyData(&one, 0, (real)0.5, 0);
+        contacts[1].contactPoint = Vector3(0, -1, 0);
+        contacts[1].contactNormal = Vector3(0, 1, 0);
+        contacts[1].penetration = (real)0.1;
+
+        ImpulseContactResolver resolver;
+        resolver.resolveContacts(contacts, 2, DURATION);
+        assert(resolver.getCache().size() == 0);
+
+        Vector3 velocity = two.getVelocity();
+        assert(!isnan(velocity.x) && !isnan(velocity.y) && !isnan(velocity.z));
+        assert(velocity.y == -1);
+        assert(one.getVelocity().squareMagnitude() == 0);
+    }
+}
+
+int main()
+{
+    testWarmStartConverges();
+    testImmovableContactSkipped();
+    printf("cyclone_impulse_test passed\n");
+    return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * Checks the box-box manifold detector.
+ *
+ * Build: g++ -std=c++11 -Iinclude tests/cyclone_manifold_test.cpp
+ * together with the cyclone library sources, which provide
+ * Contact::setBodyData.
+ */
+#include <assert.h>
+#include <stdio.h>
+
+#include "cyclone/manifold.h"
+
+using namespace cyclone;
+
+namespace {
+    /** A box placed directly by its transform. */
+    struct TestBox : public CollisionBox
+    {
+        TestBox(const Quaternion &orientation, const Vector3 &position,
+                const Vector3 &half)
+        {
+            Quaternion q = orientation;
+            q.normalise();
+            transform.setOrientationAndPos(q, position);
+            halfSize = half;
+            body = 0;
+        }
+    };
+
+    /**
+     * Two boxes that overlap edge on edge, where the separating axis
+     * test's best axis is an edge but the face bias picks a face
+     * whose clipped points are all too shallow to keep. The detector
+     * must still report the overlap.
+     */
+    void testEdgeOnEdgeOverlap()
+    {
+        TestBox one(Quaternion(0.581918, 0.016177, -0.784573, 0.213436),
+                    Vector3(0, 0, 0),
+                    Vector3(0.355468, 0.449615, 1.059220));
+        TestBox two(Quaternion(-0.063791, 0.814903, -0.212182, -0.535576),
+                    Vector3(-1.328397, 0.628160, -1.018596),
+                    Vector3(0.554105, 0.669778, 0.645439));
+
+        Contact contacts[16];
+        CollisionData data;
+        data.contactArray = contacts;
+        data.reset(16);
+        data.tolerance = (real)0.01;
+
+        ContactManifold manifold;
+        unsigned count = ManifoldCollisionDetector::boxAndBox(
+            one, two, manifold, &data);
+        assert(count == 1);
+        assert(contacts[0].penetration > 0);
+        assert(manifold.pointCount == 0);
+    }
+}
+
+int main()
+{
+    testEdgeOnEdgeOverlap();
+    printf("cyclone_manifold_test passed\n");
+    return 0;
+}
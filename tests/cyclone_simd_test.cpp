@@ -0,0 +1,208 @@
+/*
+ * Checks the SIMD matrix and quaternion kernels against the scalar
+ * arithmetic they replace.
+ *
+ * Build: g++ -std=c++11 -DCYCLONE_SINGLE_PRECISION -ffp-contract=off
+ * -Iinclude tests/cyclone_simd_test.cpp
+ * Build it again with -DCYCLONE_NO_SIMD: both builds must pass, so
+ * the SIMD and scalar paths give the same results.
+ *
+ * The kernels do the same multiplies and adds in the same order as
+ * the scalar code, so the results are compared exactly. Fused
+ * multiply-adds would round differently, hence -ffp-contract=off.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cyclone/core.h"
+
+using namespace cyclone;
+
+namespace {
+    const unsigned SAMPLES = 100000;
+
+    real random(real min, real max)
+    {
+        return min + (max - min) * ((real)rand() / (real)RAND_MAX);
+    }
+
+    Vector3 randomVector()
+    {
+        return Vector3(random(-10, 10), random(-10, 10), random(-10, 10));
+    }
+
+    /**
+     * Returns a rotation and translation, as the inverse transforms
+     * expect, or any matrix when general is set.
+     */
+    Matrix4 randomMatrix4(bool general)
+    {
+        Matrix4 m;
+        if (general)
+        {
+            for (unsigned k = 0; k < 12; k++) m.data[k] = random(-4, 4);
+            return m;
+        }
+        Quaternion q(random(-1, 1), random(-1, 1), random(-1, 1), random(-1, 1));
+        q.normalise();
+        m.setOrientationAndPos(q, randomVector());
+        return m;
+    }
+
+    Matrix3 randomMatrix3()
+    {
+        Matrix3 m;
+        for (unsigned k = 0; k < 9; k++) m.data[k] = random(-4, 4);
+        return m;
+    }
+
+    /** Counts the values that differ at all. */
+    unsigned mismatches(const real *got, const real *want, unsigned count)
+    {
+        unsigned differ = 0;
+        for (unsigned k = 0; k < count; k++)
+        {
+            if (got[k] != want[k]) differ++;
+        }
+        return differ;
+    }
+
+    unsigned mismatches(const Vector3 &got, const Vector3 &want)
+    {
+        const real a[3] = { got.x, got.y, got.z };
+        const real b[3] = { want.x, want.y, want.z };
+        return mismatches(a, b, 3);
+    }
+
+    /*
+     * The scalar reference for each kernel, written out in the
+     * order the kernels are documented to follow.
+     */
+
+    void multiply(const Matrix4 &a, const Matrix4 &o, real *result)
+    {
+        for (unsigned r = 0; r < 12; r += 4)
+        {
+            for (unsigned c = 0; c < 3; c++)
+            {
+                result[r + c] = o.data[c]*a.data[r] + o.data[c + 4]*a.data[r + 1] +
+                    o.data[c + 8]*a.data[r + 2];
+            }
+            result[r + 3] = o.data[3]*a.data[r] + o.data[7]*a.data[r + 1] +
+                o.data[11]*a.data[r + 2] + a.data[r + 3];
+        }
+    }
+
+    Vector3 inverseDirection(const Matrix4 &m, const Vector3 &v)
+    {
+        return Vector3(
+            v.x * m.data[0] + v.y * m.data[4] + v.z * m.data[8],
+            v.x * m.data[1] + v.y * m.data[5] + v.z * m.data[9],
+            v.x * m.data[2] + v.y * m.data[6] + v.z * m.data[10]);
+    }
+
+    Vector3 inverse(const Matrix4 &m, const Vector3 &v)
+    {
+        Vector3 tmp(v.x - m.data[3], v.y - m.data[7], v.z - m.data[11]);
+        return inverseDirection(m, tmp);
+    }
+
+    Vector3 transpose(const Matrix3 &m, const Vector3 &v)
+    {
+        return Vector3(
+            v.x * m.data[0] + v.y * m.data[3] + v.z * m.data[6],
+            v.x * m.data[1] + v.y * m.data[4] + v.z * m.data[7],
+            v.x * m.data[2] + v.y * m.data[5] + v.z * m.data[8]);
+    }
+
+    Quaternion multiply(const Quaternion &q, const Quaternion &m)
+    {
+        return Quaternion(
+            q.r*m.r - q.i*m.i - q.j*m.j - q.k*m.k,
+            q.r*m.i + q.i*m.r + q.j*m.k - q.k*m.j,
+            q.r*m.j + q.j*m.r + q.k*m.i - q.i*m.k,
+            q.r*m.k + q.k*m.r + q.i*m.j - q.j*m.i);
+    }
+
+    void testMatrix4Multiply()
+    {
+        unsigned differ = 0;
+        for (unsigned n = 0; n < SAMPLES; n++)
+        {
+            Matrix4 a = randomMatrix4(n % 2 == 0);
+            Matrix4 b = randomMatrix4(n % 3 == 0);
+            real want[12];
+            multiply(a, b, want);
+            differ += mismatches((a * b).data, want, 12);
+        }
+        printf("Matrix4 * Matrix4: %u mismatches\n", differ);
+        assert(differ == 0);
+    }
+
+    void testMatrix4Inverse()
+    {
+        unsigned differ = 0;
+        for (unsigned n = 0; n < SAMPLES; n++)
+        {
+            Matrix4 m = randomMatrix4(false);
+            Vector3 v = randomVector();
+            differ += mismatches(m.transformInverse(v), inverse(m, v));
+            differ += mismatches(m.transformInverseDirection(v), inverseDirection(m, v));
+        }
+        printf("Matrix4::transformInverse(Direction): %u mismatches\n", differ);
+        assert(differ == 0);
+
+        // The kernels do undo the transform, to within rounding.
+        Matrix4 m = randomMatrix4(false);
+        Vector3 v = randomVector();
+        Vector3 back = m.transformInverse(m.transform(v));
+        assert((back - v).magnitude() < (real)1e-4);
+    }
+
+    void testMatrix3Transpose()
+    {
+        unsigned differ = 0;
+        for (unsigned n = 0; n < SAMPLES; n++)
+        {
+            Matrix3 m = randomMatrix3();
+            Vector3 v = randomVector();
+            differ += mismatches(m.transformTranspose(v), transpose(m, v));
+        }
+        printf("Matrix3::transformTranspose: %u mismatches\n", differ);
+        assert(differ == 0);
+    }
+
+    void testQuaternionMultiply()
+    {
+        unsigned differ = 0;
+        for (unsigned n = 0; n < SAMPLES; n++)
+        {
+            Quaternion q(random(-2, 2), random(-2, 2), random(-2, 2), random(-2, 2));
+            Quaternion m(random(-2, 2), random(-2, 2), random(-2, 2), random(-2, 2));
+            Quaternion want = multiply(q, m);
+            q *= m;
+            differ += mismatches(q.data, want.data, 4);
+        }
+        printf("Quaternion *=: %u mismatches\n", differ);
+        assert(differ == 0);
+    }
+}
+
+int main()
+{
+    srand(17);
+    testMatrix4Multiply();
+    testMatrix4Inverse();
+    testMatrix3Transpose();
+    testQuaternionMultiply();
+
+#if defined(CYCLONE_SIMD_SSE)
+    printf("cyclone_simd_test passed (SSE)\n");
+#elif defined(CYCLONE_SIMD_NEON)
+    printf("cyclone_simd_test passed (NEON)\n");
+#else
+    printf("cyclone_simd_test passed (scalar)\n");
+#endif
+    return 0;
+}
@@ -0,0 +1,251 @@
+/*
+GPED ƼŬ contact ذ ȮѴ.
+: g++ -std=c++11 -Iinclude tests/gped_contact_test.cpp include/GPED/GPED_*.cpp -lpthread
+*/
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "GPED/GPED_pworld.h"
+
+using namespace GPED;
+
+static bool near(real a, real b)
+{
+	return fabs(a - b) < 1e-4f;
+}
+
+/*  εģ  ƼŬ  ǰ ݹ ŭ ƨܳ Ѵ */
+static void testHeadOnMomentum()
+{
+	ParticleStore store;
+	GPEDParticle a(&store), b(&store);
+	a.setMass(1);
+	b.setMass(3);
+	a.setPosition(0, 0, 0);
+	b.setPosition(1, 0, 0);
+	a.setVelocity(5, 0, 0);
+	b.setVelocity(-2, 0, 0);
+	a.setAcceleration(0, 0, 0);
+	b.setAcceleration(0, 0, 0);
+
+	ParticleContact contact;
+	contact.particle[0] = &a;
+	contact.particle[1] = &b;
+	contact.contactNormal = glm::vec3(-1, 0, 0);
+	contact.restitution = real(0.5);
+	contact.penetration = 0;
+
+	real momentumBefore = a.getMass() * a.getVelocity().x + b.getMass() * b.getVelocity().x;
+
+	ParticleContactResolver resolver(1);
+	resolver.resolveContacts(&contact, 1, real(1) / real(60));
+
+	real momentumAfter = a.getMass() * a.getVelocity().x + b.getMass() * b.getVelocity().x;
+	assert(near(momentumBefore, momentumAfter));
+
+	//  ӵ 7 ݹ  0.5 3.5 и ӵ ȴ
+	assert(near(b.getVelocity().x - a.getVelocity().x, real(3.5)));
+	assert(near(a.getVelocity().x, real(-2.875)));
+	assert(near(b.getVelocity().x, real(0.625)));
+}
+
+/*  ҿ ٸ  ƼŬ  ־  ƼŬ еǾ Ѵ */
+static void testMixedStores()
+{
+	ParticleWorld world(16, 1);
+	ParticleStore other;
+
+	//  ۿ   ƼŬ ϳ,  ȿ ٸ  ƼŬ ϳ θ  
+	GPEDParticle unlisted(&world.getParticleStore());
+	world.createParticle();
+	world.removeParticle(world.getParticles()[0]);
+	GPEDParticle foreign(&other);
+	foreign.setVelocity(1, 0, 0);
+	foreign.setAcceleration(0, 0, 0);
+	world.getParticles().push_back(&foreign);
+	assert(world.getParticles().size() == world.getParticleStore().size());
+
+	world.startFrame();
+	world.runPhysics(1);
+	assert(near(foreign.getPosition().x, 1));
+}
+
+/* ħ ذ ġ ű    ġ ܾ Ѵ */
+static void testInterpenetrationKeepsPreviousPosition()
+{
+	ParticleStore store;
+	GPEDParticle particle(&store);
+	particle.resetPosition(0, 1, 0);
+	assert(near(store.previousPosition.y[particle.getIndex()], 1));
+
+	particle.setPosition(0, real(-0.5), 0);
+
+	ParticleContact contact;
+	contact.particle[0] = &particle;
+	contact.particle[1] = NULL;
+	contact.contactNormal = glm::vec3(0, 1, 0);
+	contact.restitution = 0;
+	contact.penetration = real(0.5);
+
+	ParticleContactResolver resolver(1);
+	resolver.resolveContacts(&contact, 1, real(1) / real(60));
+
+	assert(near(particle.getPosition().y, 0));
+	assert(near(store.previousPosition.y[particle.getIndex()], 1));
+}
+
+/* ĥ  Ȯ  ֵ resolver ۾  巯 */
+class ColoringResolver : public ParticleContactResolver
+{
+public:
+	ColoringResolver() : ParticleContactResolver(1, RESOLVE_COLORED) {}
+
+	void color(ParticleContact* contactArray, unsigned numContacts)
+	{
+		buildParticleContacts(contactArray, numContacts);
+		colorContacts(numContacts);
+	}
+
+	/*    contact ƼŬ ϴ    */
+	unsigned countSharedParticles() const
+	{
+		unsigned shared = 0;
+		const unsigned numColors = (unsigned)colorStart.size() - 1;
+		for (unsigned c = 0; c < numColors && c < MAX_CONTACT_COLORS; ++c)
+		{
+			std::vector<bool> used(particleStart.size() - 1, false);
+			for (unsigned k = colorStart[c]; k < colorStart[c + 1]; ++k)
+			{
+				unsigned contact = colorContactList[k];
+				for (unsigned side = 0; side < 2; ++side)
+				{
+					unsigned particle = contactParticles[contact * 2 + side];
+					if (particle == INVALID_PARTICLE_HANDLE) continue;
+					if (used[particle]) ++shared;
+					used[particle] = true;
+				}
+			}
+		}
+		return shared;
+	}
+
+	unsigned getColorCount() const { return (unsigned)colorStart.size() - 1; }
+};
+
+/*  ̾ contact ĥص   contact ƼŬ  ʾƾ Ѵ */
+static void testColorsShareNoParticle()
+{
+	const unsigned particleCount = 200, contactCount = 800;
+	ParticleStore store;
+	std::vector<GPEDParticle*> particles;
+	for (unsigned i = 0; i < particleCount; ++i) particles.push_back(new GPEDParticle(&store));
+
+	srand(11);
+	std::vector<ParticleContact> contacts(contactCount);
+	for (unsigned i = 0; i < contactCount; ++i)
+	{
+		contacts[i].particle[0] = particles[rand() % particleCount];
+		// Ϻδ ٴڰ contact̴
+		contacts[i].particle[1] = (i % 5 == 0) ? NULL : particles[rand() % particleCount];
+		if (contacts[i].particle[1] == contacts[i].particle[0]) contacts[i].particle[1] = NULL;
+		contacts[i].contactNormal = glm::vec3(0, 1, 0);
+	}
+
+	ColoringResolver resolver;
+	resolver.color(&contacts[0], contactCount);
+	assert(resolver.getColorCount() > 1);
+	assert(resolver.countSharedParticles() == 0);
+
+	for (unsigned i = 0; i < particleCount; ++i) delete particles[i];
+}
+
+/*
+ٴ   ƼŬ . ƼŬ ̴ 1ŭ  ־  0.1  ְ Ʒ  ̴
+*/
+struct Stack
+{
+	static const unsigned HEIGHT = 6;
+
+	ParticleStore store;
+	std::vector<GPEDParticle*> particles;
+	std::vector<ParticleContact> contacts;
+
+	Stack()
+	{
+		for (unsigned i = 0; i < HEIGHT; ++i)
+		{
+			GPEDParticle* particle = new GPEDParticle(&store);
+			particle->setMass(real(1 + i % 3));
+			particle->setPosition(0, real(i) * real(0.9) - real(0.1), 0);
+			particle->setVelocity(0, -1, 0);
+			particle->setAcceleration(0, 0, 0);
+			particles.push_back(particle);
+		}
+
+		contacts.resize(HEIGHT);
+		for (unsigned i = 0; i < HEIGHT; ++i)
+		{
+			contacts[i].particle[0] = particles[i];
+			contacts[i].particle[1] = i > 0 ? particles[i - 1] : NULL;
+			contacts[i].contactNormal = glm::vec3(0, 1, 0);
+			contacts[i].restitution = 0;
+			contacts[i].penetration = real(0.1);
+		}
+	}
+
+	~Stack()
+	{
+		for (unsigned i = 0; i < particles.size(); ++i) delete particles[i];
+	}
+};
+
+/* ĥ resolver ۾ Ǯ ֵ   resolver    Ѵ */
+static void testColoredMatchesScan()
+{
+	const real duration = real(1) / real(60);
+	const unsigned iterations = Stack::HEIGHT * 256;
+
+	Stack scan;
+	ParticleContactResolver scanResolver(iterations);
+	scanResolver.resolveContacts(&scan.contacts[0], Stack::HEIGHT, duration);
+
+	Stack colored;
+	ParticleContactResolver coloredResolver(iterations, ParticleContactResolver::RESOLVE_COLORED);
+	coloredResolver.resolveContacts(&colored.contacts[0], Stack::HEIGHT, duration);
+
+	Stack pooled;
+	JobPool pool(4);
+	ParticleContactResolver pooledResolver(iterations, ParticleContactResolver::RESOLVE_COLORED);
+	pooledResolver.setJobPool(&pool);
+	pooledResolver.resolveContacts(&pooled.contacts[0], Stack::HEIGHT, duration);
+
+	for (unsigned i = 0; i < Stack::HEIGHT; ++i)
+	{
+		//  contact ذǾ  ̻ ġų ٰ ʴ´
+		assert(colored.contacts[i].penetration < real(1e-4));
+		glm::vec3 relative = colored.particles[i]->getVelocity();
+		if (i > 0) relative -= colored.particles[i - 1]->getVelocity();
+		assert(relative.y > real(-1e-4));
+
+		assert(near(colored.particles[i]->getPosition().y, scan.particles[i]->getPosition().y));
+		assert(near(colored.particles[i]->getVelocity().y, scan.particles[i]->getVelocity().y));
+
+		//   contact  ̹Ƿ ۾ Ǯ ᵵ  Ʈ  
+		assert(pooled.particles[i]->getPosition() == colored.particles[i]->getPosition());
+		assert(pooled.particles[i]->getVelocity() == colored.particles[i]->getVelocity());
+	}
+}
+
+int main()
+{
+	testHeadOnMomentum();
+	testMixedStores();
+	testInterpenetrationKeepsPreviousPosition();
+	testColorsShareNoParticle();
+	testColoredMatchesScan();
+	printf("gped_contact_test passed\n");
+	return 0;
+}
@@ -0,0 +1,140 @@
+/*
+GPED  Ʈ ׷ ó ȮѴ.
+: g++ -std=c++11 -Iinclude tests/gped_force_test.cpp include/GPED/GPED_*.cpp -lpthread
+*/
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include <vector>
+
+#include "GPED/GPED_Pfgen.h"
+
+using namespace GPED;
+
+/*  ִ ƼŬ  ־  NaN Ǹ  ȴ */
+static void testDragAtRest()
+{
+	ParticleStore store;
+	GPEDParticle particle(&store);
+	ParticleDrag drag(real(0.1), real(0.01));
+	ParticleForceRegistry registry;
+	registry.add(&particle, &drag);
+
+	particle.clearAccumulator();
+	registry.updateForces(real(1) / real(60));
+	assert(store.forceAccum.x[0] == 0 && store.forceAccum.y[0] == 0 && store.forceAccum.z[0] == 0);
+
+	drag.updateForce(&particle, real(1) / real(60));
+	assert(store.forceAccum.x[0] == 0 && store.forceAccum.y[0] == 0 && store.forceAccum.z[0] == 0);
+}
+
+/*   ּҿ ٸ  Ⱑ   ׷ óǸ  ȴ */
+static void testReusedGeneratorAddress()
+{
+	ParticleStore store;
+	GPEDParticle particle(&store);
+	particle.setMass(2);
+	particle.setVelocity(1, 0, 0);
+	ParticleForceRegistry registry;
+
+	//  Ⱑ  ּҸ    ʷ 
+	union { char drag[sizeof(ParticleDrag)]; char gravity[sizeof(ParticleGravity)]; double align; } memory;
+	ParticleDrag* drag = new (&memory) ParticleDrag(real(1), real(0));
+	ForceRegistrationHandle handle = registry.add(&particle, drag);
+	registry.remove(handle);
+	drag->~ParticleDrag();
+
+	ParticleGravity* gravity = new (&memory) ParticleGravity(glm::vec3(0, -10, 0));
+	registry.add(&particle, gravity);
+
+	particle.clearAccumulator();
+	registry.updateForces(real(1) / real(60));
+	assert(store.forceAccum.x[0] == 0);
+	assert(fabs(store.forceAccum.y[0] + 20) < 1e-4f);
+	gravity->~ParticleGravity();
+}
+
+/* ׷  Ű ׷ ϵ    ־ Ѵ */
+static void testGroupRemoval()
+{
+	ParticleStore store;
+	GPEDParticle a(&store), b(&store);
+	ParticleGravity first(glm::vec3(0, -1, 0)), second(glm::vec3(0, -2, 0));
+	ParticleForceRegistry registry;
+
+	ForceRegistrationHandle onFirst = registry.add(&a, &first);
+	ForceRegistrationHandle onSecond = registry.add(&b, &second);
+	registry.remove(onFirst);
+	registry.remove(onSecond);
+	assert(registry.size() == 0);
+
+	registry.add(&a, &second);
+	a.clearAccumulator();
+	registry.updateForces(real(1) / real(60));
+	assert(fabs(store.forceAccum.y[a.getIndex()] + 2) < 1e-4f);
+}
+
+/*
+ ҿ ģ  ƼŬ     Ű Ʈ  ƾ Ѵ.
+ƼŬ  ParticleForceBuffer::RANGE_SIZE Ŀ  ϴ ܰ赵   
+*/
+static void testParallelMatchesSerial()
+{
+	const unsigned countA = 3000, countB = 700;
+	ParticleStore storeA, storeB;
+	std::vector<GPEDParticle*> particles;
+	srand(3);
+	for (unsigned i = 0; i < countA + countB; ++i)
+	{
+		GPEDParticle* particle = new GPEDParticle(i < countA ? &storeA : &storeB);
+		particle->setPosition(glm::vec3(rand() % 100, rand() % 100, rand() % 100) * real(0.1));
+		particle->setVelocity(glm::vec3(rand() % 7, rand() % 5, rand() % 3) - glm::vec3(3, 2, 1));
+		particles.push_back(particle);
+	}
+
+	ParticleGravity gravity(glm::vec3(0, real(-9.81), 0));
+	ParticleDrag drag(real(0.1), real(0.01));
+	std::vector<ParticleSpring*> springs;
+	ParticleForceRegistry registry;
+	for (unsigned i = 0; i < particles.size(); ++i)
+	{
+		registry.add(particles[i], &gravity);
+		registry.add(particles[i], &drag);
+
+		//  Ϲ Ͽ   ۾   ƼŬ  Ѵ
+		ParticleSpring* spring = new ParticleSpring(particles[rand() % particles.size()], real(2), real(1));
+		springs.push_back(spring);
+		registry.add(particles[i], spring);
+		registry.add(particles[(i * 7) % particles.size()], spring);
+	}
+
+	const real duration = real(1) / real(60);
+	storeA.clearAccumulators();
+	storeB.clearAccumulators();
+	registry.updateForces(duration);
+	ParticleVectorStream serialA = storeA.forceAccum, serialB = storeB.forceAccum;
+
+	JobPool pool(4);
+	storeA.clearAccumulators();
+	storeB.clearAccumulators();
+	registry.updateForces(duration, pool);
+
+	assert(storeA.forceAccum.x == serialA.x && storeA.forceAccum.y == serialA.y && storeA.forceAccum.z == serialA.z);
+	assert(storeB.forceAccum.x == serialB.x && storeB.forceAccum.y == serialB.y && storeB.forceAccum.z == serialB.z);
+
+	registry.clear();
+	for (unsigned i = 0; i < springs.size(); ++i) delete springs[i];
+	for (unsigned i = 0; i < particles.size(); ++i) delete particles[i];
+}
+
+int main()
+{
+	testDragAtRest();
+	testReusedGeneratorAddress();
+	testGroupRemoval();
+	testParallelMatchesSerial();
+	printf("gped_force_test passed\n");
+	return 0;
+}
@@ -0,0 +1,129 @@
+/*
+GPED ϰ  SIMD ΰ Į ο    ȮѴ.
+: g++ -std=c++11 -Iinclude tests/gped_simd_test.cpp include/GPED/GPED_*.cpp -lpthread
+*/
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+
+#include "GPED/GPED_Pstore.h"
+#include "GPED/GPED_Psimd.h"
+
+using namespace GPED;
+
+/* SIMD (4, 8)  ƴϾ  ƼŬ Į óϴ κе Ȯεȴ */
+static const unsigned PARTICLE_COUNT = 1003;
+static const unsigned STEP_COUNT = 60;
+
+static real random(real min, real max)
+{
+	return min + (max - min) * ((real)rand() / (real)RAND_MAX);
+}
+
+/*  seed ä   °  */
+static void fill(ParticleStore& store, unsigned seed)
+{
+	srand(seed);
+	for (unsigned i = 0; i < PARTICLE_COUNT; ++i)
+	{
+		unsigned index = store.indexOf(store.create());
+		store.position.x[index] = random(-10, 10);
+		store.position.y[index] = random(-10, 10);
+		store.position.z[index] = random(-10, 10);
+		store.velocity.x[index] = random(-5, 5);
+		store.velocity.y[index] = random(-5, 5);
+		store.velocity.z[index] = random(-5, 5);
+		store.acceleration.y[index] = real(-9.81);
+		store.damping[index] = (i % 3 == 0) ? real(0.99) : random(real(0.5), 1);
+		store.inverseMass[index] = (i % 17 == 0) ? 0 : random(real(0.1), 2);
+	}
+}
+
+static void addForces(ParticleStore& store, unsigned step)
+{
+	for (unsigned i = 0; i < store.size(); ++i)
+	{
+		store.forceAccum.x[i] = real_sin(real(i + step));
+		store.forceAccum.y[i] = real_cos(real(i * 3 + step));
+		store.forceAccum.z[i] = real(i % 5) - 2;
+	}
+}
+
+/*   1e-6 ̳ ȮѴ */
+static bool close(real a, real b)
+{
+	real scale = real_abs(a) > 1 ? real_abs(a) : 1;
+	return real_abs(a - b) <= real(1e-6) * scale;
+}
+
+static unsigned compare(const ParticleVectorStream& a, const ParticleVectorStream& b)
+{
+	unsigned mismatches = 0;
+	for (unsigned i = 0; i < PARTICLE_COUNT; ++i)
+	{
+		if (!close(a.x[i], b.x[i]) || !close(a.y[i], b.y[i]) || !close(a.z[i], b.z[i])) ++mismatches;
+	}
+	return mismatches;
+}
+
+/* Ǵ   ϰ  ƼŬ ϳ   Ѵ */
+static void testBatchMatchesScalar()
+{
+	const real duration = real(1) / real(60);
+	const SimdLevel supported = detectSimdLevel();
+	const char* names[] = { "scalar", "SSE", "AVX" };
+
+	for (int level = SIMD_NONE; level <= supported; ++level)
+	{
+		ParticleStore reference;
+		ParticleStore batched;
+		fill(reference, 7);
+		fill(batched, 7);
+
+		setSimdLevel((SimdLevel)level);
+		assert(getSimdLevel() == level);
+
+		for (unsigned step = 0; step < STEP_COUNT; ++step)
+		{
+			addForces(reference, step);
+			addForces(batched, step);
+			for (unsigned i = 0; i < reference.size(); ++i) reference.integrate(i, duration);
+			batched.integrate(duration);
+
+			for (unsigned i = 0; i < PARTICLE_COUNT; ++i)
+			{
+				assert(batched.forceAccum.x[i] == 0 && batched.forceAccum.y[i] == 0 && batched.forceAccum.z[i] == 0);
+			}
+		}
+
+		unsigned positionErrors = compare(reference.position, batched.position);
+		unsigned velocityErrors = compare(reference.velocity, batched.velocity);
+		printf("%-6s: %u position and %u velocity mismatches after %u steps\n",
+			names[level], positionErrors, velocityErrors, STEP_COUNT);
+		assert(positionErrors == 0 && velocityErrors == 0);
+	}
+	setSimdLevel(supported);
+}
+
+/*  尡 ÿ ó ˻ص    ޾ƾ Ѵ */
+static void testConcurrentDetection()
+{
+	SimdLevel levels[4];
+	std::thread threads[4];
+	for (unsigned i = 0; i < 4; ++i)
+	{
+		threads[i] = std::thread([&levels, i]() { levels[i] = detectSimdLevel(); });
+	}
+	for (unsigned i = 0; i < 4; ++i) threads[i].join();
+	for (unsigned i = 1; i < 4; ++i) assert(levels[i] == levels[0]);
+}
+
+int main()
+{
+	testConcurrentDetection();
+	testBatchMatchesScalar();
+	printf("gped_simd_test passed\n");
+	return 0;
+}
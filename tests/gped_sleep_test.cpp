@@ -0,0 +1,155 @@
+/*
+GPED  ƼŬ ,  , contact     ȮѴ.
+: g++ -std=c++11 -Iinclude tests/gped_sleep_test.cpp include/GPED/GPED_*.cpp -lpthread
+*/
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <map>
+
+#include "GPED/GPED_pworld.h"
+#include "GPED/GPED_Pgrid.h"
+
+using namespace GPED;
+
+/*     ƼŬ  ߴ Ȯ  ֵ ۾  巯 */
+class DragCountingStore : public ParticleStore
+{
+public:
+	unsigned getDragEntries() const { return (unsigned)dragScratch.size(); }
+};
+
+/* ƼŬ   Ƚ . Ļ Ŭ̹Ƿ Ʈ Ϲ Ͽ  */
+class CountingDrag : public ParticleDrag
+{
+public:
+	std::map<const GPEDParticle*, unsigned> calls;
+
+	CountingDrag() : ParticleDrag(real(0.1), real(0.01)) {}
+
+	virtual void updateForce(GPEDParticle* particle, real duration)
+	{
+		++calls[particle];
+		ParticleDrag::updateForce(particle, duration);
+	}
+};
+
+/*  ƼŬ е ʰ    ʾƾ Ѵ */
+static void testSleepingNotIntegrated()
+{
+	DragCountingStore store;
+	GPEDParticle* particles[5];
+	for (unsigned i = 0; i < 5; ++i)
+	{
+		particles[i] = new GPEDParticle(&store);
+		particles[i]->setMass(1);
+		particles[i]->setDamping(real(0.9) - real(0.1) * i);
+		particles[i]->setPosition(real(i), 0, 0);
+		particles[i]->setVelocity(0, 1, 0);
+		particles[i]->setAcceleration(0, -1, 0);
+	}
+
+	particles[1]->setAwake(false);
+	particles[3]->setAwake(false);
+	assert(store.getAwakeCount() == 3);
+
+	//  ƼŬ  ص   
+	particles[3]->addForce(glm::vec3(0, 100, 0));
+
+	store.integrate(real(0.5));
+	assert(store.getDragEntries() == store.getAwakeCount());
+
+	for (unsigned i = 0; i < 5; ++i)
+	{
+		bool awake = (i != 1 && i != 3);
+		assert(particles[i]->isAwake() == awake);
+		if (awake) assert(particles[i]->getPosition().y > 0);
+		else assert(particles[i]->getPosition().y == 0 && particles[i]->getVelocity().y == 0);
+	}
+
+	particles[3]->setAwake(true);
+	unsigned index = particles[3]->getIndex();
+	assert(store.forceAccum.x[index] == 0 && store.forceAccum.y[index] == 0 && store.forceAccum.z[index] == 0);
+
+	for (unsigned i = 0; i < 5; ++i) delete particles[i];
+}
+
+/* 鿡  ƼŬ   ʰ  ʴٰ,  ƼŬ   Ѵ */
+static void testSleeperWakesOnContact()
+{
+	const real duration = real(1) / real(60);
+
+	ParticleWorld world(64, 16);
+	world.setCanSleep(true);
+
+	ParticleGravity gravity(glm::vec3(0, -10, 0));
+	CountingDrag drag;
+
+	GroundContacts ground;
+	ground.init(&world.getParticles());
+	world.getContactGenerators().push_back(&ground);
+
+	SpatialHashContacts spheres;
+	spheres.init(&world.getParticles(), real(0.5), 0);
+	world.getContactGenerators().push_back(&spheres);
+
+	GPEDParticle* resting = world.createParticle();
+	resting->setMass(1);
+	resting->setDamping(real(0.9));
+	resting->setPosition(0, 0, 0);
+	world.getForceRegistry().add(resting, &gravity);
+	world.getForceRegistry().add(resting, &drag);
+
+	//  ü ߸ 
+	unsigned frame = 0;
+	for (; frame < 1000 && resting->isAwake(); ++frame)
+	{
+		world.startFrame();
+		world.runPhysics(duration);
+	}
+	assert(!resting->isAwake());
+	assert(world.getSleepingIslandCount() == 1);
+
+	GPEDParticle* falling = world.createParticle();
+	falling->setMass(1);
+	falling->setDamping(real(0.9));
+	falling->setPosition(0, 3, 0);
+	world.getForceRegistry().add(falling, &gravity);
+	world.getForceRegistry().add(falling, &drag);
+
+	const glm::vec3 sleptAt = resting->getPosition();
+	const unsigned restingCalls = drag.calls[resting];
+	const unsigned fallingCalls = drag.calls[falling];
+
+	for (frame = 0; frame < 1000 && !resting->isAwake(); ++frame)
+	{
+		world.startFrame();
+		world.runPhysics(duration);
+
+		if (!resting->isAwake())
+		{
+			assert(resting->getPosition() == sleptAt);
+			assert(drag.calls[resting] == restingCalls);
+		}
+	}
+
+	//    ƼŬ ұ ̾ Ѵ
+	assert(resting->isAwake());
+	assert(falling->isAwake());
+	assert(falling->getPosition().y - resting->getPosition().y < real(1.01));
+	assert(drag.calls[falling] - fallingCalls == frame);
+	assert(world.getSleepingIslandCount() == 0);
+
+	//  ڿ ٽ  ޴´
+	world.startFrame();
+	world.runPhysics(duration);
+	assert(drag.calls[resting] == restingCalls + 1);
+}
+
+int main()
+{
+	testSleepingNotIntegrated();
+	testSleeperWakesOnContact();
+	printf("gped_sleep_test passed\n");
+	return 0;
+}